@@ -0,0 +1,105 @@
+#include "harness.hpp"
+#include "../src/stats.hpp"
+#include <algorithm>
+#include <iostream>
+
+namespace chrono = std::chrono;
+
+namespace bench
+{
+
+auto param(const char* name, int value)
+-> std::pair<std::string, std::string>
+{
+    return {name, std::to_string(value)};
+}
+
+auto param(const char* name, bool value)
+-> std::pair<std::string, std::string>
+{
+    return {name, value ? "true" : "false"};
+}
+
+auto is_selected(const settings& config, const char* name) -> bool
+{
+    return std::string{name}.find(config.filter) != std::string::npos;
+}
+
+namespace
+{
+
+/** Run an operation a given number of times and measure the elapsed time. */
+auto measure(
+    const std::function<void(std::size_t)>& body,
+    std::size_t iterations
+) -> chrono::nanoseconds
+{
+    auto start = chrono::steady_clock::now();
+    body(iterations);
+    return chrono::steady_clock::now() - start;
+}
+
+} // anonymous namespace
+
+void run(
+    const settings& config,
+    const char* name,
+    const parameters& params,
+    std::uint64_t bytes_per_op,
+    const std::function<void(std::size_t)>& body
+)
+{
+    if (!is_selected(config, name))
+    {
+        return;
+    }
+
+    // Find a number of iterations that lasts long enough to be measured
+    std::size_t iterations = 1;
+
+    while (measure(body, iterations) < config.min_time)
+    {
+        iterations *= 2;
+    }
+
+    auto best = chrono::nanoseconds::max();
+
+    for (int i = 0; i < config.runs; ++i)
+    {
+        best = std::min(best, measure(body, iterations));
+    }
+
+    double ns_per_op = static_cast<double>(best.count())
+        / static_cast<double>(iterations);
+
+    std::cout << "{\"name\":\"" << name << "\",\"params\":{";
+
+    for (std::size_t i = 0; i < params.size(); ++i)
+    {
+        if (i > 0)
+        {
+            std::cout << ',';
+        }
+
+        std::cout << '"' << params[i].first << "\":" << params[i].second;
+    }
+
+    std::cout << "},\"iterations\":" << iterations
+        << ",\"ns_per_op\":" << ns_per_op;
+
+    if (bytes_per_op > 0)
+    {
+        // Bytes per nanosecond is the same as gigabytes per second
+        std::cout << ",\"mb_per_s\":"
+            << static_cast<double>(bytes_per_op) / ns_per_op * 1000;
+    }
+
+    std::cout << "}\n" << std::flush;
+}
+
+auto read_counter(const char* name, const char* labels) -> std::uint64_t
+{
+    return stats::get_counter(name, "", labels).get();
+}
+
+} // namespace bench
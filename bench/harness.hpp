@@ -0,0 +1,85 @@
+#ifndef BENCH_HARNESS_HPP
+#define BENCH_HARNESS_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace bench
+{
+
+/** Global settings for running benchmark cases. */
+struct settings
+{
+    /** Only run cases whose name contains this string. */
+    std::string filter;
+
+    /** Minimum time during which each measurement must run. */
+    std::chrono::nanoseconds min_time{std::chrono::milliseconds{200}};
+
+    /** Number of measurements to take for each case. */
+    int runs = 3;
+};
+
+/**
+ * Parameters of a benchmark case.
+ *
+ * Each parameter is a name associated to a value already formatted as JSON.
+ */
+using parameters = std::vector<std::pair<std::string, std::string>>;
+
+/** Format an integer parameter. */
+auto param(const char* name, int value)
+-> std::pair<std::string, std::string>;
+
+/** Format a boolean parameter. */
+auto param(const char* name, bool value)
+-> std::pair<std::string, std::string>;
+
+/**
+ * Check whether a benchmark case is selected by the current filter.
+ *
+ * @param config Current settings.
+ * @param name Name of the case.
+ */
+bool is_selected(const settings& config, const char* name);
+
+/**
+ * Measure an operation and print the result as a JSON line.
+ *
+ * The number of iterations is doubled until a measurement lasts at least
+ * `config.min_time`, then `config.runs` measurements are taken with that
+ * number of iterations and the fastest one is reported.
+ *
+ * @param config Current settings.
+ * @param name Name of the case.
+ * @param params Parameters of the case.
+ * @param bytes_per_op Number of bytes processed by each operation, or zero
+ * if throughput is not meaningful for this case.
+ * @param body Function running the measured operation a given number of
+ * times.
+ */
+void run(
+    const settings& config,
+    const char* name,
+    const parameters& params,
+    std::uint64_t bytes_per_op,
+    const std::function<void(std::size_t)>& body
+);
+
+/**
+ * Read the current value of a counter registered by the client.
+ *
+ * @param name Name of the counter.
+ * @param labels Labels of the counter, as in its Prometheus line.
+ */
+std::uint64_t read_counter(const char* name, const char* labels = "");
+
+} // namespace bench
+
+#endif // BENCH_HARNESS_HPP
@@ -0,0 +1,568 @@
+#include "harness.hpp"
+#include "../src/app/event_loop.hpp"
+#include "../src/app/pen.hpp"
+#include "../src/app/screen.hpp"
+#include "../src/options.hpp"
+#include "../src/rmioc/file.hpp"
+#include "../src/rmioc/input.hpp"
+#include "../src/rmioc/pen.hpp"
+#include "../src/rmioc/screen.hpp"
+#include "../src/rmioc/touch.hpp"
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <linux/input.h>
+#include <unistd.h>
+#include <rfb/rfbclient.h>
+
+namespace
+{
+
+/** Resolution of the reMarkable screens. */
+constexpr int screen_xres = 1404;
+constexpr int screen_yres = 1872;
+
+/**
+ * In-memory RGB565 screen with a configurable row stride.
+ *
+ * Updates are only counted, so that benchmarks measure the client side of
+ * the pipeline and not the display driver.
+ */
+class memory_screen : public rmioc::screen
+{
+public:
+    memory_screen(int xres_memory, int yres_memory)
+    : xres_memory(xres_memory)
+    , yres_memory(yres_memory)
+    , data(static_cast<std::size_t>(xres_memory) * yres_memory * 2)
+    {}
+
+    void update(
+        int /* x */, int /* y */, int /* w */, int /* h */,
+        rmioc::waveform_modes /* mode */, bool /* wait */) override
+    {
+        ++this->updates;
+    }
+
+    void update(rmioc::waveform_modes /* mode */, bool /* wait */) override
+    {
+        ++this->updates;
+    }
+
+    std::uint8_t* get_data() override { return this->data.data(); }
+    int get_xres() const override { return screen_xres; }
+    int get_xres_memory() const override { return this->xres_memory; }
+    int get_yres() const override { return screen_yres; }
+    int get_yres_memory() const override { return this->yres_memory; }
+    unsigned short get_bits_per_pixel() const override { return 16; }
+
+    rmioc::component_format get_red_format() const override
+    {
+        return {/* offset = */ 11, /* length = */ 5};
+    }
+
+    rmioc::component_format get_green_format() const override
+    {
+        return {/* offset = */ 5, /* length = */ 6};
+    }
+
+    rmioc::component_format get_blue_format() const override
+    {
+        return {/* offset = */ 0, /* length = */ 5};
+    }
+
+    /** Number of updates requested so far. */
+    std::size_t updates = 0;
+
+private:
+    int xres_memory;
+    int yres_memory;
+    std::vector<std::uint8_t> data;
+}; // class memory_screen
+
+/**
+ * VNC client attached to an in-memory screen.
+ *
+ * The client is not connected to any server. Messages it sends are written
+ * to /dev/null.
+ */
+class vnc_fixture
+{
+public:
+    vnc_fixture(int xres_memory, int yres_memory)
+    : device(xres_memory, yres_memory)
+    , sink("/dev/null", O_WRONLY)
+    , client(rfbGetClient(0, 0, 0))
+    , handler(this->device, this->client)
+    {
+        this->client->sock = this->sink;
+        this->client->width = screen_xres;
+        this->client->height = screen_yres;
+        SetClient2Server(this->client, rfbPointerEvent);
+    }
+
+    ~vnc_fixture()
+    {
+        // The sink is closed by its own destructor
+        this->client->sock = -1;
+        rfbClientCleanup(this->client);
+    }
+
+    vnc_fixture(const vnc_fixture& other) = delete;
+    vnc_fixture& operator=(const vnc_fixture& other) = delete;
+    vnc_fixture(vnc_fixture&& other) = delete;
+    vnc_fixture& operator=(vnc_fixture&& other) = delete;
+
+    memory_screen device;
+    rmioc::file_descriptor sink;
+    rfbClient* client;
+    app::screen handler;
+}; // class vnc_fixture
+
+/**
+ * Pipe carrying synthetic input events.
+ *
+ * The read end is non-blocking like an evdev device opened by `rmioc`.
+ */
+struct event_pipe
+{
+    event_pipe()
+    : event_pipe(make_pipe())
+    {}
+
+    /** Write a sequence of events to the pipe. */
+    void write_events(const std::vector<input_event>& events) const
+    {
+        auto size = events.size() * sizeof(input_event);
+
+        if (write(this->write_end, events.data(), size)
+                != static_cast<ssize_t>(size))
+        {
+            throw std::system_error(
+                errno,
+                std::generic_category(),
+                "(bench::event_pipe) Write input events"
+            );
+        }
+    }
+
+    rmioc::file_descriptor read_end;
+    rmioc::file_descriptor write_end;
+
+private:
+    explicit event_pipe(std::array<int, 2> fds)
+    : read_end(fds[0])
+    , write_end(fds[1])
+    {}
+
+    static auto make_pipe() -> std::array<int, 2>
+    {
+        std::array<int, 2> fds{};
+
+        if (pipe2(fds.data(), O_NONBLOCK) == -1)
+        {
+            throw std::system_error(
+                errno,
+                std::generic_category(),
+                "(bench::event_pipe) Create pipe"
+            );
+        }
+
+        return fds;
+    }
+}; // struct event_pipe
+
+/** Input device giving direct access to its raw events. */
+class raw_input : public rmioc::input
+{
+public:
+    using input::input;
+    using input::fetch_events;
+}; // class raw_input
+
+/** Create an input event. */
+auto make_event(unsigned short type, unsigned short code, int value)
+-> input_event
+{
+    input_event result{};
+    result.type = type;
+    result.code = code;
+    result.value = value;
+    return result;
+}
+
+/** Axis limits of the reMarkable 1 touchscreen. */
+const rmioc::axis_limits touch_limits{
+    {ABS_MT_POSITION_X, {0, 767}},
+    {ABS_MT_POSITION_Y, {0, 1023}},
+    {ABS_MT_PRESSURE, {0, 255}},
+    {ABS_MT_ORIENTATION, {-127, 127}},
+};
+
+/** Axis limits of the reMarkable 1 pen digitizer. */
+const rmioc::axis_limits pen_limits{
+    {ABS_X, {0, 20967}},
+    {ABS_Y, {0, 15725}},
+    {ABS_PRESSURE, {0, 4095}},
+    {ABS_DISTANCE, {0, 255}},
+    {ABS_TILT_X, {-9000, 9000}},
+    {ABS_TILT_Y, {-9000, 9000}},
+};
+
+/** Copy of received rectangles into the framebuffer. */
+void bench_recv_update(const bench::settings& config)
+{
+    constexpr std::array<std::array<int, 2>, 4> sizes{{
+        {16, 16}, {64, 64}, {256, 256}, {screen_xres, screen_yres},
+    }};
+
+    constexpr std::array<int, 3> strides{1404, 1408, 2048};
+
+    if (!bench::is_selected(config, "recv_update"))
+    {
+        return;
+    }
+
+    for (int stride : strides)
+    {
+        vnc_fixture fixture{stride, screen_yres};
+
+        for (auto [w, h] : sizes)
+        {
+            std::size_t size = static_cast<std::size_t>(w) * h * 2;
+            std::vector<std::uint8_t> buffer(size);
+
+            for (std::size_t i = 0; i < size; ++i)
+            {
+                buffer[i] = static_cast<std::uint8_t>(i);
+            }
+
+            bench::run(
+                config, "recv_update",
+                {
+                    bench::param("w", w),
+                    bench::param("h", h),
+                    bench::param("stride", stride),
+                },
+                size,
+                [&](std::size_t iterations)
+                {
+                    for (std::size_t i = 0; i < iterations; ++i)
+                    {
+                        fixture.client->GotBitmap(
+                            fixture.client, buffer.data(),
+                            0, 0, w, h
+                        );
+                    }
+                }
+            );
+        }
+    }
+}
+
+/**
+ * Registration of damaged rectangles waiting to be repainted.
+ *
+ * A batch of `rects` random rectangles is merged before each repaint.
+ */
+void bench_commit_updates(const bench::settings& config)
+{
+    constexpr std::size_t rect_count = 1024;
+    constexpr std::array<int, 3> batch_sizes{1, 16, 256};
+
+    if (!bench::is_selected(config, "commit_updates"))
+    {
+        return;
+    }
+
+    std::minstd_rand generator{42};
+    std::uniform_int_distribution<int> size_dist{8, 128};
+    std::vector<std::array<int, 4>> rects;
+
+    for (std::size_t i = 0; i < rect_count; ++i)
+    {
+        int w = size_dist(generator);
+        int h = size_dist(generator);
+        int x = std::uniform_int_distribution<int>{
+            0, screen_xres - w}(generator);
+        int y = std::uniform_int_distribution<int>{
+            0, screen_yres - h}(generator);
+        rects.push_back({x, y, w, h});
+    }
+
+    vnc_fixture fixture{screen_xres, screen_yres};
+
+    for (int batch_size : batch_sizes)
+    {
+        bench::run(
+            config, "commit_updates",
+            {bench::param("rects", batch_size)},
+            0,
+            [&](std::size_t iterations)
+            {
+                for (std::size_t i = 0; i < iterations; ++i)
+                {
+                    auto [x, y, w, h] = rects[i % rect_count];
+
+                    fixture.client->GotFrameBufferUpdate(
+                        fixture.client, x, y, w, h
+                    );
+
+                    if ((i + 1) % static_cast<std::size_t>(batch_size) == 0)
+                    {
+                        fixture.handler.repaint();
+                    }
+                }
+            }
+        );
+    }
+}
+
+/**
+ * Reading of raw events from an input device.
+ *
+ * Each operation writes a frame of `events` events to the pipe and reads it
+ * back, so the cost of the write(2) call is included.
+ */
+void bench_fetch_events(const bench::settings& config)
+{
+    constexpr std::array<int, 3> frame_sizes{1, 4, 16};
+
+    if (!bench::is_selected(config, "fetch_events"))
+    {
+        return;
+    }
+
+    for (int frame_size : frame_sizes)
+    {
+        event_pipe events;
+        raw_input device{std::move(events.read_end), {}};
+        std::vector<input_event> frame;
+
+        for (int i = 0; i < frame_size; ++i)
+        {
+            frame.push_back(make_event(EV_ABS, ABS_MT_POSITION_X, i));
+        }
+
+        frame.push_back(make_event(EV_SYN, SYN_REPORT, 0));
+
+        bench::run(
+            config, "fetch_events",
+            {bench::param("events", frame_size)},
+            frame.size() * sizeof(input_event),
+            [&](std::size_t iterations)
+            {
+                for (std::size_t i = 0; i < iterations; ++i)
+                {
+                    events.write_events(frame);
+                    device.fetch_events();
+                }
+            }
+        );
+    }
+}
+
+/**
+ * Decoding of multi-touch frames.
+ *
+ * Each operation moves `fingers` touch points and processes the frame.
+ */
+void bench_touch_process_events(const bench::settings& config)
+{
+    constexpr std::array<int, 3> finger_counts{1, 2, 5};
+
+    if (!bench::is_selected(config, "touch_process_events"))
+    {
+        return;
+    }
+
+    for (int fingers : finger_counts)
+    {
+        event_pipe events;
+        rmioc::touch device{std::move(events.read_end), touch_limits};
+        std::vector<input_event> frame;
+
+        // Put all the fingers down
+        for (int slot = 0; slot < fingers; ++slot)
+        {
+            frame.push_back(make_event(EV_ABS, ABS_MT_SLOT, slot));
+            frame.push_back(make_event(EV_ABS, ABS_MT_TRACKING_ID, slot));
+            frame.push_back(make_event(EV_ABS, ABS_MT_PRESSURE, 100));
+        }
+
+        frame.push_back(make_event(EV_SYN, SYN_REPORT, 0));
+        events.write_events(frame);
+        device.process_events();
+
+        bench::run(
+            config, "touch_process_events",
+            {bench::param("fingers", fingers)},
+            0,
+            [&](std::size_t iterations)
+            {
+                for (std::size_t i = 0; i < iterations; ++i)
+                {
+                    int position = static_cast<int>(i % 512);
+                    frame.clear();
+
+                    for (int slot = 0; slot < fingers; ++slot)
+                    {
+                        frame.push_back(make_event(
+                            EV_ABS, ABS_MT_SLOT, slot));
+                        frame.push_back(make_event(
+                            EV_ABS, ABS_MT_POSITION_X, position + slot));
+                        frame.push_back(make_event(
+                            EV_ABS, ABS_MT_POSITION_Y, position));
+                    }
+
+                    frame.push_back(make_event(EV_SYN, SYN_REPORT, 0));
+                    events.write_events(frame);
+                    device.process_events();
+                }
+            }
+        );
+    }
+}
+
+/**
+ * Full path from a pen event to a pointer event sent to the server.
+ *
+ * Each operation moves the pen while it touches the screen, which is the
+ * path taken when drawing.
+ */
+void bench_pointer(const bench::settings& config)
+{
+    if (!bench::is_selected(config, "pointer"))
+    {
+        return;
+    }
+
+    vnc_fixture fixture{screen_xres, screen_yres};
+    event_pipe events;
+    rmioc::pen device{std::move(events.read_end), pen_limits};
+
+    app::pen handler{
+        device, fixture.handler,
+        [&fixture](int x, int y, app::MouseButton button)
+        {
+            SendPointerEvent(
+                fixture.client, x, y,
+                static_cast<std::uint8_t>(button)
+            );
+        }
+    };
+
+    events.write_events({
+        make_event(EV_KEY, BTN_TOOL_PEN, 1),
+        make_event(EV_ABS, ABS_PRESSURE, 1000),
+        make_event(EV_SYN, SYN_REPORT, 0),
+    });
+    handler.process_events();
+
+    std::vector<input_event> frame{
+        make_event(EV_ABS, ABS_X, 0),
+        make_event(EV_ABS, ABS_Y, 0),
+        make_event(EV_SYN, SYN_REPORT, 0),
+    };
+
+    bench::run(
+        config, "pointer", {}, 0,
+        [&](std::size_t iterations)
+        {
+            for (std::size_t i = 0; i < iterations; ++i)
+            {
+                auto position = static_cast<int>(i % 8192);
+                frame[0].value = position;
+                frame[1].value = position;
+                events.write_events(frame);
+                handler.process_events();
+            }
+        }
+    );
+}
+
+/**
+ * Print a short help message with usage information.
+ *
+ * @param name Name of the current executable file.
+ */
+void help(const char* name)
+{
+    std::cout << "Usage: " << name << " [OPTION...]\n"
+"Run the vnsee microbenchmarks and print one JSON object per line for each\n"
+"benchmark case.\n\n"
+"Available options:\n"
+"  -h, --help           Show this help message and exit.\n"
+"  --filter=NAME        Only run benchmarks whose name contains NAME.\n"
+"  --min-time=MS        Minimum duration of each measurement (default 200).\n"
+"  --runs=N             Number of measurements of each case, of which the\n"
+"                       fastest is reported (default 3).\n";
+}
+
+} // anonymous namespace
+
+auto main(int argc, const char* argv[]) -> int
+{
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    const char* const name = argv[0];
+    auto [opts, oper] = options::parse(argv + 1, argv + argc);
+    bench::settings config;
+
+    if ((opts.count("help") >= 1) || (opts.count("h") >= 1))
+    {
+        help(name);
+        return EXIT_SUCCESS;
+    }
+
+    try
+    {
+        if (opts.count("filter") >= 1 && !opts["filter"].empty())
+        {
+            config.filter = opts["filter"].back();
+        }
+
+        if (opts.count("min-time") >= 1 && !opts["min-time"].empty())
+        {
+            config.min_time = std::chrono::milliseconds{
+                std::stoi(opts["min-time"].back())};
+        }
+
+        if (opts.count("runs") >= 1 && !opts["runs"].empty())
+        {
+            config.runs = std::max(1, std::stoi(opts["runs"].back()));
+        }
+    }
+    catch (const std::logic_error&)
+    {
+        std::cerr << "Invalid option value.\n"
+            "Run “" << name << " --help” for more information.\n";
+        return EXIT_FAILURE;
+    }
+
+    try
+    {
+        bench_recv_update(config);
+        bench_commit_updates(config);
+        bench_fetch_events(config);
+        bench_touch_process_events(config);
+        bench_pointer(config);
+    }
+    catch (const std::exception& err)
+    {
+        std::cerr << "Error: " << err.what() << '\n';
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,169 @@
+#include "harness.hpp"
+#include "../src/app/client.hpp"
+#include "../src/capture.hpp"
+#include "../src/options.hpp"
+#include "../src/rmioc/device.hpp"
+#include "../src/rmioc/screen.hpp"
+#include "../src/rmioc/screen_memory.hpp"
+#include "../src/stats.hpp"
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace
+{
+
+constexpr int default_xres = 1404;
+constexpr int default_yres = 1872;
+
+/**
+ * Print a short help message with usage information.
+ *
+ * @param name Name of the current executable file.
+ */
+void help(const char* name)
+{
+    std::cout << "Usage: " << name << " CAPTURE [OPTION...]\n"
+"Replay a VNC session captured with “vnsee --capture=CAPTURE” through the\n"
+"client and an in-memory screen, and print the decoding throughput and the\n"
+"repaints issued as a JSON object.\n\n"
+"Available options:\n"
+"  -h, --help           Show this help message and exit.\n"
+"  --screen=WxH         Size of the in-memory screen (default 1404x1872).\n"
+"  --speed=SPEED        Send data as fast as the client reads it (fast,\n"
+"                       default) or at the captured pace (real).\n";
+}
+
+} // anonymous namespace
+
+auto main(int argc, const char* argv[]) -> int
+{
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    const char* const name = argv[0];
+    auto [opts, oper] = options::parse(argv + 1, argv + argc);
+    int xres = default_xres;
+    int yres = default_yres;
+    bool real_time = false;
+
+    if ((opts.count("help") >= 1) || (opts.count("h") >= 1))
+    {
+        help(name);
+        return EXIT_SUCCESS;
+    }
+
+    if (oper.size() != 1)
+    {
+        std::cerr << "Expected exactly one capture file.\n"
+            "Run “" << name << " --help” for more information.\n";
+        return EXIT_FAILURE;
+    }
+
+    try
+    {
+        if (opts.count("screen") >= 1 && !opts["screen"].empty())
+        {
+            const auto& size = opts["screen"].back();
+            auto separator = size.find('x');
+
+            if (separator == std::string::npos)
+            {
+                throw std::invalid_argument{size};
+            }
+
+            xres = std::stoi(size.substr(0, separator));
+            yres = std::stoi(size.substr(separator + 1));
+        }
+
+        if (opts.count("speed") >= 1 && !opts["speed"].empty())
+        {
+            const auto& speed = opts["speed"].back();
+
+            if (speed != "fast" && speed != "real")
+            {
+                throw std::invalid_argument{speed};
+            }
+
+            real_time = speed == "real";
+        }
+    }
+    catch (const std::logic_error&)
+    {
+        std::cerr << "Invalid option value.\n"
+            "Run “" << name << " --help” for more information.\n";
+        return EXIT_FAILURE;
+    }
+
+    try
+    {
+        capture::player player{oper[0].c_str(), real_time};
+
+        auto screen = std::make_unique<rmioc::screen_memory>(xres, yres);
+        auto* memory_screen = screen.get();
+        auto device = rmioc::device::headless(std::move(screen));
+
+        auto start = std::chrono::steady_clock::now();
+
+        {
+            app::client client{"127.0.0.1", player.get_port(), device};
+            client.event_loop();
+        }
+
+        auto seconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+
+        std::array<std::size_t, rmioc::waveform_mode_count> repaints{};
+
+        for (const auto& update : memory_screen->get_updates())
+        {
+            auto mode = static_cast<std::size_t>(update.mode);
+
+            if (mode < repaints.size())
+            {
+                ++repaints.at(mode);
+            }
+        }
+
+        auto rects = bench::read_counter("vnsee_rects_decoded_total");
+        constexpr double bytes_per_mb = 1000 * 1000;
+
+        std::cout << "{\"name\":\"replay\",\"capture\":\"" << oper[0]
+            << "\",\"bytes\":" << player.get_bytes()
+            << ",\"seconds\":" << seconds
+            << ",\"mb_per_s\":"
+            << static_cast<double>(player.get_bytes()) / bytes_per_mb / seconds
+            << ",\"rects\":" << rects
+            << ",\"rects_per_s\":" << static_cast<double>(rects) / seconds
+            << ",\"pixels\":"
+            << bench::read_counter("vnsee_pixels_decoded_total")
+            << ",\"repaints\":{";
+
+        for (std::size_t mode = 0; mode < rmioc::waveform_mode_count; ++mode)
+        {
+            if (mode > 0)
+            {
+                std::cout << ',';
+            }
+
+            std::cout << '"' << rmioc::get_waveform_name(
+                    static_cast<rmioc::waveform_modes>(mode))
+                << "\":"
+                << repaints.at(mode);
+        }
+
+        std::cout << "}}\n";
+    }
+    catch (const std::exception& err)
+    {
+        std::cerr << "Error: " << err.what() << '\n';
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,317 @@
+#include "../src/options.hpp"
+#include "../src/rmioc/panel_model.hpp"
+#include "../src/rmioc/rm2fb.hpp"
+#include "../src/rmioc/screen.hpp"
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <fcntl.h>
+#include <semaphore.h>
+#include <sys/mman.h>
+#include <sys/msg.h>
+#include <unistd.h>
+
+namespace chrono = std::chrono;
+
+namespace
+{
+
+/** Time between two checks for messages while waits are pending. */
+constexpr chrono::milliseconds wait_poll_interval{1};
+
+// NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
+volatile std::sig_atomic_t quit_requested = 0;
+
+void on_quit_signal(int /* signal */)
+{
+    quit_requested = 1;
+}
+
+/**
+ * Stand-in for the rm2fb server, to test the rm2fb screen backend on
+ * machines other than the reMarkable 2.
+ *
+ * Updates are not displayed. Each one is assumed to start as soon as it
+ * is received and to last the duration of its waveform, and semaphores
+ * from wait messages are posted once all previous updates are over.
+ */
+class stand_in_server
+{
+public:
+    stand_in_server(const char* shm_path, int msgqueue_key)
+    : shm_path(shm_path)
+    {
+        // NOLINTNEXTLINE(hicpp-signed-bitwise): Use of C library
+        this->framebuf_fd = shm_open(shm_path, O_CREAT | O_RDWR, 0644);
+
+        if (this->framebuf_fd == -1)
+        {
+            throw std::system_error(
+                errno,
+                std::generic_category(),
+                "(stand_in_server) Create shared memory framebuffer"
+            );
+        }
+
+        constexpr auto screen_mem_len = rm2fb::screen_width
+            * rm2fb::screen_height * rm2fb::screen_depth;
+
+        if (ftruncate(this->framebuf_fd, screen_mem_len) == -1)
+        {
+            throw std::system_error(
+                errno,
+                std::generic_category(),
+                "(stand_in_server) Resize shared memory framebuffer"
+            );
+        }
+
+        // NOLINTNEXTLINE(hicpp-signed-bitwise): Use of C library
+        this->msgqueue_id = msgget(msgqueue_key, IPC_CREAT | 0644);
+
+        if (this->msgqueue_id == -1)
+        {
+            throw std::system_error(
+                errno,
+                std::generic_category(),
+                "(stand_in_server) Create message queue"
+            );
+        }
+    }
+
+    ~stand_in_server()
+    {
+        msgctl(this->msgqueue_id, IPC_RMID, nullptr);
+        close(this->framebuf_fd);
+        shm_unlink(this->shm_path);
+    }
+
+    stand_in_server(const stand_in_server& other) = delete;
+    stand_in_server& operator=(const stand_in_server& other) = delete;
+    stand_in_server(stand_in_server&& other) = delete;
+    stand_in_server& operator=(stand_in_server&& other) = delete;
+
+    /** Process messages until interrupted. */
+    void run()
+    {
+        while (quit_requested == 0)
+        {
+            this->post_due();
+
+            rm2fb::message message{};
+            bool idle = this->pending_posts.empty();
+
+            if (msgrcv(
+                    this->msgqueue_id, &message, sizeof(message.data),
+                    0, idle ? 0 : IPC_NOWAIT) == -1)
+            {
+                if (errno == ENOMSG)
+                {
+                    std::this_thread::sleep_for(wait_poll_interval);
+                    continue;
+                }
+
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+
+                throw std::system_error(
+                    errno,
+                    std::generic_category(),
+                    "(stand_in_server) Receive message"
+                );
+            }
+
+            this->handle(message);
+        }
+    }
+
+    /** Print a summary of the received messages as JSON. */
+    void write_report(std::ostream& out) const
+    {
+        out << "{\"name\":\"rm2fb_server\",\"updates\":" << this->updates
+            << ",\"waits\":" << this->waits
+            << ",\"repaints\":{";
+
+        for (std::size_t mode = 0; mode < rmioc::waveform_mode_count; ++mode)
+        {
+            if (mode > 0)
+            {
+                out << ',';
+            }
+
+            out << '"' << rmioc::get_waveform_name(
+                    static_cast<rmioc::waveform_modes>(mode))
+                << "\":"
+                << this->repaints.at(mode);
+        }
+
+        out << "}}\n";
+    }
+
+private:
+    /** Semaphore to post once the updates preceding it are over. */
+    struct pending_post
+    {
+        chrono::steady_clock::time_point time;
+        std::string semaphore_name;
+    };
+
+    /** Path of the shared memory framebuffer. */
+    const char* shm_path;
+
+    /** File descriptor for the shared memory framebuffer. */
+    int framebuf_fd = -1;
+
+    /** Identifier of the update message queue. */
+    int msgqueue_id = -1;
+
+    /** Time at which all received updates are over. */
+    chrono::steady_clock::time_point busy_until;
+
+    /** Semaphores waiting to be posted, in time order. */
+    std::deque<pending_post> pending_posts;
+
+    /** Number of received updates. */
+    std::size_t updates = 0;
+
+    /** Number of received wait messages. */
+    std::size_t waits = 0;
+
+    /** Number of received updates for each waveform mode. */
+    std::array<std::size_t, rmioc::waveform_mode_count> repaints{};
+
+    void handle(const rm2fb::message& message)
+    {
+        auto now = chrono::steady_clock::now();
+
+        switch (message.message_type)
+        {
+        case rm2fb::message_types::update:
+        {
+            auto mode = message.data.update.waveform_mode;
+            auto index = static_cast<std::size_t>(mode);
+
+            if (index < this->repaints.size())
+            {
+                ++this->repaints.at(index);
+            }
+
+            ++this->updates;
+            this->busy_until = std::max(
+                this->busy_until,
+                now + rmioc::panel_model::get_duration(mode)
+            );
+            break;
+        }
+
+        case rm2fb::message_types::wait_update:
+        {
+            const auto& name = message.data.semaphore_name;
+            std::string semaphore_name{
+                name.begin(),
+                std::find(name.begin(), name.end(), '\0')
+            };
+
+            ++this->waits;
+            this->pending_posts.push_back(pending_post{
+                std::max(this->busy_until, now),
+                std::move(semaphore_name)
+            });
+            break;
+        }
+
+        default:
+            break;
+        }
+    }
+
+    /** Post the semaphores of waits whose updates are over. */
+    void post_due()
+    {
+        auto now = chrono::steady_clock::now();
+
+        while (!this->pending_posts.empty()
+                && this->pending_posts.front().time <= now)
+        {
+            const auto& post = this->pending_posts.front();
+            sem_t* semaphore = sem_open(post.semaphore_name.c_str(), 0);
+
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-type-cstyle-cast,performance-no-int-to-ptr)
+            if (semaphore != SEM_FAILED)
+            {
+                sem_post(semaphore);
+                sem_close(semaphore);
+            }
+
+            this->pending_posts.pop_front();
+        }
+    }
+}; // class stand_in_server
+
+/**
+ * Print a short help message with usage information.
+ *
+ * @param name Name of the current executable file.
+ */
+void help(const char* name)
+{
+    std::cout << "Usage: " << name << " [OPTION...]\n"
+"Stand in for the rm2fb server of the reMarkable 2, so that the rm2fb\n"
+"screen backend can be tested with “vnsee --headless-rm2fb” on other\n"
+"machines. Updates are timed like on an e-ink panel but not displayed.\n"
+"A summary of the received messages is printed as a JSON object when\n"
+"interrupted.\n\n"
+"Available options:\n"
+"  -h, --help           Show this help message and exit.\n";
+}
+
+} // anonymous namespace
+
+auto main(int argc, const char* argv[]) -> int
+{
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    const char* const name = argv[0];
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    auto [opts, oper] = options::parse(argv + 1, argv + argc);
+
+    if ((opts.count("help") >= 1) || (opts.count("h") >= 1))
+    {
+        help(name);
+        return EXIT_SUCCESS;
+    }
+
+    // Interrupt blocking receives instead of restarting them
+    struct sigaction action{};
+    action.sa_handler = on_quit_signal;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+
+    try
+    {
+        stand_in_server server{
+            rm2fb::default_shm_path,
+            rm2fb::default_msgqueue_key
+        };
+
+        std::cerr << "Waiting for updates\n";
+        server.run();
+        server.write_report(std::cout);
+    }
+    catch (const std::exception& err)
+    {
+        std::cerr << "Error: " << err.what() << '\n';
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
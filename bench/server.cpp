@@ -0,0 +1,354 @@
+#include "server.hpp"
+#include "../src/log.hpp"
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+#include <netinet/in.h>
+#include <rfb/rfb.h>
+
+namespace chrono = std::chrono;
+
+namespace
+{
+
+/** Time between two checks for new clients (in microseconds). */
+constexpr long idle_poll_interval = 100000;
+
+/** Time left to clients to receive the first frame before the workload. */
+constexpr chrono::milliseconds warmup_time{500};
+
+/** Time left to clients to receive the last frames after the workload. */
+constexpr chrono::milliseconds drain_time{1000};
+
+/** Size of a character cell in the typing workload (in pixels). */
+constexpr int cell_width = 16;
+constexpr int cell_height = 32;
+
+/** Number of rows scrolled at each frame in the scroll workload. */
+constexpr int scroll_step = 32;
+
+/** Height of text lines drawn by `draw_text` (in pixels). */
+constexpr int line_height = 32;
+
+/** Gray level of the page background. */
+constexpr std::uint8_t paper = 255;
+
+/** Gray level of text. */
+constexpr std::uint8_t ink = 0;
+
+/** Cheap deterministic pseudo-random generator for drawing patterns. */
+auto mix(std::size_t value) -> std::size_t
+{
+    constexpr std::size_t multiplier = 0x9E3779B97F4A7C15ULL;
+    constexpr unsigned shift = 29;
+    value *= multiplier;
+    return value ^ (value >> shift);
+}
+
+} // anonymous namespace
+
+namespace bench
+{
+
+synthetic_server::synthetic_server(const server_settings& settings)
+: settings(settings)
+, pixels(static_cast<std::size_t>(settings.xres) * settings.yres)
+, start(chrono::steady_clock::now())
+{
+    if (!log::is_enabled(log::levels::info))
+    {
+        rfbLogEnable(0);
+    }
+
+    std::array<char, 19> program_name{"vnsee-bench-server"};
+    std::array<char*, 1> argv{program_name.data()};
+    int argc = argv.size();
+
+    constexpr int bits_per_sample = 8;
+    constexpr int samples_per_pixel = 3;
+    constexpr int bytes_per_pixel = 4;
+
+    this->rfb_screen = rfbGetScreen(
+        &argc, argv.data(),
+        settings.xres, settings.yres,
+        bits_per_sample, samples_per_pixel, bytes_per_pixel
+    );
+
+    if (this->rfb_screen == nullptr)
+    {
+        throw std::runtime_error{"(bench::synthetic_server) Create screen"};
+    }
+
+    this->fill(0, 0, settings.xres, settings.yres, paper);
+    this->fill(0, 0, stamp::width, stamp::height, ink);
+
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    this->rfb_screen->frameBuffer = reinterpret_cast<char*>(
+        this->pixels.data());
+    this->rfb_screen->desktopName = "vnsee-bench-server";
+    this->rfb_screen->alwaysShared = TRUE;
+
+    if (settings.port == 0)
+    {
+        this->rfb_screen->autoPort = TRUE;
+        this->rfb_screen->listenInterface = htonl(INADDR_LOOPBACK);
+    }
+    else
+    {
+        this->rfb_screen->port = settings.port;
+        this->rfb_screen->ipv6port = settings.port;
+    }
+
+    rfbInitServer(this->rfb_screen);
+
+    if (this->rfb_screen->listenSock < 0)
+    {
+        rfbScreenCleanup(this->rfb_screen);
+        throw std::runtime_error{"(bench::synthetic_server) Listen"};
+    }
+}
+
+synthetic_server::~synthetic_server()
+{
+    rfbScreenCleanup(this->rfb_screen);
+}
+
+auto synthetic_server::get_port() const -> int
+{
+    return this->rfb_screen->port;
+}
+
+auto synthetic_server::get_start() const -> chrono::steady_clock::time_point
+{
+    return this->start;
+}
+
+auto synthetic_server::get_frames() const -> std::size_t
+{
+    return this->frames;
+}
+
+void synthetic_server::stop()
+{
+    this->stopped = true;
+}
+
+void synthetic_server::run()
+{
+    while (!this->stopped && this->rfb_screen->clientHead == nullptr)
+    {
+        rfbProcessEvents(this->rfb_screen, idle_poll_interval);
+    }
+
+    auto period = chrono::duration_cast<chrono::steady_clock::duration>(
+        chrono::duration<double>(1 / this->settings.rate));
+    auto next_frame = chrono::steady_clock::now() + warmup_time;
+    auto end = next_frame + this->settings.duration;
+    auto drain_end = end + drain_time;
+
+    while (!this->stopped && this->rfb_screen->clientHead != nullptr)
+    {
+        auto now = chrono::steady_clock::now();
+
+        if (now >= drain_end)
+        {
+            break;
+        }
+
+        if (now >= next_frame && now < end)
+        {
+            this->draw_frame(now);
+            ++this->frames;
+            next_frame += period;
+        }
+
+        auto wake = std::min(now < end ? next_frame : drain_end, drain_end);
+        auto wait = chrono::duration_cast<chrono::microseconds>(wake - now);
+        rfbProcessEvents(
+            this->rfb_screen,
+            std::clamp<long>(wait.count(), 0, idle_poll_interval)
+        );
+    }
+
+    rfbShutdownServer(this->rfb_screen, TRUE);
+}
+
+void synthetic_server::draw_frame(chrono::steady_clock::time_point now)
+{
+    const int xres = this->settings.xres;
+    const int yres = this->settings.yres;
+    const std::size_t frame = this->frames;
+
+    switch (this->settings.workload)
+    {
+    case workloads::typing:
+    {
+        if (this->cursor_x + cell_width > xres)
+        {
+            this->cursor_x = 0;
+            this->cursor_y += cell_height;
+        }
+
+        if (this->cursor_y < cell_height
+                || this->cursor_y + cell_height > yres)
+        {
+            // Start a new page below the timestamp strip
+            this->fill(0, 0, xres, yres, paper);
+            rfbMarkRectAsModified(this->rfb_screen, 0, 0, xres, yres);
+            this->cursor_x = 0;
+            this->cursor_y = cell_height;
+        }
+
+        // Draw a glyph-sized block with a width that varies like letters
+        constexpr int glyph_margin = 2;
+        constexpr int glyph_height = 20;
+        int glyph_width = cell_width / 2
+            + static_cast<int>(mix(frame) % (cell_width / 2 - glyph_margin));
+
+        this->fill(
+            this->cursor_x + glyph_margin,
+            this->cursor_y + (cell_height - glyph_height) / 2,
+            glyph_width, glyph_height, ink
+        );
+        rfbMarkRectAsModified(
+            this->rfb_screen,
+            this->cursor_x, this->cursor_y,
+            this->cursor_x + cell_width, this->cursor_y + cell_height
+        );
+        this->cursor_x += cell_width;
+        break;
+    }
+
+    case workloads::scroll:
+        rfbDoCopyRect(
+            this->rfb_screen,
+            0, 0, xres, yres - scroll_step,
+            0, -scroll_step
+        );
+        this->draw_text(0, yres - scroll_step, xres, scroll_step, frame);
+        rfbMarkRectAsModified(
+            this->rfb_screen,
+            0, yres - scroll_step, xres, yres
+        );
+        break;
+
+    case workloads::video:
+    {
+        constexpr int band_size = 16;
+        constexpr int band_speed = 8;
+        constexpr std::uint8_t dark = 32;
+        constexpr std::uint8_t light = 224;
+
+        int width = xres * 2 / 3;
+        int height = width * 9 / 16;
+        int left = (xres - width) / 2;
+        int top = (yres - height) / 2;
+        auto offset = static_cast<int>(frame) * band_speed;
+
+        for (int y = top; y < top + height; ++y)
+        {
+            for (int x = left; x < left + width; ++x)
+            {
+                bool band = ((x + y + offset) / band_size) % 2 == 0;
+                std::uint32_t gray = band ? dark : light;
+                this->pixels[static_cast<std::size_t>(y) * xres + x]
+                    = gray * 0x010101U;
+            }
+        }
+
+        rfbMarkRectAsModified(
+            this->rfb_screen,
+            left, top, left + width, top + height
+        );
+        break;
+    }
+
+    case workloads::flip:
+        this->draw_text(0, 0, xres, yres, frame);
+        rfbMarkRectAsModified(this->rfb_screen, 0, 0, xres, yres);
+        break;
+    }
+
+    // Embed the drawing time in the top left corner
+    auto value = static_cast<std::uint32_t>(
+        chrono::duration_cast<chrono::microseconds>(
+            now - this->start).count());
+
+    for (int bit = 0; bit < stamp::bits; ++bit)
+    {
+        bool set = ((value >> (stamp::bits - 1 - bit)) & 1U) != 0;
+        this->fill(
+            bit * stamp::block, 0,
+            stamp::block, stamp::block,
+            set ? paper : ink
+        );
+    }
+
+    rfbMarkRectAsModified(
+        this->rfb_screen,
+        0, 0, stamp::width, stamp::height
+    );
+}
+
+void synthetic_server::fill(int x, int y, int w, int h, std::uint8_t gray)
+{
+    const int xres = this->settings.xres;
+    const int yres = this->settings.yres;
+    int right = std::min(x + w, xres);
+    int bottom = std::min(y + h, yres);
+    x = std::max(x, 0);
+    y = std::max(y, 0);
+
+    if (x >= right)
+    {
+        return;
+    }
+
+    std::uint32_t value = gray * 0x010101U;
+
+    for (int row = y; row < bottom; ++row)
+    {
+        auto line = this->pixels.begin()
+            + static_cast<std::ptrdiff_t>(row) * xres;
+        std::fill(line + x, line + right, value);
+    }
+}
+
+void synthetic_server::draw_text(
+    int x, int y, int w, int h,
+    std::size_t seed
+)
+{
+    constexpr int word_height = 20;
+    constexpr int min_word = 24;
+    constexpr int max_word = 120;
+    constexpr int space = 12;
+
+    this->fill(x, y, w, h, paper);
+
+    for (int line = y; line + line_height <= y + h; line += line_height)
+    {
+        std::size_t state = mix(seed + static_cast<std::size_t>(line));
+        int cursor = x + space;
+
+        while (true)
+        {
+            state = mix(state);
+            int word = min_word
+                + static_cast<int>(state % (max_word - min_word));
+
+            if (cursor + word > x + w - space)
+            {
+                break;
+            }
+
+            this->fill(
+                cursor, line + (line_height - word_height) / 2,
+                word, word_height, ink
+            );
+            cursor += word + space;
+        }
+    }
+}
+
+} // namespace bench
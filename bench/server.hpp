@@ -0,0 +1,158 @@
+#ifndef BENCH_SERVER_HPP
+#define BENCH_SERVER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct _rfbScreenInfo;
+
+namespace bench
+{
+
+/** Scripted screen activities generated by the synthetic server. */
+enum class workloads
+{
+    /** Characters appearing one at a time, as in a text editor. */
+    typing,
+
+    /** Page scrolling by a fixed amount at each frame. */
+    scroll,
+
+    /** Region redrawn completely at each frame, as a video player. */
+    video,
+
+    /** Full screen changes, as when turning pages. */
+    flip,
+};
+
+/** Settings of the synthetic server. */
+struct server_settings
+{
+    /** Activity to generate. */
+    workloads workload = workloads::typing;
+
+    /** Width of the server screen (in pixels). */
+    int xres = 1404;
+
+    /** Height of the server screen (in pixels). */
+    int yres = 1872;
+
+    /** Number of frames to generate each second. */
+    double rate = 10;
+
+    /** Time during which frames are generated. */
+    std::chrono::milliseconds duration{std::chrono::seconds{10}};
+
+    /** Port to listen on, or 0 to pick a free loopback port. */
+    int port = 0;
+};
+
+/**
+ * Timestamps embedded in the frames.
+ *
+ * Each frame carries the time at which it was drawn, in microseconds since
+ * the server was created, as a strip of black and white blocks in the top
+ * left corner of the screen, one block per bit starting with the most
+ * significant one. Blocks are large enough to survive conversion to the
+ * client pixel format.
+ */
+namespace stamp
+{
+
+/** Number of bits in a timestamp. */
+constexpr int bits = 32;
+
+/** Size of the square block used for each bit (in pixels). */
+constexpr int block = 4;
+
+/** Width of the timestamp strip (in pixels). */
+constexpr int width = bits * block;
+
+/** Height of the timestamp strip (in pixels). */
+constexpr int height = block;
+
+} // namespace stamp
+
+/**
+ * VNC server generating a scripted workload.
+ */
+class synthetic_server
+{
+public:
+    /**
+     * Create the server and start listening for clients.
+     *
+     * @param settings Server settings.
+     * @throws std::runtime_error If the server cannot listen.
+     */
+    explicit synthetic_server(const server_settings& settings);
+
+    /** Disconnect clients and stop the server. */
+    ~synthetic_server();
+
+    synthetic_server(const synthetic_server& other) = delete;
+    synthetic_server& operator=(const synthetic_server& other) = delete;
+    synthetic_server(synthetic_server&& other) = delete;
+    synthetic_server& operator=(synthetic_server&& other) = delete;
+
+    /** Get the port on which the server listens. */
+    int get_port() const;
+
+    /** Get the origin of the embedded timestamps. */
+    std::chrono::steady_clock::time_point get_start() const;
+
+    /** Get the number of frames generated so far. */
+    std::size_t get_frames() const;
+
+    /**
+     * Serve clients until the workload is complete.
+     *
+     * Waits for a first client to connect, generates frames during the
+     * configured duration, leaves the client one more second to receive the
+     * last frames, then disconnects it. Can be called from another thread
+     * than the one that created the server.
+     */
+    void run();
+
+    /** Ask `run()` to return as soon as possible. */
+    void stop();
+
+private:
+    /** Server settings. */
+    server_settings settings;
+
+    /** Server pixels, with 32 bits per pixel. */
+    std::vector<std::uint32_t> pixels;
+
+    /** libvncserver handle. */
+    _rfbScreenInfo* rfb_screen;
+
+    /** Origin of the embedded timestamps. */
+    std::chrono::steady_clock::time_point start;
+
+    /** Number of frames generated so far. */
+    std::atomic<std::size_t> frames{0};
+
+    /** Set to stop serving. */
+    std::atomic<bool> stopped{false};
+
+    /** Position of the next character in the typing workload. */
+    int cursor_x = 0;
+    int cursor_y = 0;
+
+    /** Draw the next frame of the workload and embed its timestamp. */
+    void draw_frame(std::chrono::steady_clock::time_point now);
+
+    /** Fill a region with a gray level. */
+    void fill(int x, int y, int w, int h, std::uint8_t gray);
+
+    /** Fill a region with lines of text-like blocks. */
+    void draw_text(int x, int y, int w, int h, std::size_t seed);
+}; // class synthetic_server
+
+} // namespace bench
+
+#endif // BENCH_SERVER_HPP
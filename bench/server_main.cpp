@@ -0,0 +1,461 @@
+#include "harness.hpp"
+#include "server.hpp"
+#include "../src/app/client.hpp"
+#include "../src/options.hpp"
+#include "../src/rmioc/device.hpp"
+#include "../src/rmioc/screen.hpp"
+#include "../src/rmioc/screen_memory.hpp"
+#include "../src/stats.hpp"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace chrono = std::chrono;
+
+namespace
+{
+
+/** Name of each workload. */
+constexpr std::array<std::pair<const char*, bench::workloads>, 4>
+workload_names{{
+    {"typing", bench::workloads::typing},
+    {"scroll", bench::workloads::scroll},
+    {"video", bench::workloads::video},
+    {"flip", bench::workloads::flip},
+}};
+
+/** Name of each pixel format that the client can ask the server for. */
+constexpr std::array<std::pair<const char*, app::server_formats>, 3>
+format_names{{
+    {"screen", app::server_formats::screen},
+    {"rgb32", app::server_formats::rgb32},
+    {"bgr32", app::server_formats::bgr32},
+}};
+
+/** Encodings under which the client counts received bytes. */
+constexpr std::array<const char*, 3> encoding_names{{
+    "raw", "tight", "jpeg",
+}};
+
+/** Default frame rate of each workload. */
+auto default_rate(bench::workloads workload) -> double
+{
+    switch (workload)
+    {
+    case bench::workloads::typing:
+        return 10;
+
+    case bench::workloads::scroll:
+        return 5;
+
+    case bench::workloads::video:
+        return 24;
+
+    case bench::workloads::flip:
+        return 1;
+    }
+
+    return 1;
+}
+
+/**
+ * Screen that reads back the timestamps embedded by the synthetic server
+ * each time a region containing them is repainted.
+ */
+class stamp_screen : public rmioc::screen
+{
+public:
+    stamp_screen(
+        std::unique_ptr<rmioc::screen_memory>&& inner,
+        chrono::steady_clock::time_point origin
+    )
+    : inner(std::move(inner))
+    , origin(origin)
+    {}
+
+    void update(
+        int x, int y, int w, int h,
+        rmioc::waveform_modes mode, bool wait) override
+    {
+        if (x <= 0 && y <= 0
+                && x + w >= bench::stamp::width
+                && y + h >= bench::stamp::height)
+        {
+            this->read_stamp();
+        }
+
+        this->inner->update(x, y, w, h, mode, wait);
+    }
+
+    void update(rmioc::waveform_modes mode, bool wait) override
+    {
+        this->read_stamp();
+        this->inner->update(mode, wait);
+    }
+
+    std::uint8_t* get_data() override { return this->inner->get_data(); }
+    int get_xres() const override { return this->inner->get_xres(); }
+
+    int get_xres_memory() const override
+    {
+        return this->inner->get_xres_memory();
+    }
+
+    int get_yres() const override { return this->inner->get_yres(); }
+
+    int get_yres_memory() const override
+    {
+        return this->inner->get_yres_memory();
+    }
+
+    unsigned short get_bits_per_pixel() const override
+    {
+        return this->inner->get_bits_per_pixel();
+    }
+
+    rmioc::component_format get_red_format() const override
+    {
+        return this->inner->get_red_format();
+    }
+
+    rmioc::component_format get_green_format() const override
+    {
+        return this->inner->get_green_format();
+    }
+
+    rmioc::component_format get_blue_format() const override
+    {
+        return this->inner->get_blue_format();
+    }
+
+    /** Get the delay between drawing and repainting each seen frame. */
+    const std::vector<chrono::nanoseconds>& get_latencies() const
+    {
+        return this->latencies;
+    }
+
+    /** Get the updates requested to the in-memory screen. */
+    const std::vector<rmioc::screen_memory::update_record>&
+    get_updates() const
+    {
+        return this->inner->get_updates();
+    }
+
+private:
+    std::unique_ptr<rmioc::screen_memory> inner;
+    chrono::steady_clock::time_point origin;
+    std::vector<chrono::nanoseconds> latencies;
+    std::uint32_t last_stamp = 0;
+
+    void read_stamp()
+    {
+        auto now = chrono::steady_clock::now();
+        const auto* data = this->inner->get_data();
+        std::size_t stride = this->inner->get_xres_memory();
+        std::uint32_t value = 0;
+
+        for (int bit = 0; bit < bench::stamp::bits; ++bit)
+        {
+            // Sample the center of each block
+            std::size_t index = stride * (bench::stamp::block / 2)
+                + bit * bench::stamp::block + bench::stamp::block / 2;
+            std::uint16_t pixel = 0;
+
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+            std::memcpy(&pixel, data + index * sizeof(pixel), sizeof(pixel));
+
+            constexpr std::uint16_t half = 0x7FFF;
+            value = (value << 1U) | (pixel > half ? 1U : 0U);
+        }
+
+        if (value != 0 && value != this->last_stamp)
+        {
+            this->last_stamp = value;
+            this->latencies.push_back(
+                chrono::duration_cast<chrono::nanoseconds>(
+                    now - this->origin) - chrono::microseconds{value});
+        }
+    }
+}; // class stamp_screen
+
+/**
+ * Print a short help message with usage information.
+ *
+ * @param name Name of the current executable file.
+ */
+void help(const char* name)
+{
+    std::cout << "Usage: " << name << " [OPTION...]\n"
+"Run a VNC server generating a scripted workload, connect the client to it\n"
+"with an in-memory screen and print the time between the drawing of frames\n"
+"on the server and their repaint on the client as a JSON object.\n\n"
+"Available options:\n"
+"  -h, --help           Show this help message and exit.\n"
+"  --workload=NAME      Activity to generate: typing (default), scroll,\n"
+"                       video or flip.\n"
+"  --size=WxH           Size of the server screen (default 1404x1872).\n"
+"  --rate=FPS           Number of frames generated each second (defaults to\n"
+"                       10, 5, 24 and 1 for each workload).\n"
+"  --duration=SECONDS   Time during which frames are generated (default 10).\n"
+"  --latency-target=MS  Let the client switch to the Tight encoding when a\n"
+"                       whole screen would take longer than MS milliseconds\n"
+"                       to receive, as with vnsee --latency-target.\n"
+"  --pixel-format=FORMAT\n"
+"                       Ask the server for pixels in FORMAT: screen\n"
+"                       (default), rgb32 or bgr32. The server only sends\n"
+"                       Tight rectangles as JPEG with 32-bit pixels.\n"
+"  --serve-only[=PORT]  Only run the server on PORT (default 5900), for\n"
+"                       example to connect a reMarkable to it.\n";
+}
+
+} // anonymous namespace
+
+// NOLINTNEXTLINE(readability-function-cognitive-complexity)
+auto main(int argc, const char* argv[]) -> int
+{
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    const char* const name = argv[0];
+    auto [opts, oper] = options::parse(argv + 1, argv + argc);
+    bench::server_settings settings;
+    app::client_options client_options;
+    std::string workload_name = "typing";
+    std::string format_name = "screen";
+    bool serve_only = false;
+    bool has_rate = false;
+
+    if ((opts.count("help") >= 1) || (opts.count("h") >= 1))
+    {
+        help(name);
+        return EXIT_SUCCESS;
+    }
+
+    try
+    {
+        if (opts.count("workload") >= 1 && !opts["workload"].empty())
+        {
+            workload_name = opts["workload"].back();
+            auto entry = std::find_if(
+                workload_names.begin(), workload_names.end(),
+                [&workload_name](const auto& item)
+                {
+                    return workload_name == item.first;
+                }
+            );
+
+            if (entry == workload_names.end())
+            {
+                throw std::invalid_argument{workload_name};
+            }
+
+            settings.workload = entry->second;
+        }
+
+        if (opts.count("size") >= 1 && !opts["size"].empty())
+        {
+            const auto& size = opts["size"].back();
+            auto separator = size.find('x');
+
+            if (separator == std::string::npos)
+            {
+                throw std::invalid_argument{size};
+            }
+
+            settings.xres = std::stoi(size.substr(0, separator));
+            settings.yres = std::stoi(size.substr(separator + 1));
+
+            if (settings.xres < bench::stamp::width || settings.yres <= 0)
+            {
+                throw std::invalid_argument{size};
+            }
+        }
+
+        if (opts.count("rate") >= 1 && !opts["rate"].empty())
+        {
+            settings.rate = std::stod(opts["rate"].back());
+            has_rate = settings.rate > 0;
+
+            if (!has_rate)
+            {
+                throw std::invalid_argument{opts["rate"].back()};
+            }
+        }
+
+        if (opts.count("duration") >= 1 && !opts["duration"].empty())
+        {
+            settings.duration = chrono::milliseconds{static_cast<long>(
+                std::stod(opts["duration"].back()) * 1000)};
+        }
+
+        if (opts.count("latency-target") >= 1
+                && !opts["latency-target"].empty())
+        {
+            const auto& target = opts["latency-target"].back();
+            std::size_t end = 0;
+            int target_ms = std::stoi(target, &end);
+
+            if (end != target.size() || target_ms < 0)
+            {
+                throw std::invalid_argument{target};
+            }
+
+            client_options.latency_target = chrono::milliseconds{target_ms};
+        }
+
+        if (opts.count("pixel-format") >= 1 && !opts["pixel-format"].empty())
+        {
+            format_name = opts["pixel-format"].back();
+            auto entry = std::find_if(
+                format_names.begin(), format_names.end(),
+                [&format_name](const auto& item)
+                {
+                    return format_name == item.first;
+                }
+            );
+
+            if (entry == format_names.end())
+            {
+                throw std::invalid_argument{format_name};
+            }
+
+            client_options.server_format = entry->second;
+        }
+
+        if (opts.count("serve-only") >= 1)
+        {
+            constexpr int default_port = 5900;
+            serve_only = true;
+            settings.port = opts["serve-only"].empty()
+                ? default_port
+                : std::stoi(opts["serve-only"].back());
+        }
+    }
+    catch (const std::logic_error&)
+    {
+        std::cerr << "Invalid option value.\n"
+            "Run “" << name << " --help” for more information.\n";
+        return EXIT_FAILURE;
+    }
+
+    if (!has_rate)
+    {
+        settings.rate = default_rate(settings.workload);
+    }
+
+    try
+    {
+        bench::synthetic_server server{settings};
+
+        if (serve_only)
+        {
+            std::cerr << "Listening on port " << server.get_port() << '\n';
+            server.run();
+            std::cerr << "Generated " << server.get_frames() << " frames\n";
+            return EXIT_SUCCESS;
+        }
+
+        auto memory = std::make_unique<rmioc::screen_memory>(
+            settings.xres, settings.yres);
+        auto screen = std::make_unique<stamp_screen>(
+            std::move(memory), server.get_start());
+        auto* stamps = screen.get();
+        auto device = rmioc::device::headless(std::move(screen));
+
+        std::thread server_thread{[&server]() { server.run(); }};
+
+        try
+        {
+            app::client client{
+                "127.0.0.1", server.get_port(), device, client_options};
+            client.event_loop();
+        }
+        catch (...)
+        {
+            server.stop();
+            server_thread.join();
+            throw;
+        }
+
+        server.stop();
+        server_thread.join();
+
+        std::array<std::size_t, rmioc::waveform_mode_count> repaints{};
+
+        for (const auto& update : stamps->get_updates())
+        {
+            auto mode = static_cast<std::size_t>(update.mode);
+
+            if (mode < repaints.size())
+            {
+                ++repaints.at(mode);
+            }
+        }
+
+        std::cout << "{\"name\":\"end_to_end\",\"workload\":\""
+            << workload_name
+            << "\",\"xres\":" << settings.xres
+            << ",\"yres\":" << settings.yres
+            << ",\"rate\":" << settings.rate
+            << ",\"latency_target_ms\":"
+            << client_options.latency_target.count()
+            << ",\"pixel_format\":\"" << format_name << '"'
+            << ",\"frames_sent\":" << server.get_frames()
+            << ",\"frames_repainted\":" << stamps->get_latencies().size()
+            << ",\"latency\":";
+        stats::write_distribution(std::cout, stamps->get_latencies());
+        std::cout << ",\"bytes\":{";
+
+        for (std::size_t index = 0; index < encoding_names.size(); ++index)
+        {
+            if (index > 0)
+            {
+                std::cout << ',';
+            }
+
+            std::string labels = "encoding=\"";
+            labels += encoding_names.at(index);
+            labels += '"';
+            std::cout << '"' << encoding_names.at(index) << "\":"
+                << bench::read_counter(
+                    "vnsee_vnc_received_bytes_total", labels.c_str());
+        }
+
+        std::cout << "},\"rects\":"
+            << bench::read_counter("vnsee_rects_decoded_total")
+            << ",\"encoding_switches\":"
+            << bench::read_counter("vnsee_encoding_switches_total")
+            << ",\"repaints\":{";
+
+        for (std::size_t mode = 0; mode < rmioc::waveform_mode_count; ++mode)
+        {
+            if (mode > 0)
+            {
+                std::cout << ',';
+            }
+
+            std::cout << '"' << rmioc::get_waveform_name(
+                    static_cast<rmioc::waveform_modes>(mode))
+                << "\":"
+                << repaints.at(mode);
+        }
+
+        std::cout << "}}\n";
+    }
+    catch (const std::exception& err)
+    {
+        std::cerr << "Error: " << err.what() << '\n';
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
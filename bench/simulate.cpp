@@ -0,0 +1,781 @@
+#include "harness.hpp"
+#include "../src/app/buttons.hpp"
+#include "../src/app/clock.hpp"
+#include "../src/app/event_loop.hpp"
+#include "../src/app/pen.hpp"
+#include "../src/app/screen.hpp"
+#include "../src/app/touch.hpp"
+#include "../src/capture.hpp"
+#include "../src/options.hpp"
+#include "../src/rmioc/buttons.hpp"
+#include "../src/rmioc/device.hpp"
+#include "../src/rmioc/input_record.hpp"
+#include "../src/rmioc/pen.hpp"
+#include "../src/rmioc/screen_memory.hpp"
+#include "../src/rmioc/touch.hpp"
+#include "../src/stats.hpp"
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+#include <poll.h>
+#include <rfb/rfbclient.h>
+#include <rfb/rfbproto.h>
+
+namespace chrono = std::chrono;
+
+namespace
+{
+
+constexpr int default_xres = 1404;
+constexpr int default_yres = 1872;
+
+/**
+ * Initial time of the simulated clock.
+ *
+ * Handlers assume that their last action happened long before they were
+ * created, which is true of the monotonic clock but not near its epoch.
+ */
+constexpr chrono::hours simulation_start{1};
+
+/** Rectangle sent by the server, either raw pixels or a copy. */
+struct server_rect
+{
+    int x;
+    int y;
+    int w;
+    int h;
+
+    /** Pixel data, pointing inside the capture, or null for a copy. */
+    const std::uint8_t* pixels;
+
+    /** Top left corner of the copied region, for copies. */
+    int src_x;
+    int src_y;
+};
+
+/** Message sent by the server, reduced to what affects the screen. */
+struct server_message
+{
+    /** Time at which the message was fully received. */
+    chrono::microseconds time{0};
+
+    /** Rectangles carried by the message, if it is an update. */
+    std::vector<server_rect> rects;
+};
+
+/**
+ * Parser for the server side of a captured session.
+ *
+ * Handles what the VNC library negotiates for vnsee: no authentication or
+ * VNC authentication, the raw and CopyRect encodings and the
+ * pseudo-encodings that the library always announces. Pixel data must use the same pixel size as the
+ * simulated screen.
+ */
+class server_stream
+{
+public:
+    server_stream(const capture::session& captured, std::size_t pixel_size)
+    : captured(captured)
+    , pixel_size(pixel_size)
+    {
+        if (!captured.chunks.empty())
+        {
+            this->time = captured.chunks.front().delay;
+        }
+    }
+
+    /**
+     * Skip the handshake.
+     *
+     * @return Size of the remote framebuffer.
+     * @throws std::runtime_error If the handshake is not supported.
+     */
+    std::pair<int, int> read_handshake()
+    {
+        const auto* version = this->take(sz_rfbProtocolVersionMsg);
+
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        std::string text{reinterpret_cast<const char*>(version),
+            sz_rfbProtocolVersionMsg};
+
+        if (text.compare(0, 4, "RFB ") != 0)
+        {
+            throw std::runtime_error{"(simulate) Not a VNC session"};
+        }
+
+        constexpr int minor_offset = 8;
+        constexpr int minor_length = 3;
+        int minor = std::stoi(text.substr(minor_offset, minor_length));
+        std::uint32_t security = rfbConnFailed;
+
+        if (minor < 7)
+        {
+            security = this->take_u32();
+        }
+        else
+        {
+            // The library picks the first supported type offered
+            auto count = this->take_u8();
+
+            for (std::uint8_t i = 0; i < count; ++i)
+            {
+                auto type = this->take_u8();
+
+                if (security == rfbConnFailed
+                        && (type == rfbNoAuth || type == rfbVncAuth))
+                {
+                    security = type;
+                }
+            }
+        }
+
+        if (security != rfbNoAuth && security != rfbVncAuth)
+        {
+            throw std::runtime_error{"(simulate) Unsupported security type"};
+        }
+
+        if (security == rfbVncAuth)
+        {
+            constexpr std::size_t challenge_size = 16;
+            this->take(challenge_size);
+        }
+
+        if ((security == rfbVncAuth || minor >= 8)
+                && this->take_u32() != rfbVncAuthOK)
+        {
+            throw std::runtime_error{"(simulate) Authentication failed"};
+        }
+
+        int width = this->take_u16();
+        int height = this->take_u16();
+        this->take(sz_rfbPixelFormat);
+        this->take(this->take_u32());
+        return {width, height};
+    }
+
+    /**
+     * Parse the next message.
+     *
+     * @param message Message to fill.
+     * @return False if the capture ends before the next complete message.
+     * @throws std::runtime_error If the message is not supported.
+     */
+    bool next(server_message& message)
+    {
+        message.rects.clear();
+
+        try
+        {
+            auto type = this->take_u8();
+
+            switch (type)
+            {
+            case rfbFramebufferUpdate:
+                this->take(1);
+                this->read_rects(message, this->take_u16());
+                break;
+
+            case rfbSetColourMapEntries:
+            {
+                constexpr std::size_t colour_size = 6;
+                this->take(1);
+                this->take_u16();
+                this->take(this->take_u16() * colour_size);
+                break;
+            }
+
+            case rfbBell:
+                break;
+
+            case rfbServerCutText:
+                this->take(3);
+                this->take(this->take_u32());
+                break;
+
+            default:
+                throw std::runtime_error{
+                    "(simulate) Unsupported message type "
+                    + std::to_string(type)};
+            }
+        }
+        catch (const std::out_of_range&)
+        {
+            return false;
+        }
+
+        this->seek_time();
+        message.time = this->time;
+        return true;
+    }
+
+private:
+    /** Captured session. */
+    const capture::session& captured;
+
+    /** Size of a pixel in raw rectangles (in bytes). */
+    std::size_t pixel_size;
+
+    /** Offset of the next byte to read. */
+    std::size_t position = 0;
+
+    /** Index of the chunk containing the last byte read. */
+    std::size_t chunk = 0;
+
+    /** Time at which that chunk was received. */
+    chrono::microseconds time{0};
+
+    /** Read the rectangles of a framebuffer update. */
+    void read_rects(server_message& message, std::uint16_t count)
+    {
+        for (std::uint16_t i = 0; i < count; ++i)
+        {
+            int x = this->take_u16();
+            int y = this->take_u16();
+            int w = this->take_u16();
+            int h = this->take_u16();
+            auto encoding = this->take_u32();
+
+            switch (encoding)
+            {
+            case rfbEncodingRaw:
+                message.rects.push_back(server_rect{x, y, w, h, this->take(
+                    static_cast<std::size_t>(w) * h * this->pixel_size),
+                    0, 0});
+                break;
+
+            case rfbEncodingCopyRect:
+            {
+                int src_x = this->take_u16();
+                int src_y = this->take_u16();
+                message.rects.push_back(server_rect{
+                    x, y, w, h, nullptr, src_x, src_y});
+                break;
+            }
+
+            case rfbEncodingLastRect:
+                return;
+
+            case rfbEncodingNewFBSize:
+            case rfbEncodingKeyboardLedState:
+            case rfbEncodingPointerPos:
+                break;
+
+            case rfbEncodingSupportedMessages:
+                this->take(sz_rfbSupportedMessages);
+                break;
+
+            case rfbEncodingSupportedEncodings:
+            case rfbEncodingServerIdentity:
+                this->take(w);
+                break;
+
+            case rfbEncodingExtDesktopSize:
+            {
+                constexpr std::size_t screen_size = 16;
+                auto screens = this->take_u8();
+                this->take(3);
+                this->take(screens * screen_size);
+                break;
+            }
+
+            default:
+                throw std::runtime_error{
+                    "(simulate) Unsupported encoding "
+                    + std::to_string(encoding)};
+            }
+        }
+    }
+
+    /**
+     * Consume bytes from the capture.
+     *
+     * @throws std::out_of_range If the capture ends before.
+     */
+    const std::uint8_t* take(std::size_t length)
+    {
+        if (length > this->captured.data.size() - this->position)
+        {
+            throw std::out_of_range{"(simulate) Truncated capture"};
+        }
+
+        const auto* result = &this->captured.data[this->position];
+        this->position += length;
+        return result;
+    }
+
+    std::uint8_t take_u8()
+    {
+        return *this->take(1);
+    }
+
+    std::uint16_t take_u16()
+    {
+        const auto* bytes = this->take(2);
+
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        return static_cast<std::uint16_t>((bytes[0] << CHAR_BIT) | bytes[1]);
+    }
+
+    std::uint32_t take_u32()
+    {
+        std::uint32_t high = this->take_u16();
+        std::uint32_t low = this->take_u16();
+        return (high << 2 * CHAR_BIT) | low;
+    }
+
+    /** Find the time at which the last byte read was received. */
+    void seek_time()
+    {
+        const auto& chunks = this->captured.chunks;
+
+        while (this->chunk + 1 < chunks.size()
+                && chunks[this->chunk].offset + chunks[this->chunk].length
+                    < this->position)
+        {
+            ++this->chunk;
+            this->time += chunks[this->chunk].delay;
+        }
+    }
+}; // class server_stream
+
+/**
+ * Print a short help message with usage information.
+ *
+ * @param name Name of the current executable file.
+ */
+void help(const char* name)
+{
+    std::cout << "Usage: " << name << " CAPTURE [OPTION...]\n"
+"Replay a VNC session captured with “vnsee --capture=CAPTURE” and optionally\n"
+"input events recorded with “vnsee --record-input=FILE” on a simulated clock,\n"
+"jumping from one event to the next instead of waiting, and print the\n"
+"repaint latencies and counts as a JSON object.\n\n"
+"Available options:\n"
+"  -h, --help           Show this help message and exit.\n"
+"  --input=FILE         Input events to replay alongside the session.\n"
+"  --screen=WxH         Size of the in-memory screen (default 1404x1872).\n"
+"  --standard-delay=MS  Minimal time between two standard repaints.\n"
+"  --fast-delay=MS      Minimal time between two fast repaints.\n";
+}
+
+} // anonymous namespace
+
+// NOLINTNEXTLINE(readability-function-cognitive-complexity)
+auto main(int argc, const char* argv[]) -> int
+{
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    const char* const name = argv[0];
+    auto [opts, oper] = options::parse(argv + 1, argv + argc);
+    int xres = default_xres;
+    int yres = default_yres;
+    std::string input_path;
+    std::optional<chrono::milliseconds> standard_delay;
+    std::optional<chrono::milliseconds> fast_delay;
+
+    if ((opts.count("help") >= 1) || (opts.count("h") >= 1))
+    {
+        help(name);
+        return EXIT_SUCCESS;
+    }
+
+    if (oper.size() != 1)
+    {
+        std::cerr << "Expected exactly one capture file.\n"
+            "Run “" << name << " --help” for more information.\n";
+        return EXIT_FAILURE;
+    }
+
+    try
+    {
+        if (opts.count("input") >= 1 && !opts["input"].empty())
+        {
+            input_path = opts["input"].back();
+        }
+
+        if (opts.count("screen") >= 1 && !opts["screen"].empty())
+        {
+            const auto& size = opts["screen"].back();
+            auto separator = size.find('x');
+
+            if (separator == std::string::npos)
+            {
+                throw std::invalid_argument{size};
+            }
+
+            xres = std::stoi(size.substr(0, separator));
+            yres = std::stoi(size.substr(separator + 1));
+        }
+
+        for (auto [option, value] : {
+            std::make_pair("standard-delay", &standard_delay),
+            std::make_pair("fast-delay", &fast_delay),
+        })
+        {
+            if (opts.count(option) >= 1 && !opts[option].empty())
+            {
+                *value = chrono::milliseconds{
+                    std::stol(opts[option].back())};
+            }
+        }
+    }
+    catch (const std::logic_error&)
+    {
+        std::cerr << "Invalid option value.\n"
+            "Run “" << name << " --help” for more information.\n";
+        return EXIT_FAILURE;
+    }
+
+    try
+    {
+        auto captured = capture::load(oper[0].c_str());
+
+        auto screen = std::make_unique<rmioc::screen_memory>(xres, yres);
+        auto* memory_screen = screen.get();
+        auto device = rmioc::device::headless(std::move(screen));
+        std::optional<rmioc::input_replay> replay;
+
+        if (!input_path.empty())
+        {
+            replay.emplace(input_path.c_str(), /* real_time = */ true);
+            device.set_inputs(
+                replay->take_buttons(),
+                replay->take_touch(),
+                replay->take_pen()
+            );
+        }
+
+        app::virtual_clock clock{app::clock::time_point{simulation_start}};
+        const auto origin = clock.now();
+
+        // The client is never connected, messages are fed to it directly
+        std::unique_ptr<rfbClient, decltype(&rfbClientCleanup)> vnc_client{
+            rfbGetClient(0, 0, 0), rfbClientCleanup};
+        app::screen screen_handler{*memory_screen, vnc_client.get(), clock};
+
+        if (standard_delay.has_value())
+        {
+            screen_handler.set_repaint_delay(
+                app::screen::repaint_modes::standard, *standard_delay);
+        }
+
+        if (fast_delay.has_value())
+        {
+            screen_handler.set_repaint_delay(
+                app::screen::repaint_modes::fast, *fast_delay);
+        }
+
+        server_stream stream{
+            captured,
+            memory_screen->get_bits_per_pixel() / static_cast<unsigned>(
+                CHAR_BIT)
+        };
+
+        auto [width, height] = stream.read_handshake();
+        vnc_client->width = width;
+        vnc_client->height = height;
+        vnc_client->MallocFrameBuffer(vnc_client.get());
+
+        // Measure the time between the first damage and the next repaint
+        std::optional<app::clock::time_point> first_damage;
+        std::vector<chrono::nanoseconds> latencies;
+        std::size_t seen_updates = 0;
+
+        screen_handler.set_damage_callback(
+            [&first_damage, &clock](int /* x */, int /* y */,
+                int /* w */, int /* h */)
+            {
+                if (!first_damage.has_value())
+                {
+                    first_damage = clock.now();
+                }
+            }
+        );
+
+        std::size_t pointer_events = 0;
+
+        auto button_callback = [&pointer_events](
+            int /* x */, int /* y */, app::MouseButton /* button */)
+        {
+            ++pointer_events;
+        };
+
+        std::optional<app::buttons> buttons_handler;
+        std::optional<app::pen> pen_handler;
+        std::optional<app::touch> touch_handler;
+        std::vector<pollfd> polled_fds;
+        std::size_t poll_buttons = -1;
+        std::size_t poll_pen = -1;
+        std::size_t poll_touch = -1;
+
+        if (device.get_buttons() != nullptr)
+        {
+            buttons_handler.emplace(*device.get_buttons(), *memory_screen);
+            poll_buttons = polled_fds.size();
+            polled_fds.push_back(pollfd{});
+            device.get_buttons()->setup_poll(polled_fds[poll_buttons]);
+        }
+
+        if (device.get_pen() != nullptr)
+        {
+            pen_handler.emplace(
+                *device.get_pen(), screen_handler, button_callback);
+            poll_pen = polled_fds.size();
+            polled_fds.push_back(pollfd{});
+            device.get_pen()->setup_poll(polled_fds[poll_pen]);
+        }
+
+        if (device.get_touch() != nullptr)
+        {
+            touch_handler.emplace(
+                *device.get_touch(), *memory_screen,
+                button_callback, clock);
+            poll_touch = polled_fds.size();
+            polled_fds.push_back(pollfd{});
+            device.get_touch()->setup_poll(polled_fds[poll_touch]);
+        }
+
+        auto has_pending_events = [&]()
+        {
+            return (pen_handler.has_value()
+                    && pen_handler->has_pending_events())
+                || (buttons_handler.has_value()
+                    && buttons_handler->has_pending_events())
+                || (touch_handler.has_value()
+                    && touch_handler->has_pending_events());
+        };
+
+        // Let the handlers process all the events written to the devices,
+        // one report at a time
+        auto process_inputs = [&]()
+        {
+            bool quit = false;
+
+            while (true)
+            {
+                int ready = poll(polled_fds.data(), polled_fds.size(), 0);
+
+                if (ready == -1)
+                {
+                    if (errno == EINTR)
+                    {
+                        continue;
+                    }
+
+                    throw std::system_error(
+                        errno,
+                        std::generic_category(),
+                        "(simulate) Poll input devices"
+                    );
+                }
+
+                if (ready == 0 && !has_pending_events())
+                {
+                    return quit;
+                }
+
+                if (pen_handler.has_value()
+                // NOLINTNEXTLINE(hicpp-signed-bitwise): Use of C library
+                        && ((polled_fds[poll_pen].revents & POLLIN) != 0
+                            || pen_handler->has_pending_events()))
+                {
+                    quit |= pen_handler->process_events().quit;
+                }
+
+                bool inhibit = pen_handler.has_value()
+                    && pen_handler->is_inhibiting();
+
+                if (buttons_handler.has_value()
+                // NOLINTNEXTLINE(hicpp-signed-bitwise): Use of C library
+                        && ((polled_fds[poll_buttons].revents & POLLIN) != 0
+                            || buttons_handler->has_pending_events()))
+                {
+                    quit |= buttons_handler->process_events(inhibit).quit;
+                }
+
+                if (touch_handler.has_value()
+                // NOLINTNEXTLINE(hicpp-signed-bitwise): Use of C library
+                        && ((polled_fds[poll_touch].revents & POLLIN) != 0
+                            || touch_handler->has_pending_events()))
+                {
+                    quit |= touch_handler->process_events(inhibit).quit;
+                }
+            }
+        };
+
+        server_message message;
+        bool has_message = stream.next(message);
+        std::size_t messages = 0;
+        bool quit = false;
+        auto wall_start = chrono::steady_clock::now();
+
+        while (!quit)
+        {
+            auto now = clock.now();
+
+            while (has_message && origin + message.time <= now)
+            {
+                for (const auto& rect : message.rects)
+                {
+                    if (rect.pixels == nullptr)
+                    {
+                        vnc_client->GotCopyRect(
+                            vnc_client.get(),
+                            rect.src_x, rect.src_y, rect.w, rect.h,
+                            rect.x, rect.y);
+                    }
+                    else
+                    {
+                        vnc_client->GotBitmap(
+                            vnc_client.get(), rect.pixels,
+                            rect.x, rect.y, rect.w, rect.h);
+                    }
+
+                    vnc_client->GotFrameBufferUpdate(
+                        vnc_client.get(),
+                        rect.x, rect.y, rect.w, rect.h);
+                }
+
+                if (vnc_client->FinishedFrameBufferUpdate != nullptr)
+                {
+                    vnc_client->FinishedFrameBufferUpdate(vnc_client.get());
+                }
+
+                ++messages;
+                has_message = stream.next(message);
+            }
+
+            long input_wait = -1;
+
+            if (replay.has_value())
+            {
+                // Pumping stops when a pipe is full, until it is read
+                do
+                {
+                    input_wait = replay->pump(now);
+                    quit |= process_inputs();
+                }
+                while (input_wait == 0);
+            }
+
+            auto status = screen_handler.event_loop();
+            quit |= status.quit;
+
+            if (memory_screen->get_updates().size() > seen_updates)
+            {
+                seen_updates = memory_screen->get_updates().size();
+
+                if (first_damage.has_value())
+                {
+                    latencies.push_back(
+                        chrono::duration_cast<chrono::nanoseconds>(
+                            now - *first_damage));
+                    first_damage.reset();
+                }
+            }
+
+            // Jump to the next time at which something happens
+            std::optional<app::clock::time_point> wake;
+
+            auto wake_at = [&wake](app::clock::time_point time)
+            {
+                if (!wake.has_value() || time < *wake)
+                {
+                    wake = time;
+                }
+            };
+
+            if (has_message)
+            {
+                wake_at(origin + message.time);
+            }
+
+            if (input_wait > 0)
+            {
+                wake_at(now + chrono::milliseconds{input_wait});
+            }
+
+            if (status.timeout >= 0)
+            {
+                wake_at(now + chrono::milliseconds{status.timeout});
+            }
+
+            if (!wake.has_value())
+            {
+                break;
+            }
+
+            clock.advance_to(*wake);
+        }
+
+        auto simulated = chrono::duration<double>(clock.now() - origin).count();
+        auto seconds = chrono::duration<double>(
+            chrono::steady_clock::now() - wall_start).count();
+
+        std::array<std::size_t, rmioc::waveform_mode_count> repaints{};
+
+        for (const auto& update : memory_screen->get_updates())
+        {
+            auto mode = static_cast<std::size_t>(update.mode);
+
+            if (mode < repaints.size())
+            {
+                ++repaints.at(mode);
+            }
+        }
+
+        std::cout << "{\"name\":\"simulation\",\"capture\":\"" << oper[0]
+            << "\",\"input\":\"" << input_path
+            << "\",\"standard_delay_ms\":"
+            << screen_handler.get_repaint_delay(
+                app::screen::repaint_modes::standard).count()
+            << ",\"fast_delay_ms\":"
+            << screen_handler.get_repaint_delay(
+                app::screen::repaint_modes::fast).count()
+            << ",\"simulated_seconds\":" << simulated
+            << ",\"seconds\":" << seconds
+            << ",\"speedup\":" << simulated / seconds
+            << ",\"messages\":" << messages
+            << ",\"rects\":"
+            << bench::read_counter("vnsee_rects_decoded_total")
+            << ",\"input_events\":"
+            << (replay.has_value() ? replay->get_event_count() : 0)
+            << ",\"pointer_events\":" << pointer_events
+            << ",\"latency\":";
+        stats::write_distribution(std::cout, latencies);
+        std::cout << ",\"repaints\":{";
+
+        for (std::size_t mode = 0; mode < rmioc::waveform_mode_count; ++mode)
+        {
+            if (mode > 0)
+            {
+                std::cout << ',';
+            }
+
+            std::cout << '"' << rmioc::get_waveform_name(
+                    static_cast<rmioc::waveform_modes>(mode))
+                << "\":"
+                << repaints.at(mode);
+        }
+
+        std::cout << "}}\n";
+    }
+    catch (const std::exception& err)
+    {
+        std::cerr << "Error: " << err.what() << '\n';
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
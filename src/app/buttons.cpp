@@ -1,10 +1,22 @@
 #include "buttons.hpp"
 #include "../rmioc/buttons.hpp"
 #include "../rmioc/screen.hpp"
+#include "../stats.hpp"
 
 namespace app
 {
 
+namespace
+{
+
+auto& full_repaints = stats::get_counter(
+    "vnsee_repaints_total",
+    "Screen repaints issued by waveform mode",
+    "waveform=\"gc16\""
+);
+
+} // anonymous namespace
+
 buttons::buttons(
     rmioc::buttons& device,
     rmioc::screen& screen_device
@@ -14,6 +26,11 @@ buttons::buttons(
 , previous_state{}
 {}
 
+auto buttons::has_pending_events() const -> bool
+{
+    return this->device.has_pending_events();
+}
+
 auto buttons::process_events(bool inhibit) -> event_loop_status
 {
     if (this->device.process_events())
@@ -32,6 +49,7 @@ auto buttons::process_events(bool inhibit) -> event_loop_status
             {
                 // Full screen refresh when pressing home
                 this->screen_device.update();
+                full_repaints.add();
             }
         }
 
@@ -21,12 +21,15 @@ public:
     );
 
     /**
-     * Process input from the physical buttons.
+     * Process the next report from the physical buttons.
      *
      * @param inhibit True to discard any event from the buttons.
      */
     event_loop_status process_events(bool inhibit);
 
+    /** Whether reports already read from the buttons await processing. */
+    bool has_pending_events() const;
+
 private:
     /** reMarkable buttons device. */
     rmioc::buttons& device;
@@ -2,20 +2,24 @@
 #include "../log.hpp"
 #include "../rmioc/buttons.hpp"
 #include "../rmioc/device.hpp"
+#include "../rmioc/input_record.hpp"
 #include "../rmioc/pen.hpp"
 #include "../rmioc/touch.hpp"
+#include "../stats.hpp"
+#include "../trace.hpp"
 #include <algorithm>
-#include <bitset>
+#include <chrono>
 #include <cerrno>
+#include <csignal>
 #include <cstdarg>
 #include <cstdint>
-#include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <functional>
-#include <iomanip>
+#include <future>
 #include <iostream>
 #include <memory>
+#include <optional>
 #include <stdexcept>
 #include <system_error>
 #include <vector>
@@ -24,23 +28,42 @@
 #include <unistd.h>
 // IWYU pragma: no_include <type_traits>
 
-/** Custom log printer for the VNC client library.  */
+/** Custom log printer for informational messages of the VNC library. */
 // NOLINTNEXTLINE(cert-dcl50-cpp): Need to use a vararg function for C compat
 void vnc_client_log(const char* format, ...)
 {
+    // Skip formatting entirely if the message would be discarded
+    if (!log::is_enabled(log::levels::info))
+    {
+        return;
+    }
+
     va_list args;
 
     // ↓ Use of C library
     // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg,hicpp-no-array-decay)
     va_start(args, format);
+    log::vprint(log::levels::info, "VNC message", format, args);
 
     // NOLINTNEXTLINE(hicpp-no-array-decay): Use of C library
-    ssize_t buffer_size = vsnprintf(nullptr, 0, format, args);
-    std::vector<char> buffer(buffer_size + 1);
+    va_end(args);
+}
 
-    // NOLINTNEXTLINE(hicpp-no-array-decay): Use of C library
-    vsnprintf(buffer.data(), buffer.size(), format, args);
-    log::print("VNC message") << buffer.data();
+/** Custom log printer for error messages of the VNC library. */
+// NOLINTNEXTLINE(cert-dcl50-cpp): Need to use a vararg function for C compat
+void vnc_client_err(const char* format, ...)
+{
+    if (!log::is_enabled(log::levels::error))
+    {
+        return;
+    }
+
+    va_list args;
+
+    // ↓ Use of C library
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg,hicpp-no-array-decay)
+    va_start(args, format);
+    log::vprint(log::levels::error, "VNC error", format, args);
 
     // NOLINTNEXTLINE(hicpp-no-array-decay): Use of C library
     va_end(args);
@@ -50,9 +73,96 @@ namespace app
 {
 
 using namespace std::placeholders;
+namespace chrono = std::chrono;
+
+namespace
+{
+
+/** Set by the signal handler when the user asks to quit. */
+// NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
+volatile std::sig_atomic_t quit_requested = 0;
 
-client::client(const char* ip, int port, rmioc::device& device)
-: vnc_client(rfbGetClient(0, 0, 0))
+void on_quit_signal(int /* signal */)
+{
+    quit_requested = 1;
+}
+
+auto& pointer_events_sent = stats::get_counter(
+    "vnsee_pointer_events_total",
+    "Pointer events sent to the server"
+);
+
+auto& loop_iterations = stats::get_counter(
+    "vnsee_event_loop_iterations_total",
+    "Number of event loop iterations"
+);
+
+auto& loop_busy_time = stats::get_counter(
+    "vnsee_event_loop_busy_microseconds_total",
+    "Total time spent processing events outside of poll"
+);
+
+auto& loop_last_time = stats::get_gauge(
+    "vnsee_event_loop_iteration_seconds",
+    "Time spent processing events in the last event loop iteration"
+);
+
+auto& reconnects_succeeded = stats::get_counter(
+    "vnsee_reconnects_total",
+    "Attempts to reconnect to the server after losing the connection",
+    "result=\"success\""
+);
+
+auto& reconnects_failed = stats::get_counter(
+    "vnsee_reconnects_total",
+    "Attempts to reconnect to the server after losing the connection",
+    "result=\"failure\""
+);
+
+auto& startup_connect_time = stats::get_gauge(
+    "vnsee_startup_seconds",
+    "Time spent in each startup phase",
+    "phase=\"connect\""
+);
+
+/** Time to wait before the first attempt to reconnect to the server. */
+constexpr chrono::milliseconds reconnect_initial_delay{250};
+
+/**
+ * Maximum time to wait between two attempts to reconnect to the server.
+ *
+ * The delay doubles after each failed attempt, up to this value.
+ */
+constexpr chrono::milliseconds reconnect_max_delay{8000};
+
+/**
+ * Longest time to wait for the server to accept a connection when
+ * reconnecting (in seconds).
+ *
+ * Quitting waits for the attempt in progress to finish.
+ */
+constexpr int reconnect_connect_timeout = 5;
+
+/** Time between two checks for the end of a reconnection attempt. */
+constexpr chrono::milliseconds reconnect_check_interval{50};
+
+} // anonymous namespace
+
+auto is_quit_requested() -> bool
+{
+    return quit_requested != 0;
+}
+
+client::client(
+    const char* ip, int port, rmioc::device& device,
+    const client_options& options
+)
+: server_ip(ip)
+, server_port(port)
+, reconnect(options.reconnect)
+, reconnect_delay(reconnect_initial_delay)
+, vnc_client(rfbGetClient(0, 0, 0))
+, input_replay(options.input_replay)
 {
     if (device.get_screen() == nullptr)
     {
@@ -61,21 +171,48 @@ client::client(const char* ip, int port, rmioc::device& device)
 
     auto& screen_device = *device.get_screen();
     this->screen_handler.emplace(screen_device, vnc_client);
+    this->screen_handler->set_server_format(options.server_format);
+
+    if (options.debug_hud)
+    {
+        this->screen_handler->enable_hud();
+    }
+
+    if (options.idle_timeout.count() > 0)
+    {
+        this->screen_handler->set_idle_timeout(options.idle_timeout);
+    }
+
+    if (options.latency_target.count() > 0)
+    {
+        this->screen_handler->set_latency_target(options.latency_target);
+    }
+
+    if (options.local_cursor)
+    {
+        this->screen_handler->enable_cursor();
+    }
+
+    if (options.on_damage)
+    {
+        this->screen_handler->set_damage_callback(options.on_damage);
+    }
 
     rfbClientLog = vnc_client_log;
-    rfbClientErr = vnc_client_log;
+    rfbClientErr = vnc_client_err;
 
-    // ↓ Use of C library
-    // NOLINTNEXTLINE(cppcoreguidelines-owning-memory,cppcoreguidelines-no-malloc)
-    free(this->vnc_client->serverHost);
-    this->vnc_client->serverHost = strdup(ip);
-    this->vnc_client->serverPort = port;
+    // Input devices are still being discovered in the background while
+    // the connection is established
+    auto connect_start = chrono::steady_clock::now();
 
-    if (rfbInitClient(this->vnc_client, nullptr, nullptr) == 0)
+    if (!this->connect())
     {
         throw std::runtime_error{"Failed to initialize VNC connection"};
     }
 
+    startup_connect_time.set(chrono::duration<double>(
+        chrono::steady_clock::now() - connect_start).count());
+
     if (device.get_buttons() != nullptr)
     {
         auto& buttons_device = *device.get_buttons();
@@ -96,6 +233,11 @@ client::client(const char* ip, int port, rmioc::device& device)
         this->pen_handler.emplace(
             pen_device, *this->screen_handler,
             button_callback);
+        this->pen_handler->set_tolerance(options.pen_tolerance);
+        this->pen_handler->set_prediction(
+            options.pen_prediction,
+            options.pen_prediction_events
+        );
         this->poll_pen = this->polled_fds.size();
         this->polled_fds.push_back(pollfd{});
         pen_device.setup_poll(this->polled_fds[this->poll_pen]);
@@ -112,6 +254,40 @@ client::client(const char* ip, int port, rmioc::device& device)
         touch_device.setup_poll(this->polled_fds[this->poll_touch]);
     }
 
+    // Completions are only reported through metrics and traces
+    int completion_fd = options.metrics_socket != nullptr
+            || trace::is_enabled()
+        ? this->screen_handler->track_completions()
+        : -1;
+
+    if (completion_fd != -1)
+    {
+        this->poll_completions = this->polled_fds.size();
+        this->polled_fds.push_back(pollfd{
+            /* fd = */ completion_fd,
+            /* events = */ POLLIN,
+            /* revents = */ 0
+        });
+    }
+
+    if (options.metrics_socket != nullptr)
+    {
+        this->metrics_handler.emplace(options.metrics_socket);
+        this->poll_metrics = this->polled_fds.size();
+        this->polled_fds.push_back(pollfd{});
+        this->metrics_handler->setup_poll(
+            this->polled_fds[this->poll_metrics]);
+    }
+
+    // Leave the event loop cleanly when interrupted, so that resources are
+    // released and recorded data is written. Blocking reads are not
+    // restarted, so that they can give up
+    struct sigaction quit_action{};
+    quit_action.sa_handler = on_quit_signal;
+    sigemptyset(&quit_action.sa_mask);
+    sigaction(SIGINT, &quit_action, nullptr);
+    sigaction(SIGTERM, &quit_action, nullptr);
+
     this->poll_vnc = this->polled_fds.size();
     this->polled_fds.push_back(pollfd{
         /* fd = */ this->vnc_client->sock,
@@ -122,7 +298,20 @@ client::client(const char* ip, int port, rmioc::device& device)
 
 client::~client()
 {
-    rfbClientCleanup(this->vnc_client);
+    if (this->pending_connection.valid())
+    {
+        rfbClient* next = this->pending_connection.get();
+
+        if (next != nullptr)
+        {
+            rfbClientCleanup(next);
+        }
+    }
+
+    if (this->vnc_client != nullptr)
+    {
+        rfbClientCleanup(this->vnc_client);
+    }
 }
 
 // NOLINTNEXTLINE(readability-function-cognitive-complexity)
@@ -156,12 +345,17 @@ auto client::event_loop() -> bool
     // Wait for events from the VNC server or from device inputs
     while (!quit)
     {
+        if (quit_requested != 0)
+        {
+            return true;
+        }
+
         while (poll(
                     this->polled_fds.data(),
                     this->polled_fds.size(),
                     static_cast<int>(timeout)) == -1)
         {
-            if (errno != EAGAIN)
+            if (errno != EAGAIN && errno != EINTR)
             {
                 throw std::system_error(
                     errno,
@@ -169,63 +363,285 @@ auto client::event_loop() -> bool
                     "(client::event_loop) Wait for message"
                 );
             }
+
+            if (quit_requested != 0)
+            {
+                return true;
+            }
         }
 
         timeout = -1;
+        trace::handle_signals();
+        auto iteration_start = chrono::steady_clock::now();
 
         // NOLINTNEXTLINE(hicpp-signed-bitwise): Use of C library
         if ((polled_fds[this->poll_vnc].revents & POLLIN) != 0)
         {
-            if (HandleRFBServerMessage(this->vnc_client) == 0)
+            trace::span span{trace::stages::vnc_message};
+
+            if (!this->screen_handler->handle_message())
+            {
+                if (quit_requested != 0)
+                {
+                    // Reception was given up to quit
+                    return true;
+                }
+
+                if (this->screen_handler->fall_back_server_format())
+                {
+                    // Some servers close the connection when asked for a
+                    // pixel format that they cannot send
+                    this->disconnect("Server refused the pixel format, "
+                        "retrying with 32-bit pixels");
+                }
+                else if (!this->reconnect)
+                {
+                    return false;
+                }
+                else
+                {
+                    this->disconnect("Connection lost, reconnecting");
+                }
+            }
+        }
+
+        if (this->vnc_client == nullptr)
+        {
+            auto status = this->try_reconnect();
+
+            if (!status.has_value())
             {
                 return false;
             }
+
+            handle_status(*status);
+        }
+
+        if (this->poll_completions != static_cast<std::size_t>(-1)
+        // NOLINTNEXTLINE(hicpp-signed-bitwise): Use of C library
+                && (polled_fds[this->poll_completions].revents & POLLIN) != 0)
+        {
+            handle_status(this->screen_handler->process_completions());
         }
 
         handle_status(this->screen_handler->event_loop());
 
+        if (this->input_replay != nullptr)
+        {
+            handle_status({
+                /* quit = */ this->input_replay->is_done()
+                    && !this->has_pending_input(),
+                /* timeout = */ this->input_replay->pump()
+            });
+        }
+
+        // Any input ends the idle period of the screen
+        bool has_input = false;
+
+        // Devices process one report per call, reports that were already
+        // read are processed even if no new data arrived
         if (this->pen_handler.has_value()
         // NOLINTNEXTLINE(hicpp-signed-bitwise): Use of C library
-                && (polled_fds[this->poll_pen].revents & POLLIN) != 0)
+                && ((polled_fds[this->poll_pen].revents & POLLIN) != 0
+                    || this->pen_handler->has_pending_events()))
         {
+            has_input = true;
+            trace::span span{trace::stages::pen};
             handle_status(this->pen_handler->process_events());
         }
+        else if (this->pen_handler.has_value())
+        {
+            handle_status(this->pen_handler->event_loop());
+        }
 
         bool inhibit = this->pen_handler.has_value()
             && this->pen_handler->is_inhibiting();
 
         if (this->buttons_handler.has_value()
         // NOLINTNEXTLINE(hicpp-signed-bitwise): Use of C library
-                && (polled_fds[this->poll_buttons].revents & POLLIN) != 0)
+                && ((polled_fds[this->poll_buttons].revents & POLLIN) != 0
+                    || this->buttons_handler->has_pending_events()))
         {
+            has_input = true;
+            trace::span span{trace::stages::buttons};
             handle_status(this->buttons_handler->process_events(inhibit));
         }
 
         if (this->touch_handler.has_value()
         // NOLINTNEXTLINE(hicpp-signed-bitwise): Use of C library
-                && (polled_fds[this->poll_touch].revents & POLLIN) != 0)
+                && ((polled_fds[this->poll_touch].revents & POLLIN) != 0
+                    || this->touch_handler->has_pending_events()))
         {
+            has_input = true;
+            trace::span span{trace::stages::touch};
             handle_status(this->touch_handler->process_events(inhibit));
         }
+
+        if (has_input)
+        {
+            this->screen_handler->wake();
+        }
+
+        if (this->has_pending_input())
+        {
+            // Come back immediately for the remaining reports
+            handle_status({/* quit = */ false, /* timeout = */ 0});
+        }
+
+        if (this->metrics_handler.has_value()
+        // NOLINTNEXTLINE(hicpp-signed-bitwise): Use of C library
+                && (polled_fds[this->poll_metrics].revents & POLLIN) != 0)
+        {
+            handle_status(this->metrics_handler->process_events());
+        }
+
+        auto iteration_time = chrono::duration_cast<chrono::microseconds>(
+            chrono::steady_clock::now() - iteration_start);
+
+        loop_iterations.add();
+        loop_busy_time.add(iteration_time.count());
+        loop_last_time.set(
+            chrono::duration<double>(iteration_time).count());
     }
 
     return true;
 }
 
+auto client::has_pending_input() const -> bool
+{
+    return (this->pen_handler.has_value()
+            && this->pen_handler->has_pending_events())
+        || (this->buttons_handler.has_value()
+            && this->buttons_handler->has_pending_events())
+        || (this->touch_handler.has_value()
+            && this->touch_handler->has_pending_events());
+}
+
 void client::send_button_press(
     int x, int y,
     MouseButton button
 )
 {
-    auto button_flag = static_cast<std::uint8_t>(button);
-    constexpr auto bits = 8 * sizeof(button_flag);
+    if (this->vnc_client == nullptr)
+    {
+        // Events cannot be delivered while reconnecting
+        return;
+    }
 
-    log::print("Button press")
-        << x << 'x' << y << " (button mask: "
-        << std::setfill('0') << std::setw(bits)
-        << std::bitset<bits>(button_flag) << ")\n";
+    pointer_events_sent.add();
 
+    auto button_flag = static_cast<std::uint8_t>(button);
+    trace::instant(trace::stages::pointer, x, y, 0, 0, button_flag);
     SendPointerEvent(this->vnc_client, x, y, button_flag);
+    this->screen_handler->move_cursor(x, y);
+}
+
+auto client::connect() -> bool
+{
+    this->set_server(this->vnc_client);
+
+    if (rfbInitClient(this->vnc_client, nullptr, nullptr) == 0)
+    {
+        // The client is released by the library on failure
+        this->vnc_client = nullptr;
+        return false;
+    }
+
+    return true;
+}
+
+void client::set_server(rfbClient* vnc_client) const
+{
+    // ↓ Use of C library
+    // NOLINTNEXTLINE(cppcoreguidelines-owning-memory,cppcoreguidelines-no-malloc)
+    free(vnc_client->serverHost);
+    vnc_client->serverHost = strdup(this->server_ip.c_str());
+    vnc_client->serverPort = this->server_port;
+}
+
+void client::disconnect(const char* reason)
+{
+    std::cerr << reason << '\n';
+    this->screen_handler->detach();
+    rfbClientCleanup(this->vnc_client);
+    this->vnc_client = nullptr;
+    this->polled_fds[this->poll_vnc].fd = -1;
+    this->reconnect_delay = reconnect_initial_delay;
+    this->next_reconnect = chrono::steady_clock::now() + this->reconnect_delay;
+}
+
+auto client::try_reconnect() -> std::optional<event_loop_status>
+{
+    if (!this->pending_connection.valid())
+    {
+        auto now = chrono::steady_clock::now();
+
+        if (now < this->next_reconnect)
+        {
+            return event_loop_status{
+                /* quit = */ false,
+                /* timeout = */ chrono::ceil<chrono::milliseconds>(
+                    this->next_reconnect - now).count()
+            };
+        }
+
+        // Keep the screen contents and only repaint what changed meanwhile
+        rfbClient* next = rfbGetClient(0, 0, 0);
+        this->screen_handler->reattach(next);
+        this->set_server(next);
+        next->connectTimeout = reconnect_connect_timeout;
+
+        this->pending_connection = std::async(
+            std::launch::async,
+            [next]() -> rfbClient*
+            {
+                // The client is released by the library on failure
+                return rfbInitClient(next, nullptr, nullptr) != 0
+                    ? next
+                    : nullptr;
+            }
+        );
+    }
+
+    if (this->pending_connection.wait_for(chrono::seconds{0})
+            != std::future_status::ready)
+    {
+        return event_loop_status{
+            /* quit = */ false,
+            /* timeout = */ reconnect_check_interval.count()
+        };
+    }
+
+    this->vnc_client = this->pending_connection.get();
+
+    if (this->vnc_client == nullptr)
+    {
+        this->screen_handler->detach();
+
+        if (!this->reconnect)
+        {
+            // Only reconnecting to change the pixel format
+            std::cerr << "Cannot connect to the server again\n";
+            return std::nullopt;
+        }
+
+        reconnects_failed.add();
+        this->reconnect_delay = std::min(
+            this->reconnect_delay * 2,
+            reconnect_max_delay
+        );
+        this->next_reconnect = chrono::steady_clock::now()
+            + this->reconnect_delay;
+        return event_loop_status{
+            /* quit = */ false,
+            /* timeout = */ this->reconnect_delay.count()
+        };
+    }
+
+    std::cerr << "Connection established\n";
+    reconnects_succeeded.add();
+    this->polled_fds[this->poll_vnc].fd = this->vnc_client->sock;
+    return event_loop_status{/* quit = */ false, /* timeout = */ -1};
 }
 
 } // namespace app
@@ -3,11 +3,15 @@
 
 #include "event_loop.hpp"
 #include "buttons.hpp"
+#include "metrics.hpp"
 #include "pen.hpp"
 #include "screen.hpp"
 #include "touch.hpp"
+#include <chrono>
+#include <future>
 #include <iosfwd>
 #include <optional>
+#include <string>
 #include <poll.h> // IWYU pragma: keep
 #include <rfb/rfbclient.h>
 #include <vector>
@@ -15,11 +19,74 @@
 namespace rmioc
 {
     class device;
+    class input_replay;
 }
 
 namespace app
 {
 
+/** Optional features of the VNC client. */
+struct client_options
+{
+    /** Path of the Unix socket on which to serve metrics, if not null. */
+    const char* metrics_socket = nullptr;
+
+    /** Whether to show the debugging overlay (see `app::hud`). */
+    bool debug_hud = false;
+
+    /** Whether to draw the mouse cursor locally (see `app::cursor`). */
+    bool local_cursor = false;
+
+    /**
+     * Maximum distance between the pen positions dropped by stroke
+     * simplification and the sent strokes (in pixels), or 0 to send all
+     * positions.
+     */
+    int pen_tolerance = 0;
+
+    /**
+     * Time ahead to predict the pen position for the cursor drawn on the
+     * client side, or 0 to disable predictions.
+     */
+    std::chrono::milliseconds pen_prediction{0};
+
+    /** Whether to send predicted pen positions to the server. */
+    bool pen_prediction_events = false;
+
+    /**
+     * Time without input or screen changes after which updates are
+     * requested less often, or 0 to always request them right away.
+     */
+    std::chrono::milliseconds idle_timeout{0};
+
+    /**
+     * Longest time to receive a whole screen, used for choosing the
+     * encodings depending on the link speed, or 0 to always use raw pixels.
+     */
+    std::chrono::milliseconds latency_target{0};
+
+    /** If set, called for each region that must be repainted. */
+    damage_callback on_damage;
+
+    /**
+     * If not null, recording to feed to the input devices. The event loop
+     * exits once all recorded events have been processed.
+     */
+    rmioc::input_replay* input_replay = nullptr;
+
+    /**
+     * Whether to reconnect to the server when the connection is lost,
+     * instead of exiting the event loop.
+     */
+    bool reconnect = false;
+
+    /**
+     * Pixel format to request from the server. Other formats than the
+     * screen one are converted as they are received.
+     */
+    server_formats server_format = server_formats::screen;
+};
+
 /**
  * VNC client for the reMarkable tablet.
  */
@@ -32,8 +99,12 @@ public:
      * @param ip IP address of the VNC server to connect to.
      * @param port Port of the VNC server to connect to.
      * @param device Handle to opened devices.
+     * @param options Optional features to enable.
      */
-    client(const char* ip, int port, rmioc::device& device);
+    client(
+        const char* ip, int port, rmioc::device& device,
+        const client_options& options = {}
+    );
 
     /** Disconnect the VNC client. */
     ~client();
@@ -42,11 +113,33 @@ public:
      * Start the client event loop.
      *
      * @return True if the loop was exited because of a user action, false if
-     * it was because the server closed the connection.
+     * it was because the server closed the connection and reconnecting is
+     * disabled.
      */
     bool event_loop();
 
 private:
+    /** Address of the VNC server. */
+    std::string server_ip;
+
+    /** Port of the VNC server. */
+    int server_port;
+
+    /** Whether to reconnect when the connection is lost. */
+    bool reconnect;
+
+    /** Time to wait before the next reconnection attempt. */
+    std::chrono::milliseconds reconnect_delay;
+
+    /** Time of the next reconnection attempt. */
+    std::chrono::steady_clock::time_point next_reconnect;
+
+    /**
+     * Reconnection attempt running in the background, if any. Yields the
+     * new connection, or null if the attempt failed.
+     */
+    std::future<rfbClient*> pending_connection;
+
     /** List of file descriptors to watch in the event loop. */
     std::vector<pollfd> polled_fds;
 
@@ -62,7 +155,13 @@ private:
     /** Index of the VNC socket file descriptor in the poll structure. */
     std::size_t poll_vnc = -1;
 
-    /** VNC connection. */
+    /** Index of the metrics socket file descriptor in the poll structure. */
+    std::size_t poll_metrics = -1;
+
+    /** Index of the repaint completions descriptor in the poll structure. */
+    std::size_t poll_completions = -1;
+
+    /** VNC connection, or null while disconnected. */
     rfbClient* vnc_client;
 
     /** Event handler for the screen device. */
@@ -77,6 +176,15 @@ private:
     /** Event handler for the touch device. */
     std::optional<touch> touch_handler;
 
+    /** Server for the metrics socket, if enabled. */
+    std::optional<metrics> metrics_handler;
+
+    /** Recording fed to the input devices, if any. */
+    rmioc::input_replay* input_replay = nullptr;
+
+    /** Whether input devices hold reports that were read but not processed. */
+    bool has_pending_input() const;
+
     /**
      * Send a pointer event to the VNC server.
      *
@@ -85,6 +193,40 @@ private:
      * @param button Button to press.
      */
     void send_button_press(int x, int y, MouseButton button);
+
+    /**
+     * Connect the current VNC client to the server.
+     *
+     * @return True if the connection was established. Otherwise, the client
+     * has been released and is set to null.
+     */
+    bool connect();
+
+    /**
+     * Point a VNC client to the server.
+     *
+     * @param vnc_client Client to set up.
+     */
+    void set_server(rfbClient* vnc_client) const;
+
+    /**
+     * Release the current connection and schedule a reconnection.
+     *
+     * @param reason Message explaining why the connection is released.
+     */
+    void disconnect(const char* reason);
+
+    /**
+     * Start reconnecting to the server if the next attempt is due, or
+     * finish an attempt running in the background.
+     *
+     * Connections are established in the background so that input events
+     * are still processed while the server cannot be reached.
+     *
+     * @return Event loop status with the time until the next check, or
+     * nothing if the attempt failed and reconnecting is disabled.
+     */
+    std::optional<event_loop_status> try_reconnect();
 }; // class client
 
 } // namespace app
@@ -0,0 +1,47 @@
+#include "clock.hpp"
+#include <algorithm>
+
+namespace app
+{
+
+namespace
+{
+
+/** Clock following the monotonic system time. */
+class system_clock : public clock
+{
+public:
+    auto now() const -> time_point override
+    {
+        return std::chrono::steady_clock::now();
+    }
+}; // class system_clock
+
+} // anonymous namespace
+
+auto clock::system() -> const clock&
+{
+    static const system_clock instance{};
+    return instance;
+}
+
+virtual_clock::virtual_clock(time_point start)
+: current(start)
+{}
+
+auto virtual_clock::now() const -> time_point
+{
+    return this->current;
+}
+
+void virtual_clock::advance_to(time_point time)
+{
+    this->current = std::max(this->current, time);
+}
+
+void virtual_clock::advance(duration delta)
+{
+    this->advance_to(this->current + delta);
+}
+
+} // namespace app
@@ -0,0 +1,64 @@
+#ifndef APP_CLOCK_HPP
+#define APP_CLOCK_HPP
+
+#include <chrono>
+
+namespace app
+{
+
+/**
+ * Source of the current time for the timing decisions of the client.
+ *
+ * Event handlers read the time through this interface rather than from the
+ * system clock, so that their scheduling can be driven by a simulated time
+ * (see `virtual_clock`) and replayed deterministically.
+ */
+class clock
+{
+public:
+    using time_point = std::chrono::steady_clock::time_point;
+    using duration = std::chrono::steady_clock::duration;
+
+    virtual ~clock() = default;
+
+    /** Get the current time. */
+    virtual time_point now() const = 0;
+
+    /** Get the clock following the monotonic system time. */
+    static const clock& system();
+}; // class clock
+
+/**
+ * Clock whose time only changes when it is explicitly advanced.
+ */
+class virtual_clock : public clock
+{
+public:
+    /**
+     * Create a virtual clock.
+     *
+     * @param start Initial time of the clock.
+     */
+    explicit virtual_clock(time_point start = {});
+
+    time_point now() const override;
+
+    /**
+     * Move the clock forward.
+     *
+     * @param time New time of the clock. Times earlier than the current one
+     * are ignored, so that the clock never goes backwards.
+     */
+    void advance_to(time_point time);
+
+    /** Move the clock forward by a given duration. */
+    void advance(duration delta);
+
+private:
+    /** Current time. */
+    time_point current;
+}; // class virtual_clock
+
+} // namespace app
+
+#endif // APP_CLOCK_HPP
@@ -0,0 +1,216 @@
+#include "cursor.hpp"
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+namespace app
+{
+
+cursor::cursor(rmioc::screen& device)
+: device(device)
+, pixel_size(device.get_bits_per_pixel() / CHAR_BIT)
+{}
+
+void cursor::set_shape(
+    int hot_x, int hot_y, int w, int h,
+    const std::uint8_t* pixels,
+    const std::uint8_t* mask
+)
+{
+    auto count = static_cast<std::size_t>(std::max(w, 0))
+        * static_cast<std::size_t>(std::max(h, 0));
+
+    this->hot_x = hot_x;
+    this->hot_y = hot_y;
+    this->width = w;
+    this->height = h;
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    this->pixels.assign(pixels, pixels + count * this->pixel_size);
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    this->mask.assign(mask, mask + count);
+    this->shape_changed = true;
+}
+
+void cursor::move(int x, int y)
+{
+    this->x = x;
+    this->y = y;
+    this->has_position = true;
+}
+
+void cursor::hide()
+{
+    if (!this->visible)
+    {
+        return;
+    }
+
+    const auto& area = this->drawn;
+    std::size_t row_size = area.w * this->pixel_size;
+
+    for (int row = 0; row < area.h; ++row)
+    {
+        std::memcpy(
+            this->locate(area.x, area.y + row),
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+            this->below.data() + row * row_size,
+            row_size
+        );
+    }
+
+    this->visible = false;
+}
+
+void cursor::show()
+{
+    if (this->visible)
+    {
+        return;
+    }
+
+    region area;
+
+    if (this->has_position && this->width > 0 && this->height > 0)
+    {
+        int left = std::max(this->x - this->hot_x, 0);
+        int top = std::max(this->y - this->hot_y, 0);
+        int right = std::min(
+            this->x - this->hot_x + this->width,
+            this->device.get_xres()
+        );
+        int bottom = std::min(
+            this->y - this->hot_y + this->height,
+            this->device.get_yres()
+        );
+
+        if (left < right && top < bottom)
+        {
+            area = {left, top, right - left, bottom - top};
+        }
+    }
+
+    std::size_t row_size = area.w * this->pixel_size;
+    this->below.resize(row_size * area.h);
+
+    for (int row = 0; row < area.h; ++row)
+    {
+        std::uint8_t* screen_row = this->locate(area.x, area.y + row);
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        std::memcpy(this->below.data() + row * row_size, screen_row, row_size);
+
+        int shape_row = area.y + row - (this->y - this->hot_y);
+        int shape_col = area.x - (this->x - this->hot_x);
+        auto shape_offset = static_cast<std::size_t>(shape_row)
+            * this->width + shape_col;
+
+        for (int col = 0; col < area.w; ++col)
+        {
+            if (this->mask[shape_offset + col] != 0)
+            {
+                std::memcpy(
+                    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+                    screen_row + col * this->pixel_size,
+                    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+                    this->pixels.data()
+                        + (shape_offset + col) * this->pixel_size,
+                    this->pixel_size
+                );
+            }
+        }
+    }
+
+    const auto& last = this->drawn;
+
+    if (this->shape_changed
+            || area.x != last.x || area.y != last.y
+            || area.w != last.w || area.h != last.h)
+    {
+        this->changed = true;
+    }
+
+    this->drawn = area;
+    this->shape_changed = false;
+    this->visible = true;
+}
+
+void cursor::on_repaint(const region& area)
+{
+    const auto& current = this->drawn;
+
+    if (!this->visible || current.w <= 0 || current.h <= 0
+            || area.x >= current.x + current.w
+            || current.x >= area.x + area.w
+            || area.y >= current.y + current.h
+            || current.y >= area.y + area.h)
+    {
+        return;
+    }
+
+    for (const auto& known : this->stale)
+    {
+        if (known.x == current.x && known.y == current.y
+                && known.w == current.w && known.h == current.h)
+        {
+            return;
+        }
+    }
+
+    this->stale.push_back(current);
+}
+
+auto cursor::has_damage() const -> bool
+{
+    return this->changed;
+}
+
+auto cursor::take_damage() -> std::vector<region>
+{
+    std::vector<region> result;
+    result.swap(this->stale);
+
+    if (this->drawn.w > 0 && this->drawn.h > 0)
+    {
+        result.push_back(this->drawn);
+    }
+
+    // Merge overlapping regions so that no pixel is repainted twice
+    for (std::size_t i = 0; i < result.size(); ++i)
+    {
+        for (std::size_t j = i + 1; j < result.size(); ++j)
+        {
+            auto& first = result[i];
+            const auto& second = result[j];
+
+            if (first.x < second.x + second.w
+                    && second.x < first.x + first.w
+                    && first.y < second.y + second.h
+                    && second.y < first.y + first.h)
+            {
+                int left = std::min(first.x, second.x);
+                int top = std::min(first.y, second.y);
+                int right = std::max(first.x + first.w, second.x + second.w);
+                int bottom = std::max(
+                    first.y + first.h,
+                    second.y + second.h
+                );
+                first = {left, top, right - left, bottom - top};
+                result.erase(result.begin()
+                    + static_cast<std::ptrdiff_t>(j));
+                j = i;
+            }
+        }
+    }
+
+    this->changed = false;
+    return result;
+}
+
+auto cursor::locate(int x, int y) -> std::uint8_t*
+{
+    std::size_t stride = this->device.get_xres_memory() * this->pixel_size;
+
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    return this->device.get_data() + y * stride + x * this->pixel_size;
+}
+
+} // namespace app
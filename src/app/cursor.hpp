@@ -0,0 +1,142 @@
+#ifndef APP_CURSOR_HPP
+#define APP_CURSOR_HPP
+
+#include "../rmioc/screen.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace app
+{
+
+/**
+ * Mouse cursor drawn by the client.
+ *
+ * When the server sends the cursor shape and position instead of drawing
+ * the cursor in its framebuffer, moving the mouse does not cause any
+ * framebuffer update. The cursor is instead drawn in the screen memory by
+ * the client, keeping a copy of the pixels below it so that it can be
+ * hidden while the server framebuffer is being written to.
+ */
+class cursor
+{
+public:
+    /** Rectangular region of the screen. */
+    struct region
+    {
+        int x = 0;
+        int y = 0;
+        int w = 0;
+        int h = 0;
+    };
+
+    /**
+     * Create a cursor, initially without any shape or position.
+     *
+     * @param device Screen to draw on.
+     */
+    explicit cursor(rmioc::screen& device);
+
+    /**
+     * Change the shape of the cursor. Must be hidden.
+     *
+     * @param hot_x Column of the pointed pixel in the shape.
+     * @param hot_y Row of the pointed pixel in the shape.
+     * @param w Width of the shape (in pixels).
+     * @param h Height of the shape (in pixels).
+     * @param pixels Pixels of the shape in the screen format.
+     * @param mask One byte for each pixel, non-zero for opaque pixels.
+     */
+    void set_shape(
+        int hot_x, int hot_y, int w, int h,
+        const std::uint8_t* pixels,
+        const std::uint8_t* mask
+    );
+
+    /**
+     * Change the position of the cursor. Must be hidden.
+     *
+     * @param x Column of the pointed pixel on the screen.
+     * @param y Row of the pointed pixel on the screen.
+     */
+    void move(int x, int y);
+
+    /** Restore the screen pixels below the cursor. */
+    void hide();
+
+    /** Draw the cursor on the screen, saving the pixels below it. */
+    void show();
+
+    /**
+     * Register a region of the screen that is about to be repainted.
+     *
+     * @param area Repainted region.
+     */
+    void on_repaint(const region& area);
+
+    /** Check whether the cursor changed since it was last repainted. */
+    bool has_damage() const;
+
+    /**
+     * Get the regions that must be repainted for the screen to show the
+     * cursor where it is currently drawn, and forget them.
+     *
+     * Only the regions where a previous cursor could have been repainted
+     * are included, so that positions the cursor went through between two
+     * repaints are not repainted.
+     */
+    std::vector<region> take_damage();
+
+private:
+    /** Screen to draw on. */
+    rmioc::screen& device;
+
+    /** Size of a screen pixel (in bytes). */
+    std::size_t pixel_size;
+
+    /** Column and row of the pointed pixel in the shape. */
+    int hot_x = 0;
+    int hot_y = 0;
+
+    /** Size of the shape (in pixels). */
+    int width = 0;
+    int height = 0;
+
+    /** Pixels of the shape in the screen format, in row-major order. */
+    std::vector<std::uint8_t> pixels;
+
+    /** Opacity of each pixel of the shape. */
+    std::vector<std::uint8_t> mask;
+
+    /** Column and row of the pointed pixel on the screen. */
+    int x = 0;
+    int y = 0;
+
+    /** Whether the position of the cursor is known. */
+    bool has_position = false;
+
+    /** Region of the screen covered by the cursor when last drawn. */
+    region drawn;
+
+    /** Screen pixels covered by the cursor, in row-major order. */
+    std::vector<std::uint8_t> below;
+
+    /** Whether the cursor is currently drawn on the screen. */
+    bool visible = false;
+
+    /** Whether the shape changed since the cursor was last drawn. */
+    bool shape_changed = false;
+
+    /** Whether the cursor was drawn differently since it was repainted. */
+    bool changed = false;
+
+    /** Regions where the screen may show a previous cursor. */
+    std::vector<region> stale;
+
+    /** Find a pixel of the screen memory. */
+    std::uint8_t* locate(int x, int y);
+}; // class cursor
+
+} // namespace app
+
+#endif // APP_CURSOR_HPP
@@ -0,0 +1,166 @@
+#include "encoding_policy.hpp"
+#include "../stats.hpp"
+
+namespace chrono = std::chrono;
+
+namespace app
+{
+
+namespace
+{
+
+/**
+ * Smallest frames used for measurements, relative to the screen size.
+ *
+ * The time spent on smaller frames is dominated by the round trip and
+ * says little about the throughput of the link.
+ */
+constexpr std::size_t min_frame_fraction = 16;
+
+/** Weight of each new frame in the average time per pixel. */
+constexpr double average_weight = 0.25;
+
+/** Consecutive frames above the target before packing more. */
+constexpr int slow_frames_to_switch = 3;
+
+/** Consecutive frames below the target before packing less. */
+constexpr int fast_frames_to_switch = 10;
+
+/**
+ * Fraction of the target below which frames count as fast.
+ *
+ * Packing less can make frames several times slower, so that a lower
+ * threshold avoids switching back right away.
+ */
+constexpr double fast_fraction = 1. / 3;
+
+auto& raw_mode = stats::get_gauge(
+    "vnsee_encoding_mode",
+    "Set of encodings currently requested from the server",
+    "mode=\"raw\""
+);
+
+auto& tight_mode = stats::get_gauge(
+    "vnsee_encoding_mode",
+    "Set of encodings currently requested from the server",
+    "mode=\"tight\""
+);
+
+auto& mode_switches = stats::get_counter(
+    "vnsee_encoding_switches_total",
+    "Changes of the encodings requested from the server"
+);
+
+auto& screen_delivery = stats::get_gauge(
+    "vnsee_screen_delivery_seconds",
+    "Estimated time to receive and decode a whole screen"
+);
+
+/** Show the current mode in the statistics. */
+void report_mode(encoding_modes mode)
+{
+    raw_mode.set(mode == encoding_modes::raw ? 1 : 0);
+    tight_mode.set(mode == encoding_modes::tight ? 1 : 0);
+}
+
+} // anonymous namespace
+
+auto get_mode_name(encoding_modes mode) -> const char*
+{
+    switch (mode)
+    {
+    case encoding_modes::raw: return "raw";
+    case encoding_modes::tight: return "tight";
+    }
+
+    return "";
+}
+
+encoding_policy::encoding_policy(
+    chrono::milliseconds target,
+    std::size_t screen_pixels
+)
+: target(target)
+, screen_pixels(screen_pixels)
+{
+    report_mode(this->mode);
+}
+
+auto encoding_policy::get_mode() const -> encoding_modes
+{
+    return this->mode;
+}
+
+auto encoding_policy::on_frame(
+    std::size_t pixels,
+    chrono::nanoseconds duration
+) -> bool
+{
+    if (pixels == 0 || pixels < this->screen_pixels / min_frame_fraction)
+    {
+        return false;
+    }
+
+    double frame_seconds_per_pixel = chrono::duration<double>(duration)
+        .count() / static_cast<double>(pixels);
+
+    if (this->has_average)
+    {
+        this->seconds_per_pixel += average_weight
+            * (frame_seconds_per_pixel - this->seconds_per_pixel);
+    }
+    else
+    {
+        this->seconds_per_pixel = frame_seconds_per_pixel;
+        this->has_average = true;
+    }
+
+    double estimate = this->seconds_per_pixel
+        * static_cast<double>(this->screen_pixels);
+    double target_seconds = chrono::duration<double>(this->target).count();
+    screen_delivery.set(estimate);
+
+    if (estimate > target_seconds)
+    {
+        this->fast_frames = 0;
+
+        if (++this->slow_frames >= slow_frames_to_switch
+                && this->mode != encoding_modes::tight)
+        {
+            this->switch_to(static_cast<encoding_modes>(
+                static_cast<int>(this->mode) + 1));
+            return true;
+        }
+    }
+    else if (estimate < target_seconds * fast_fraction)
+    {
+        this->slow_frames = 0;
+
+        if (++this->fast_frames >= fast_frames_to_switch
+                && this->mode != encoding_modes::raw)
+        {
+            this->switch_to(static_cast<encoding_modes>(
+                static_cast<int>(this->mode) - 1));
+            return true;
+        }
+    }
+    else
+    {
+        this->slow_frames = 0;
+        this->fast_frames = 0;
+    }
+
+    return false;
+}
+
+void encoding_policy::switch_to(encoding_modes next)
+{
+    this->mode = next;
+    this->has_average = false;
+    this->slow_frames = 0;
+    this->fast_frames = 0;
+    mode_switches.add();
+    report_mode(next);
+}
+
+} // namespace app
@@ -0,0 +1,93 @@
+#ifndef APP_ENCODING_POLICY_HPP
+#define APP_ENCODING_POLICY_HPP
+
+#include <chrono>
+#include <cstddef>
+
+namespace app
+{
+
+/** Sets of encodings requested from the server, from least to most packed. */
+enum class encoding_modes
+{
+    /** Uncompressed pixels, cheapest to decode, for fast links. */
+    raw = 0,
+
+    /**
+     * Tight encoding with the highest compression level and lossy JPEG
+     * tiles, for slow links. Servers only use JPEG with 32-bit pixels.
+     *
+     * ZRLE is not used: libvncclient decodes it straight into its own
+     * framebuffer, which this client does not allocate.
+     */
+    tight = 1,
+};
+
+/** Get the name of an encoding mode. */
+const char* get_mode_name(encoding_modes mode);
+
+/**
+ * Choice of the encodings to request from the server so that frames are
+ * delivered within a target latency.
+ *
+ * The time needed to receive and decode each frame is measured and
+ * scaled to a whole screen. When that estimate stays above the target,
+ * the next more packed mode is chosen. When it stays well below the
+ * target, the next less packed mode is chosen. Both switches require
+ * several consecutive frames to avoid switching back and forth.
+ */
+class encoding_policy
+{
+public:
+    /**
+     * Create a policy, starting with raw pixels.
+     *
+     * @param target Longest time to receive a whole screen.
+     * @param screen_pixels Number of pixels on the screen.
+     */
+    encoding_policy(
+        std::chrono::milliseconds target,
+        std::size_t screen_pixels
+    );
+
+    /** Get the current mode. */
+    encoding_modes get_mode() const;
+
+    /**
+     * Register a received frame.
+     *
+     * @param pixels Number of pixels in the frame.
+     * @param duration Time spent receiving and decoding the frame.
+     * @return True if the mode changed.
+     */
+    bool on_frame(std::size_t pixels, std::chrono::nanoseconds duration);
+
+private:
+    /** Longest time to receive a whole screen. */
+    std::chrono::milliseconds target;
+
+    /** Number of pixels on the screen. */
+    std::size_t screen_pixels;
+
+    /** Current mode. */
+    encoding_modes mode = encoding_modes::raw;
+
+    /** Average time per pixel in the current mode (in seconds). */
+    double seconds_per_pixel = 0;
+
+    /** Whether the average holds at least one frame. */
+    bool has_average = false;
+
+    /** Number of consecutive frames above the target. */
+    int slow_frames = 0;
+
+    /** Number of consecutive frames well below the target. */
+    int fast_frames = 0;
+
+    /** Switch to another mode and forget previous measurements. */
+    void switch_to(encoding_modes next);
+}; // class encoding_policy
+
+} // namespace app
+
+#endif // APP_ENCODING_POLICY_HPP
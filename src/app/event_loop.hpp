@@ -44,6 +44,24 @@ enum class MouseButton : std::uint8_t
  */
 using MouseCallback = std::function<void(int, int, MouseButton)>;
 
+/**
+ * Callback used to report regions of the screen that changed.
+ *
+ * @param x Left bound of the region (in pixels).
+ * @param y Top bound of the region (in pixels).
+ * @param w Width of the region (in pixels).
+ * @param h Height of the region (in pixels).
+ */
+using damage_callback = std::function<void(int, int, int, int)>;
+
+/**
+ * Check whether the user asked to quit with SIGINT or SIGTERM.
+ *
+ * Blocking operations interrupted by these signals must check this flag
+ * and give up instead of retrying.
+ */
+bool is_quit_requested();
+
 } // namespace app
 
 #endif // APP_EVENT_LOOP_HPP
@@ -0,0 +1,280 @@
+#include "hud.hpp"
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <climits>
+#include <cstdio>
+#include <string>
+
+namespace chrono = std::chrono;
+
+namespace app
+{
+
+namespace
+{
+
+/** Interval between two refreshes of the statistics panel. */
+constexpr chrono::milliseconds panel_interval{1000};
+
+/** Thickness of the outlines drawn around repainted regions. */
+constexpr int outline_width = 2;
+
+/** Width and height of a font glyph (in font pixels). */
+constexpr int glyph_width = 5;
+constexpr int glyph_height = 7;
+
+/** Size of a font pixel (in screen pixels). */
+constexpr int glyph_scale = 2;
+
+/** Space between glyphs and between lines (in screen pixels). */
+constexpr int glyph_spacing = 2;
+constexpr int line_spacing = 4;
+
+/** Space between the panel border and its text (in screen pixels). */
+constexpr int panel_padding = 8;
+
+/** Number of text lines and maximum line length in the panel. */
+constexpr int panel_lines = 4;
+constexpr int panel_columns = 12;
+
+using glyph = std::array<std::uint8_t, glyph_height>;
+
+/**
+ * Get the bitmap of a character in a 5x7 font.
+ *
+ * Only the characters needed by the panel are available, lowercase letters
+ * being drawn as uppercase. Each row is stored in the five lowest bits of a
+ * byte, from left to right.
+ */
+auto get_glyph(char c) -> glyph
+{
+    switch (std::toupper(static_cast<unsigned char>(c)))
+    {
+    case '0': return {0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E};
+    case '1': return {0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E};
+    case '2': return {0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F};
+    case '3': return {0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E};
+    case '4': return {0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02};
+    case '5': return {0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E};
+    case '6': return {0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E};
+    case '7': return {0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08};
+    case '8': return {0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E};
+    case '9': return {0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C};
+    case 'A': return {0x0E, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11};
+    case 'B': return {0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E};
+    case 'C': return {0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E};
+    case 'D': return {0x1C, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1C};
+    case 'F': return {0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10};
+    case 'G': return {0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F};
+    case 'I': return {0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E};
+    case 'K': return {0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11};
+    case 'L': return {0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F};
+    case 'M': return {0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11};
+    case 'N': return {0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11};
+    case 'P': return {0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10};
+    case 'S': return {0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E};
+    case 'T': return {0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04};
+    case 'U': return {0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E};
+    case 'W': return {0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A};
+    case '/': return {0x01, 0x01, 0x02, 0x04, 0x08, 0x10, 0x10};
+    case '.': return {0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C};
+    default: return {};
+    }
+}
+
+} // anonymous namespace
+
+hud::hud(rmioc::screen& device, const clock& time_source)
+: device(device)
+, time_source(time_source)
+, black(0)
+, white(
+    (device.get_red_format().max() << device.get_red_format().offset)
+    | (device.get_green_format().max() << device.get_green_format().offset)
+    | (device.get_blue_format().max() << device.get_blue_format().offset)
+)
+, window_start(time_source.now())
+{}
+
+void hud::on_received(std::size_t bytes)
+{
+    this->window_bytes += bytes;
+}
+
+void hud::on_damage()
+{
+    if (!this->has_damage)
+    {
+        this->has_damage = true;
+        this->first_damage = this->time_source.now();
+    }
+}
+
+void hud::on_repaint(int x, int y, int w, int h, rmioc::waveform_modes mode)
+{
+    if (this->has_damage)
+    {
+        this->last_latency = this->time_source.now() - this->first_damage;
+        this->has_damage = false;
+    }
+
+    ++this->window_repaints;
+    this->last_waveform = mode;
+
+    int thickness = std::min({outline_width, w, h});
+    this->fill(x, y, w, thickness, this->black);
+    this->fill(x, y + h - thickness, w, thickness, this->black);
+    this->fill(x, y, thickness, h, this->black);
+    this->fill(x + w - thickness, y, thickness, h, this->black);
+}
+
+auto hud::event_loop() -> event_loop_status
+{
+    auto next_refresh = this->window_start + panel_interval;
+    auto now = this->time_source.now();
+
+    if (now < next_refresh)
+    {
+        return {
+            /* quit = */ false,
+            /* timeout = */ chrono::duration_cast<chrono::milliseconds>(
+                next_refresh - now).count() + 1
+        };
+    }
+
+    this->draw_panel();
+    this->window_start = now;
+    this->window_repaints = 0;
+    this->window_bytes = 0;
+
+    return {
+        /* quit = */ false,
+        /* timeout = */ chrono::milliseconds{panel_interval}.count()
+    };
+}
+
+void hud::fill(int x, int y, int w, int h, std::uint32_t color)
+{
+    int left = std::max(x, 0);
+    int top = std::max(y, 0);
+    int right = std::min(x + w, this->device.get_xres());
+    int bottom = std::min(y + h, this->device.get_yres());
+
+    std::size_t pixel_size = this->device.get_bits_per_pixel() / CHAR_BIT;
+    std::size_t stride = this->device.get_xres_memory() * pixel_size;
+    std::uint8_t* data = this->device.get_data();
+
+    for (int row = top; row < bottom; ++row)
+    {
+        for (int col = left; col < right; ++col)
+        {
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+            std::uint8_t* pixel = data + row * stride + col * pixel_size;
+
+            for (std::size_t byte = 0; byte < pixel_size; ++byte)
+            {
+                // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+                pixel[byte] = static_cast<std::uint8_t>(
+                    color >> (byte * CHAR_BIT));
+            }
+        }
+    }
+}
+
+void hud::draw_text(int x, int y, const char* text)
+{
+    for (; *text != '\0'; ++text)
+    {
+        glyph bitmap = get_glyph(*text);
+
+        for (int row = 0; row < glyph_height; ++row)
+        {
+            for (int col = 0; col < glyph_width; ++col)
+            {
+                // NOLINTNEXTLINE(hicpp-signed-bitwise)
+                if ((bitmap.at(row) >> (glyph_width - 1 - col) & 1U) != 0)
+                {
+                    this->fill(
+                        x + col * glyph_scale, y + row * glyph_scale,
+                        glyph_scale, glyph_scale,
+                        this->black
+                    );
+                }
+            }
+        }
+
+        x += glyph_width * glyph_scale + glyph_spacing;
+    }
+}
+
+void hud::draw_panel()
+{
+    constexpr int line_height = glyph_height * glyph_scale + line_spacing;
+    constexpr int panel_width = panel_columns
+        * (glyph_width * glyph_scale + glyph_spacing) + 2 * panel_padding;
+    constexpr int panel_height = panel_lines * line_height
+        + 2 * panel_padding;
+
+    auto elapsed = chrono::duration<double>(
+        this->time_source.now() - this->window_start).count();
+    auto latency = chrono::duration_cast<chrono::milliseconds>(
+        this->last_latency).count();
+
+    constexpr double bytes_per_kilobyte = 1024;
+    std::array<std::array<char, panel_columns + 1>, panel_lines> lines{};
+
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg,hicpp-vararg)
+    std::snprintf(lines[0].data(), lines[0].size(), "FPS %.1f",
+        this->window_repaints / elapsed);
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg,hicpp-vararg)
+    std::snprintf(lines[1].data(), lines[1].size(), "LAT %ld MS",
+        static_cast<long>(latency));
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg,hicpp-vararg)
+    std::snprintf(lines[2].data(), lines[2].size(), "KB/S %.0f",
+        static_cast<double>(this->window_bytes) / bytes_per_kilobyte
+            / elapsed);
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg,hicpp-vararg)
+    std::snprintf(lines[3].data(), lines[3].size(), "WF %s",
+        rmioc::get_waveform_name(this->last_waveform));
+
+    std::string text;
+
+    for (const auto& line : lines)
+    {
+        text += line.data();
+        text += '\n';
+    }
+
+    if (text == this->panel_text)
+    {
+        return;
+    }
+
+    this->panel_text = text;
+    int panel_x = this->device.get_xres() - panel_width;
+    int panel_y = 0;
+
+    this->fill(panel_x, panel_y, panel_width, panel_height, this->black);
+    this->fill(
+        panel_x + outline_width, panel_y + outline_width,
+        panel_width - 2 * outline_width, panel_height - 2 * outline_width,
+        this->white
+    );
+
+    for (int line = 0; line < panel_lines; ++line)
+    {
+        this->draw_text(
+            panel_x + panel_padding,
+            panel_y + panel_padding + line * line_height,
+            lines.at(line).data()
+        );
+    }
+
+    this->device.update(
+        panel_x, panel_y, panel_width, panel_height,
+        rmioc::waveform_modes::du
+    );
+}
+
+} // namespace app
@@ -0,0 +1,110 @@
+#ifndef APP_HUD_HPP
+#define APP_HUD_HPP
+
+#include "clock.hpp"
+#include "event_loop.hpp"
+#include "../rmioc/screen.hpp"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace app
+{
+
+/**
+ * Debugging overlay showing what is being repainted.
+ *
+ * Each repainted region gets its outline drawn in the framebuffer right
+ * before it is submitted, so that it shows up as part of the same update.
+ * Outlines are left in place until the server overwrites them. A small
+ * panel in the top right corner shows the repaint rate, the last repaint
+ * latency, the incoming data rate and the current waveform. It is
+ * refreshed in DU mode at most once per second to disturb the measured
+ * behavior as little as possible.
+ */
+class hud
+{
+public:
+    /**
+     * Create an overlay.
+     *
+     * @param device Screen to draw on.
+     * @param time_source Clock used for measuring rates and latencies.
+     */
+    hud(rmioc::screen& device, const clock& time_source);
+
+    /**
+     * Register pixel data received from the server.
+     *
+     * @param bytes Number of received bytes.
+     */
+    void on_received(std::size_t bytes);
+
+    /** Register a region waiting to be repainted. */
+    void on_damage();
+
+    /**
+     * Register and outline a region that is about to be repainted.
+     *
+     * @param x Left bound of the repainted region (in pixels).
+     * @param y Top bound of the repainted region (in pixels).
+     * @param w Width of the repainted region (in pixels).
+     * @param h Height of the repainted region (in pixels).
+     * @param mode Waveform used for the repaint.
+     */
+    void on_repaint(int x, int y, int w, int h, rmioc::waveform_modes mode);
+
+    /** Refresh the statistics panel when due. */
+    event_loop_status event_loop();
+
+private:
+    /** Screen to draw on. */
+    rmioc::screen& device;
+
+    /** Clock used for measuring rates and latencies. */
+    const clock& time_source;
+
+    /** Packed pixel value for black in the screen format. */
+    std::uint32_t black;
+
+    /** Packed pixel value for white in the screen format. */
+    std::uint32_t white;
+
+    /** Start of the current measurement window. */
+    clock::time_point window_start;
+
+    /** Repaints issued in the current measurement window. */
+    int window_repaints = 0;
+
+    /** Bytes received in the current measurement window. */
+    std::size_t window_bytes = 0;
+
+    /** Time at which the oldest region waiting to be repainted arrived. */
+    clock::time_point first_damage;
+
+    /** Whether a region is waiting to be repainted. */
+    bool has_damage = false;
+
+    /** Time between the arrival of damage and its repaint, last time. */
+    clock::duration last_latency{};
+
+    /** Text currently shown in the panel. */
+    std::string panel_text;
+
+    /** Waveform used in the last repaint. */
+    rmioc::waveform_modes last_waveform = rmioc::waveform_modes::gl16;
+
+    /** Fill a rectangle of the framebuffer with a packed pixel value. */
+    void fill(int x, int y, int w, int h, std::uint32_t color);
+
+    /** Draw a line of text with its top left corner at (x, y). */
+    void draw_text(int x, int y, const char* text);
+
+    /** Draw the statistics panel and refresh it if it changed. */
+    void draw_panel();
+}; // class hud
+
+} // namespace app
+
+#endif // APP_HUD_HPP
@@ -0,0 +1,121 @@
+#include "jpeg_decoder.hpp"
+#include <array>
+#include <csetjmp>
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+#include <jpeglib.h>
+
+namespace app
+{
+
+namespace
+{
+
+/** Error handler returning control to the decoder instead of exiting. */
+struct error_manager
+{
+    jpeg_error_mgr base;
+    std::jmp_buf jump;
+};
+
+[[noreturn]] void on_error(j_common_ptr info)
+{
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    auto* errors = reinterpret_cast<error_manager*>(info->err);
+    std::longjmp(errors->jump, 1);
+}
+
+/** Print the last error reported by libjpeg. */
+void print_error(j_common_ptr info, const char* context)
+{
+    std::array<char, JMSG_LENGTH_MAX> message{};
+    (*info->err->format_message)(info, message.data());
+    std::cerr << context << ": " << message.data() << '\n';
+}
+
+} // anonymous namespace
+
+struct jpeg_decoder::state
+{
+    jpeg_decompress_struct info{};
+    error_manager errors{};
+};
+
+jpeg_decoder::jpeg_decoder()
+: impl(std::make_unique<state>())
+{
+    auto& info = this->impl->info;
+    info.err = jpeg_std_error(&this->impl->errors.base);
+    this->impl->errors.base.error_exit = on_error;
+
+    // NOLINTNEXTLINE(cert-err52-cpp)
+    if (setjmp(this->impl->errors.jump) != 0)
+    {
+        throw std::runtime_error{"Cannot create the JPEG decoder"};
+    }
+
+    jpeg_create_decompress(&info);
+}
+
+jpeg_decoder::~jpeg_decoder()
+{
+    jpeg_destroy_decompress(&this->impl->info);
+}
+
+auto jpeg_decoder::decode(
+    const std::uint8_t* data,
+    std::size_t size,
+    int w, int h,
+    std::vector<std::uint8_t>& luma
+) -> bool
+{
+    auto& info = this->impl->info;
+    luma.resize(static_cast<std::size_t>(w) * h);
+
+    // libjpeg reports errors by jumping back here, no objects with
+    // destructors may live in the frames that it skips
+    // NOLINTNEXTLINE(cert-err52-cpp)
+    if (setjmp(this->impl->errors.jump) != 0)
+    {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        print_error(reinterpret_cast<j_common_ptr>(&info),
+            "Cannot decode JPEG rectangle");
+        jpeg_abort_decompress(&info);
+        return false;
+    }
+
+    // Older libjpeg versions take a non-const buffer but never write to it
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
+    jpeg_mem_src(&info, const_cast<std::uint8_t*>(data), size);
+    jpeg_read_header(&info, TRUE);
+
+    if (info.image_width != static_cast<JDIMENSION>(w)
+            || info.image_height != static_cast<JDIMENSION>(h))
+    {
+        std::cerr << "Cannot decode JPEG rectangle: expected " << w << 'x'
+            << h << " pixels, got " << info.image_width << 'x'
+            << info.image_height << '\n';
+        jpeg_abort_decompress(&info);
+        return false;
+    }
+
+    // Only decode the luma component, and use the fast integer inverse DCT
+    // whose inaccuracy is well below the 16 gray levels of the panels
+    info.out_color_space = JCS_GRAYSCALE;
+    info.dct_method = JDCT_IFAST;
+    jpeg_start_decompress(&info);
+
+    while (info.output_scanline < info.output_height)
+    {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        JSAMPROW row = luma.data()
+            + static_cast<std::size_t>(info.output_scanline) * w;
+        jpeg_read_scanlines(&info, &row, 1);
+    }
+
+    jpeg_finish_decompress(&info);
+    return true;
+}
+
+} // namespace app
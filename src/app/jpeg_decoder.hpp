@@ -0,0 +1,55 @@
+#ifndef APP_JPEG_DECODER_HPP
+#define APP_JPEG_DECODER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace app
+{
+
+/**
+ * Decoder for the JPEG rectangles of the Tight encoding, keeping only
+ * their luma component.
+ *
+ * The supported screens only show shades of gray, so that the chroma
+ * components are skipped after their entropy decoding: their inverse DCT,
+ * upsampling and conversion to RGB are never performed, which roughly
+ * halves the decoding time of the usual 4:2:0 images.
+ */
+class jpeg_decoder
+{
+public:
+    jpeg_decoder();
+    ~jpeg_decoder();
+
+    jpeg_decoder(const jpeg_decoder& other) = delete;
+    jpeg_decoder& operator=(const jpeg_decoder& other) = delete;
+
+    /**
+     * Decode an image.
+     *
+     * @param data Compressed image.
+     * @param size Size of the compressed image (in bytes).
+     * @param w Expected width of the image (in pixels).
+     * @param h Expected height of the image (in pixels).
+     * @param[out] luma Buffer receiving the luma of each pixel, row by row.
+     * @return False if the data is not a valid image of the expected size.
+     */
+    bool decode(
+        const std::uint8_t* data,
+        std::size_t size,
+        int w, int h,
+        std::vector<std::uint8_t>& luma
+    );
+
+private:
+    /** libjpeg decompression state, reused across images. */
+    struct state;
+    std::unique_ptr<state> impl;
+}; // class jpeg_decoder
+
+} // namespace app
+
+#endif // APP_JPEG_DECODER_HPP
@@ -0,0 +1,120 @@
+#include "metrics.hpp"
+#include "../stats.hpp"
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <system_error>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace app
+{
+
+/** Maximum number of connections waiting to be answered. */
+constexpr int metrics_backlog = 8;
+
+metrics::metrics(const char* socket_path)
+: socket_path(socket_path)
+// NOLINTNEXTLINE(hicpp-signed-bitwise): Use of C library
+, socket_fd(socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0))
+{
+    if (this->socket_fd == -1)
+    {
+        throw std::system_error(
+            errno,
+            std::generic_category(),
+            "(app::metrics) Create metrics socket"
+        );
+    }
+
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+
+    if (this->socket_path.size() >= sizeof(address.sun_path))
+    {
+        throw std::system_error(
+            ENAMETOOLONG,
+            std::generic_category(),
+            "(app::metrics) Bind metrics socket"
+        );
+    }
+
+    // NOLINTNEXTLINE(hicpp-no-array-decay): Use of C library
+    std::strncpy(
+        address.sun_path, this->socket_path.c_str(),
+        sizeof(address.sun_path) - 1
+    );
+
+    // Remove stale sockets from previous runs
+    unlink(this->socket_path.c_str());
+
+    if (bind(
+            this->socket_fd,
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast): Use of C library
+            reinterpret_cast<sockaddr*>(&address),
+            sizeof(address)
+        ) == -1)
+    {
+        throw std::system_error(
+            errno,
+            std::generic_category(),
+            "(app::metrics) Bind metrics socket " + this->socket_path
+        );
+    }
+
+    if (listen(this->socket_fd, metrics_backlog) == -1)
+    {
+        throw std::system_error(
+            errno,
+            std::generic_category(),
+            "(app::metrics) Listen on metrics socket"
+        );
+    }
+}
+
+metrics::~metrics()
+{
+    unlink(this->socket_path.c_str());
+}
+
+void metrics::setup_poll(pollfd& in_pollfd) const
+{
+    in_pollfd.fd = this->socket_fd;
+    in_pollfd.events = POLLIN;
+}
+
+auto metrics::process_events() -> event_loop_status
+{
+    int client_fd = -1;
+
+    // NOLINTNEXTLINE(hicpp-signed-bitwise): Use of C library
+    while ((client_fd = accept4(this->socket_fd, nullptr, nullptr,
+                    SOCK_CLOEXEC)) != -1)
+    {
+        rmioc::file_descriptor client{client_fd};
+        std::ostringstream snapshot;
+        stats::write(snapshot);
+
+        // The snapshot is small enough to fit in the socket buffer, so a
+        // single non-blocking send is enough; slow readers get cut short
+        // rather than stalling the event loop
+        std::string data = snapshot.str();
+        // NOLINTNEXTLINE(hicpp-signed-bitwise): Use of C library
+        send(client, data.data(), data.size(), MSG_DONTWAIT | MSG_NOSIGNAL);
+    }
+
+    if (errno != EAGAIN && errno != EWOULDBLOCK && errno != ECONNABORTED)
+    {
+        throw std::system_error(
+            errno,
+            std::generic_category(),
+            "(app::metrics::process_events) Accept metrics connection"
+        );
+    }
+
+    return {/* quit = */ false, /* timeout = */ -1};
+}
+
+} // namespace app
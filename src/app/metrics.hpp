@@ -0,0 +1,60 @@
+#ifndef APP_METRICS_HPP
+#define APP_METRICS_HPP
+
+#include "event_loop.hpp"
+#include "../rmioc/file.hpp"
+#include <string>
+
+struct pollfd;
+
+namespace app
+{
+
+/**
+ * Serve snapshots of the client metrics on a Unix domain socket.
+ *
+ * Each connection to the socket receives a snapshot of all counters and
+ * gauges (see `stats::write`) and is then closed, so that metrics can be
+ * read with tools such as `socat - UNIX-CONNECT:PATH`.
+ */
+class metrics
+{
+public:
+    /**
+     * Start listening on a Unix domain socket.
+     *
+     * @param socket_path Path of the socket to create. Any existing file at
+     * this path is removed.
+     * @throws std::system_error If the socket cannot be created.
+     */
+    metrics(const char* socket_path);
+
+    /** Stop listening and remove the socket file. */
+    ~metrics();
+
+    metrics(const metrics& other) = delete;
+    metrics& operator=(const metrics& other) = delete;
+    metrics(metrics&& other) = delete;
+    metrics& operator=(metrics&& other) = delete;
+
+    /**
+     * Setup a pollfd structure to wait for incoming connections.
+     *
+     * @param in_pollfd Structure to modify.
+     */
+    void setup_poll(pollfd& in_pollfd) const;
+
+    /** Answer all pending connections. */
+    event_loop_status process_events();
+
+private:
+    /** Path of the listening socket. */
+    std::string socket_path;
+
+    /** Listening socket. */
+    rmioc::file_descriptor socket_fd;
+}; // class metrics
+
+} // namespace app
+
+#endif // APP_METRICS_HPP
@@ -1,24 +1,80 @@
 #include "pen.hpp"
 #include "screen.hpp"
 #include "../rmioc/pen.hpp"
+#include "../stats.hpp"
+#include <algorithm>
+#include <chrono>
 #include <functional>
 #include <utility>
 // IWYU pragma: no_include <type_traits>
 
+namespace chrono = std::chrono;
+
 namespace app
 {
 
+namespace
+{
+
+/**
+ * Maximum time during which stroke points are held back before being
+ * sent, when simplifying strokes.
+ *
+ * Longer delays let more points be dropped on long straight lines, at the
+ * cost of a visible lag between the pen and the drawn stroke.
+ */
+constexpr chrono::milliseconds max_hold_delay{20};
+
+auto& stroke_points_sent = stats::get_counter(
+    "vnsee_pen_stroke_points_total",
+    "Pen positions received while touching the screen",
+    "result=\"sent\""
+);
+
+auto& stroke_points_dropped = stats::get_counter(
+    "vnsee_pen_stroke_points_total",
+    "Pen positions received while touching the screen",
+    "result=\"dropped\""
+);
+
+auto& stroke_reduction = stats::get_gauge(
+    "vnsee_pen_stroke_reduction_ratio",
+    "Fraction of the pen positions dropped by stroke simplification"
+);
+
+/** Update the reduction ratio after counting stroke points. */
+void update_reduction()
+{
+    auto dropped = stroke_points_dropped.get();
+    auto total = stroke_points_sent.get() + dropped;
+
+    if (total > 0)
+    {
+        stroke_reduction.set(
+            static_cast<double>(dropped) / static_cast<double>(total));
+    }
+}
+
+} // anonymous namespace
+
 pen::pen(
     rmioc::pen& device,
     app::screen& screen,
-    MouseCallback send_button_press
+    MouseCallback send_button_press,
+    const clock& time_source
 )
 : device(device)
 , screen(screen)
 , send_button_press(std::move(send_button_press))
+, time_source(time_source)
 , state(MouseButton::None)
 {}
 
+auto pen::has_pending_events() const -> bool
+{
+    return this->device.has_pending_events();
+}
+
 auto pen::process_events() -> event_loop_status
 {
     if (this->device.process_events())
@@ -43,7 +99,53 @@ auto pen::process_events() -> event_loop_status
                 ? MouseButton::Left
                 : MouseButton::None;
 
-            this->send_button_press(screen_x, screen_y, new_state);
+            if (this->predictor.has_value())
+            {
+                if (this->state != new_state)
+                {
+                    this->predictor->reset();
+                }
+
+                // Reports read in a batch are processed microseconds apart,
+                // use the time at which the device produced them instead
+                auto sample_time = this->device.get_report_time();
+
+                if (sample_time == clock::time_point{})
+                {
+                    sample_time = this->time_source.now();
+                }
+
+                auto predicted = this->predictor->add_sample(
+                    sample_time, screen_x, screen_y);
+
+                if (this->send_predicted
+                        && this->state == MouseButton::Left
+                        && new_state == MouseButton::Left)
+                {
+                    screen_x = std::clamp(predicted.x, 0, screen_xres - 1);
+                    screen_y = std::clamp(predicted.y, 0, screen_yres - 1);
+                }
+            }
+
+            if (this->tolerance > 0
+                    && this->state == MouseButton::Left
+                    && new_state == MouseButton::Left)
+            {
+                this->add_stroke_point({screen_x, screen_y});
+            }
+            else
+            {
+                // Strokes always start and end at their exact positions
+                this->flush_stroke();
+                this->send_button_press(screen_x, screen_y, new_state);
+                this->anchor = {screen_x, screen_y};
+
+                if (new_state == MouseButton::Left)
+                {
+                    stroke_points_sent.add();
+                    update_reduction();
+                }
+            }
 
             // Switch to the fast update mode for as long as the pen
             // touches the screen
@@ -62,10 +164,31 @@ auto pen::process_events() -> event_loop_status
             }
 
             this->state = new_state;
+            this->show_prediction();
         }
     }
 
-    return {/* quit = */ false, /* timeout = */ -1};
+    return this->event_loop();
+}
+
+auto pen::event_loop() -> event_loop_status
+{
+    if (this->held.empty())
+    {
+        return {/* quit = */ false, /* timeout = */ -1};
+    }
+
+    auto remaining = chrono::ceil<chrono::milliseconds>(
+        this->held_since + max_hold_delay - this->time_source.now());
+
+    if (remaining.count() <= 0)
+    {
+        this->flush_stroke();
+        this->show_prediction();
+        return {/* quit = */ false, /* timeout = */ -1};
+    }
+
+    return {/* quit = */ false, /* timeout = */ remaining.count()};
 }
 
 auto pen::is_inhibiting() const -> bool
@@ -74,4 +197,94 @@ auto pen::is_inhibiting() const -> bool
     return this->device.get_state().tool_set.has_pen();
 }
 
+void pen::set_tolerance(int tolerance)
+{
+    this->flush_stroke();
+    this->tolerance = std::max(tolerance, 0);
+}
+
+void pen::set_prediction(
+    chrono::milliseconds horizon,
+    bool send_predicted
+)
+{
+    if (horizon.count() > 0)
+    {
+        this->predictor.emplace(horizon);
+    }
+    else
+    {
+        this->predictor.reset();
+    }
+
+    this->send_predicted = send_predicted;
+}
+
+void pen::show_prediction()
+{
+    if (!this->predictor.has_value())
+    {
+        return;
+    }
+
+    auto predicted = this->predictor->get_prediction();
+    this->screen.move_cursor(
+        std::clamp(predicted.x, 0, this->screen.get_xres() - 1),
+        std::clamp(predicted.y, 0, this->screen.get_yres() - 1)
+    );
+}
+
+void pen::add_stroke_point(point next)
+{
+    const auto start = this->anchor;
+    const double limit = static_cast<double>(this->tolerance)
+        * this->tolerance;
+
+    // Check that the held points stay close to the segment that would
+    // replace them
+    auto fits = [start, next, limit](point held_point)
+    {
+        double dx = next.x - start.x;
+        double dy = next.y - start.y;
+        double px = held_point.x - start.x;
+        double py = held_point.y - start.y;
+        double length = dx * dx + dy * dy;
+        double along = length > 0
+            ? std::clamp((px * dx + py * dy) / length, 0., 1.)
+            : 0.;
+        double ex = px - along * dx;
+        double ey = py - along * dy;
+        return ex * ex + ey * ey <= limit;
+    };
+
+    if (!std::all_of(this->held.begin(), this->held.end(), fits))
+    {
+        this->flush_stroke();
+    }
+
+    if (this->held.empty())
+    {
+        this->held_since = this->time_source.now();
+    }
+
+    this->held.push_back(next);
+}
+
+void pen::flush_stroke()
+{
+    if (this->held.empty())
+    {
+        return;
+    }
+
+    point last = this->held.back();
+    this->send_button_press(last.x, last.y, MouseButton::Left);
+    this->anchor = last;
+
+    stroke_points_sent.add();
+    stroke_points_dropped.add(this->held.size() - 1);
+    update_reduction();
+    this->held.clear();
+}
+
 } // namespace app
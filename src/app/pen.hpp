@@ -1,7 +1,12 @@
 #ifndef APP_PEN_HPP
 #define APP_PEN_HPP
 
+#include "clock.hpp"
 #include "event_loop.hpp"
+#include "pen_predictor.hpp"
+#include <chrono>
+#include <optional>
+#include <vector>
 
 namespace rmioc
 {
@@ -20,15 +25,50 @@ public:
     pen(
         rmioc::pen& device,
         app::screen& screen_device,
-        MouseCallback send_button_press
+        MouseCallback send_button_press,
+        const clock& time_source = clock::system()
     );
 
-    /** Process events from the pen digitizer. */
+    /** Process the next report from the pen digitizer. */
     event_loop_status process_events();
 
+    /** Whether reports already read from the digitizer await processing. */
+    bool has_pending_events() const;
+
+    /** Send simplified stroke points that were held for too long. */
+    event_loop_status event_loop();
+
     /** Whether other forms of input should be inhibited. */
     bool is_inhibiting() const;
 
+    /**
+     * Simplify strokes before sending them to the server.
+     *
+     * While the pen touches the screen, points that lie close to the
+     * segment joining the previously sent point and a later point are
+     * dropped. Points are held for a short time at most, so that strokes
+     * still show up promptly.
+     *
+     * @param tolerance Maximum distance between a dropped point and the
+     * sent stroke (in pixels), or 0 to send all points.
+     */
+    void set_tolerance(int tolerance);
+
+    /**
+     * Extrapolate the pen position to compensate for the display latency
+     * (see `app::pen_predictor`).
+     *
+     * The cursor drawn on the client side follows the predicted position.
+     *
+     * @param horizon Time ahead to predict, or 0 to disable predictions.
+     * @param send_predicted True to also send predicted positions to the
+     * server while the pen touches the screen.
+     */
+    void set_prediction(
+        std::chrono::milliseconds horizon,
+        bool send_predicted
+    );
+
 private:
     /** reMarkable pen digitizer device. */
     rmioc::pen& device;
@@ -39,8 +79,53 @@ private:
     /** Callback for sending mouse events. */
     MouseCallback send_button_press;
 
+    /** Clock used for limiting the time points are held. */
+    const clock& time_source;
+
     /** Current state of the pen */
     MouseButton state;
+
+    /** Position of the pen on the screen. */
+    struct point
+    {
+        int x;
+        int y;
+    };
+
+    /** Predictor of the pen position, if enabled. */
+    std::optional<pen_predictor> predictor;
+
+    /** Whether to send predicted positions to the server. */
+    bool send_predicted = false;
+
+    /** Maximum distance of dropped points to the stroke (in pixels). */
+    int tolerance = 0;
+
+    /** Last point of the current stroke that was sent. */
+    point anchor{0, 0};
+
+    /** Points of the current stroke received after the anchor. */
+    std::vector<point> held;
+
+    /** Time at which the oldest held point was received. */
+    clock::time_point held_since{};
+
+    /**
+     * Register a point of the current stroke, sending the last held point
+     * if the new one cannot replace it.
+     *
+     * @param next New point of the stroke.
+     */
+    void add_stroke_point(point next);
+
+    /** Send the last held point, dropping the others. */
+    void flush_stroke();
+
+    /**
+     * Move the cursor drawn on the client side to the predicted position,
+     * after sent events moved it to the actual one.
+     */
+    void show_prediction();
 };
 
 } // namespace app
@@ -0,0 +1,152 @@
+#include "pen_predictor.hpp"
+#include "../stats.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace chrono = std::chrono;
+
+namespace app
+{
+
+namespace
+{
+
+/**
+ * Fractions of the difference between a sample and the expected position
+ * used to correct the estimated position, velocity and acceleration.
+ *
+ * Larger values follow direction changes more quickly but amplify the
+ * digitizer noise in the predictions.
+ */
+constexpr double position_gain = 0.5;
+constexpr double velocity_gain = 0.2;
+constexpr double acceleration_gain = 0.02;
+
+/**
+ * Longest time between two samples of the same motion.
+ *
+ * The pen is considered to have stopped when no sample arrives for that
+ * long, and the next sample starts a new motion.
+ */
+constexpr chrono::milliseconds max_sample_gap{50};
+
+/**
+ * Maximum contribution of the acceleration to predictions, relative to the
+ * contribution of the velocity.
+ */
+constexpr double max_curve_ratio = 0.5;
+
+/** Minimum number of samples before predictions are checked. */
+constexpr int min_checked_samples = 3;
+
+auto& prediction_checks = stats::get_counter(
+    "vnsee_pen_prediction_checks_total",
+    "Pen position predictions compared with the actual position"
+);
+
+auto& prediction_error_total = stats::get_counter(
+    "vnsee_pen_prediction_error_pixels_total",
+    "Total distance between predicted and actual pen positions"
+);
+
+auto& prediction_error_last = stats::get_gauge(
+    "vnsee_pen_prediction_error_pixels",
+    "Distance between the last checked prediction and the actual position"
+);
+
+} // anonymous namespace
+
+pen_predictor::pen_predictor(chrono::milliseconds horizon)
+: horizon(horizon)
+{}
+
+void pen_predictor::axis::correct(double sample, double delta)
+{
+    double expected = this->value + this->velocity * delta
+        + this->acceleration * delta * delta / 2;
+    double expected_velocity = this->velocity + this->acceleration * delta;
+    double residual = sample - expected;
+
+    this->value = expected + position_gain * residual;
+    this->velocity = expected_velocity + velocity_gain * residual / delta;
+    this->acceleration += 2 * acceleration_gain * residual / (delta * delta);
+}
+
+auto pen_predictor::axis::extrapolate(double delta) const -> double
+{
+    double linear = this->velocity * delta;
+    double curve = this->acceleration * delta * delta / 2;
+
+    // Keep the acceleration from dominating the prediction, which makes
+    // it overshoot wildly on sharp turns
+    double max_curve = std::abs(linear) * max_curve_ratio;
+    return this->value + linear + std::clamp(curve, -max_curve, max_curve);
+}
+
+auto pen_predictor::add_sample(clock::time_point time, int x, int y)
+-> position
+{
+    auto gap = time - this->last_time;
+
+    if (this->samples == 0 || gap > max_sample_gap)
+    {
+        this->x_axis = {static_cast<double>(x), 0, 0};
+        this->y_axis = {static_cast<double>(y), 0, 0};
+        this->checks.clear();
+        this->samples = 0;
+    }
+    else if (gap.count() > 0)
+    {
+        double delta = chrono::duration<double>(gap).count();
+        this->x_axis.correct(x, delta);
+        this->y_axis.correct(y, delta);
+    }
+
+    this->last_time = time;
+    ++this->samples;
+
+    // Compare the latest prediction that targeted this sample or earlier
+    bool has_check = false;
+    position checked{0, 0};
+
+    while (!this->checks.empty() && this->checks.front().target <= time)
+    {
+        checked = this->checks.front().predicted;
+        has_check = true;
+        this->checks.pop_front();
+    }
+
+    if (has_check)
+    {
+        double error = std::hypot(checked.x - x, checked.y - y);
+        prediction_checks.add();
+        prediction_error_total.add(std::llround(error));
+        prediction_error_last.set(error);
+    }
+
+    double ahead = chrono::duration<double>(this->horizon).count();
+    this->prediction = {
+        static_cast<int>(std::lround(this->x_axis.extrapolate(ahead))),
+        static_cast<int>(std::lround(this->y_axis.extrapolate(ahead)))
+    };
+
+    if (this->samples >= min_checked_samples)
+    {
+        this->checks.push_back({time + this->horizon, this->prediction});
+    }
+
+    return this->prediction;
+}
+
+auto pen_predictor::get_prediction() const -> position
+{
+    return this->prediction;
+}
+
+void pen_predictor::reset()
+{
+    this->samples = 0;
+    this->checks.clear();
+}
+
+} // namespace app
@@ -0,0 +1,111 @@
+#ifndef APP_PEN_PREDICTOR_HPP
+#define APP_PEN_PREDICTOR_HPP
+
+#include "clock.hpp"
+#include <chrono>
+#include <deque>
+
+namespace app
+{
+
+/**
+ * Extrapolation of the pen position a short time ahead.
+ *
+ * Follows the pen with an alpha-beta-gamma filter, the steady-state form
+ * of a Kalman filter for a constant acceleration motion. Each new sample
+ * corrects the estimated position, velocity and acceleration by a fixed
+ * fraction of the difference between the sample and the position that was
+ * expected at that time. Predictions are then compared with the samples
+ * received at the time they targeted, to measure their error.
+ */
+class pen_predictor
+{
+public:
+    /** Position on the screen (in pixels). */
+    struct position
+    {
+        int x;
+        int y;
+    };
+
+    /**
+     * Create a predictor.
+     *
+     * @param horizon Time ahead of the last sample to predict.
+     */
+    explicit pen_predictor(std::chrono::milliseconds horizon);
+
+    /**
+     * Register a new sample and predict the position of the pen.
+     *
+     * @param time Time at which the sample was taken by the device.
+     * @param x Column of the sampled position.
+     * @param y Row of the sampled position.
+     * @return Predicted position after the time horizon.
+     */
+    position add_sample(clock::time_point time, int x, int y);
+
+    /** Get the last predicted position. */
+    position get_prediction() const;
+
+    /**
+     * Forget the current motion, for example when the pen starts or stops
+     * touching the screen.
+     */
+    void reset();
+
+private:
+    /** Time ahead of the last sample to predict. */
+    std::chrono::milliseconds horizon;
+
+    /** Estimated motion along one axis. */
+    struct axis
+    {
+        /** Position (in pixels). */
+        double value = 0;
+
+        /** Velocity (in pixels per second). */
+        double velocity = 0;
+
+        /** Acceleration (in pixels per second squared). */
+        double acceleration = 0;
+
+        /**
+         * Correct the estimate with a new sample.
+         *
+         * @param sample Sampled position (in pixels).
+         * @param delta Time since the previous sample (in seconds).
+         */
+        void correct(double sample, double delta);
+
+        /** Extrapolate the position after a given time (in seconds). */
+        double extrapolate(double delta) const;
+    };
+
+    /** Estimated motion along both axes. */
+    axis x_axis;
+    axis y_axis;
+
+    /** Time of the last sample. */
+    clock::time_point last_time{};
+
+    /** Number of samples since the last reset. */
+    int samples = 0;
+
+    /** Last predicted position. */
+    position prediction{0, 0};
+
+    /** Prediction waiting for a sample at its target time. */
+    struct pending_check
+    {
+        clock::time_point target;
+        position predicted;
+    };
+
+    /** Predictions waiting to be compared with samples, in time order. */
+    std::deque<pending_check> checks;
+}; // class pen_predictor
+
+} // namespace app
+
+#endif // APP_PEN_PREDICTOR_HPP
@@ -0,0 +1,275 @@
+#include "pixel_format.hpp"
+#include "../rmioc/screen.hpp"
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#if defined(VNSEE_NEON) && defined(__arm__)
+#include <sys/auxv.h>
+#endif
+
+namespace
+{
+
+/** Size of the pixels of the 32-bit server formats (in bytes). */
+constexpr std::size_t pixel32_size = 4;
+
+/** Pack 8-bit components in a RGB565 pixel. */
+constexpr auto pack_rgb565(
+    std::uint32_t red,
+    std::uint32_t green,
+    std::uint32_t blue
+) -> std::uint16_t
+{
+    // NOLINTNEXTLINE(cppcoreguidelines-avoid-magic-numbers,hicpp-signed-bitwise)
+    return static_cast<std::uint16_t>(
+        ((red >> 3U) << 11U) | ((green >> 2U) << 5U) | (blue >> 3U));
+}
+
+/** Convert rows of 32-bit pixels whose red component is in byte `R`. */
+template<std::size_t R, std::size_t B>
+void pixel32_to_rgb565(
+    const std::uint8_t* source,
+    std::uint8_t* dest,
+    std::size_t count
+)
+{
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        const std::uint8_t* pixel = source + i * pixel32_size;
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        std::uint16_t value = pack_rgb565(pixel[R], pixel[1], pixel[B]);
+
+        // Screen pixels use the native byte order, little-endian on all
+        // supported devices
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        dest[2 * i] = static_cast<std::uint8_t>(value);
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        dest[2 * i + 1] = static_cast<std::uint8_t>(value >> CHAR_BIT);
+    }
+}
+
+#ifdef VNSEE_NEON
+/** Check whether the processor has NEON instructions. */
+auto has_neon() -> bool
+{
+#ifdef __arm__
+    return (getauxval(AT_HWCAP) & HWCAP_ARM_NEON) != 0;
+#else
+    // Always available on 64-bit ARM
+    return true;
+#endif
+}
+#endif
+
+/** Scale an 8-bit component to a screen component. */
+auto pack_component(std::uint32_t value, rmioc::component_format format)
+-> std::uint32_t
+{
+    if (format.length < CHAR_BIT)
+    {
+        value >>= CHAR_BIT - format.length;
+    }
+    else
+    {
+        value <<= format.length - CHAR_BIT;
+    }
+
+    return value << format.offset;
+}
+
+} // anonymous namespace
+
+namespace app
+{
+
+namespace detail
+{
+
+void rgb32_to_rgb565(
+    const std::uint8_t* source,
+    std::uint8_t* dest,
+    std::size_t count
+)
+{
+    pixel32_to_rgb565</* R = */ 2, /* B = */ 0>(source, dest, count);
+}
+
+void bgr32_to_rgb565(
+    const std::uint8_t* source,
+    std::uint8_t* dest,
+    std::size_t count
+)
+{
+    pixel32_to_rgb565</* R = */ 0, /* B = */ 2>(source, dest, count);
+}
+
+} // namespace app::detail
+
+pixel_converter::pixel_converter(
+    server_formats format,
+    const rmioc::screen& device
+)
+: format(format)
+, dest_size(device.get_bits_per_pixel() / CHAR_BIT)
+, red(device.get_red_format())
+, green(device.get_green_format())
+, blue(device.get_blue_format())
+{
+    for (std::uint32_t level = 0; level < this->luma_pixels.size(); ++level)
+    {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-constant-array-index)
+        this->luma_pixels[level] = pack_component(level, this->red)
+            | pack_component(level, this->green)
+            | pack_component(level, this->blue);
+    }
+
+    // NOLINTNEXTLINE(cppcoreguidelines-avoid-magic-numbers)
+    bool is_rgb565 = this->dest_size == 2
+        && this->red.offset == 11 && this->red.length == 5
+        && this->green.offset == 5 && this->green.length == 6
+        && this->blue.offset == 0 && this->blue.length == 5;
+
+    if (!is_rgb565)
+    {
+        return;
+    }
+
+    if (format == server_formats::rgb32)
+    {
+        this->fast_kernel = detail::rgb32_to_rgb565;
+    }
+    else if (format == server_formats::bgr32)
+    {
+        this->fast_kernel = detail::bgr32_to_rgb565;
+    }
+
+#ifdef VNSEE_NEON
+    if (has_neon())
+    {
+        if (format == server_formats::rgb32)
+        {
+            this->fast_kernel = detail::rgb32_to_rgb565_neon;
+        }
+        else if (format == server_formats::bgr32)
+        {
+            this->fast_kernel = detail::bgr32_to_rgb565_neon;
+        }
+    }
+#endif
+}
+
+auto pixel_converter::get_format() const -> server_formats
+{
+    return this->format;
+}
+
+auto pixel_converter::is_identity() const -> bool
+{
+    return this->format == server_formats::screen;
+}
+
+auto pixel_converter::get_source_size() const -> std::size_t
+{
+    return this->is_identity() ? this->dest_size : pixel32_size;
+}
+
+void pixel_converter::convert(
+    const std::uint8_t* source,
+    std::uint8_t* dest,
+    std::size_t count
+) const
+{
+    if (this->fast_kernel != nullptr)
+    {
+        this->fast_kernel(source, dest, count);
+        return;
+    }
+
+    if (this->is_identity())
+    {
+        std::memcpy(dest, source, count * this->dest_size);
+        return;
+    }
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        std::uint32_t pixel = 0;
+
+        for (std::size_t byte = 0; byte < pixel32_size; ++byte)
+        {
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+            pixel |= std::uint32_t{source[i * pixel32_size + byte]}
+                << (byte * CHAR_BIT);
+        }
+
+        pixel = this->convert(pixel);
+
+        for (std::size_t byte = 0; byte < this->dest_size; ++byte)
+        {
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+            dest[i * this->dest_size + byte]
+                = static_cast<std::uint8_t>(pixel >> (byte * CHAR_BIT));
+        }
+    }
+}
+
+auto pixel_converter::convert(std::uint32_t pixel) const -> std::uint32_t
+{
+    if (this->is_identity())
+    {
+        return pixel;
+    }
+
+    constexpr std::uint32_t component_mask = 0xFF;
+    std::uint32_t low = pixel & component_mask;
+    std::uint32_t green_value = (pixel >> CHAR_BIT) & component_mask;
+    std::uint32_t high = (pixel >> (2 * CHAR_BIT)) & component_mask;
+
+    std::uint32_t red_value = this->format == server_formats::rgb32
+        ? high : low;
+    std::uint32_t blue_value = this->format == server_formats::rgb32
+        ? low : high;
+
+    return pack_component(red_value, this->red)
+        | pack_component(green_value, this->green)
+        | pack_component(blue_value, this->blue);
+}
+
+void pixel_converter::convert_luma(
+    const std::uint8_t* source,
+    std::uint8_t* dest,
+    std::size_t count
+) const
+{
+    if (this->dest_size == 2)
+    {
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic,cppcoreguidelines-pro-bounds-constant-array-index)
+            std::uint32_t pixel = this->luma_pixels[source[i]];
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+            dest[2 * i] = static_cast<std::uint8_t>(pixel);
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+            dest[2 * i + 1] = static_cast<std::uint8_t>(pixel >> CHAR_BIT);
+        }
+
+        return;
+    }
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic,cppcoreguidelines-pro-bounds-constant-array-index)
+        std::uint32_t pixel = this->luma_pixels[source[i]];
+
+        for (std::size_t byte = 0; byte < this->dest_size; ++byte)
+        {
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+            dest[i * this->dest_size + byte]
+                = static_cast<std::uint8_t>(pixel >> (byte * CHAR_BIT));
+        }
+    }
+}
+
+} // namespace app
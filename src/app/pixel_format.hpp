@@ -0,0 +1,150 @@
+#ifndef APP_PIXEL_FORMAT_HPP
+#define APP_PIXEL_FORMAT_HPP
+
+#include "../rmioc/screen.hpp"
+#include <array>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+
+namespace app
+{
+
+/** Pixel formats that can be requested from the server. */
+enum class server_formats
+{
+    /** Same format as the screen, stored without conversion. */
+    screen,
+
+    /** 32-bit pixels with 8-bit components, red in the highest one. */
+    rgb32,
+
+    /** 32-bit pixels with 8-bit components, blue in the highest one. */
+    bgr32,
+};
+
+/**
+ * Convert pixels received from the server to the screen format.
+ *
+ * Conversions to RGB565, the format of all supported screens, use NEON
+ * kernels when the processor has them and scalar code otherwise. Other
+ * screen formats are converted component by component.
+ */
+class pixel_converter
+{
+public:
+    /**
+     * Create a converter.
+     *
+     * @param format Format of the pixels received from the server.
+     * @param device Screen whose format to convert to.
+     */
+    pixel_converter(server_formats format, const rmioc::screen& device);
+
+    /** Get the format of the pixels received from the server. */
+    server_formats get_format() const;
+
+    /** Check whether pixels are stored as received. */
+    bool is_identity() const;
+
+    /** Get the size of a pixel received from the server (in bytes). */
+    std::size_t get_source_size() const;
+
+    /**
+     * Convert a row of pixels.
+     *
+     * @param source Pixels received from the server.
+     * @param dest Buffer receiving the converted pixels.
+     * @param count Number of pixels to convert.
+     */
+    void convert(
+        const std::uint8_t* source,
+        std::uint8_t* dest,
+        std::size_t count
+    ) const;
+
+    /**
+     * Convert a single pixel value, in host byte order.
+     *
+     * @param pixel Pixel received from the server.
+     * @return Converted pixel.
+     */
+    std::uint32_t convert(std::uint32_t pixel) const;
+
+    /**
+     * Convert a row of gray levels, whatever the server format.
+     *
+     * @param source 8-bit luma of each pixel.
+     * @param dest Buffer receiving the converted pixels.
+     * @param count Number of pixels to convert.
+     */
+    void convert_luma(
+        const std::uint8_t* source,
+        std::uint8_t* dest,
+        std::size_t count
+    ) const;
+
+private:
+    /** Function converting rows of pixels. */
+    using kernel = void (*)(
+        const std::uint8_t* source,
+        std::uint8_t* dest,
+        std::size_t count
+    );
+
+    /** Format of the pixels received from the server. */
+    server_formats format;
+
+    /** Size of a screen pixel (in bytes). */
+    std::size_t dest_size;
+
+    /** Packing of the screen pixel components. */
+    rmioc::component_format red;
+    rmioc::component_format green;
+    rmioc::component_format blue;
+
+    /** Specialized conversion for the current formats, if any. */
+    kernel fast_kernel = nullptr;
+
+    /** Screen pixel for each gray level. */
+    std::array<std::uint32_t, 1U << CHAR_BIT> luma_pixels{};
+}; // class pixel_converter
+
+namespace detail
+{
+
+/** Convert 32-bit pixels with red in the highest component to RGB565. */
+void rgb32_to_rgb565(
+    const std::uint8_t* source,
+    std::uint8_t* dest,
+    std::size_t count
+);
+
+/** Convert 32-bit pixels with blue in the highest component to RGB565. */
+void bgr32_to_rgb565(
+    const std::uint8_t* source,
+    std::uint8_t* dest,
+    std::size_t count
+);
+
+#ifdef VNSEE_NEON
+/** NEON variant of `rgb32_to_rgb565()`. */
+void rgb32_to_rgb565_neon(
+    const std::uint8_t* source,
+    std::uint8_t* dest,
+    std::size_t count
+);
+
+/** NEON variant of `bgr32_to_rgb565()`. */
+void bgr32_to_rgb565_neon(
+    const std::uint8_t* source,
+    std::uint8_t* dest,
+    std::size_t count
+);
+#endif
+
+} // namespace app::detail
+
+} // namespace app
+
+#endif // APP_PIXEL_FORMAT_HPP
@@ -0,0 +1,81 @@
+#include "pixel_format.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <arm_neon.h>
+
+namespace
+{
+
+/** Number of pixels converted at once. */
+constexpr std::size_t lanes = 8;
+
+/**
+ * Convert rows of 32-bit pixels to RGB565.
+ *
+ * @tparam R Index of the byte holding the red component.
+ * @tparam B Index of the byte holding the blue component.
+ * @param tail Scalar conversion for the last pixels.
+ */
+template<int R, int B>
+void pixel32_to_rgb565(
+    const std::uint8_t* source,
+    std::uint8_t* dest,
+    std::size_t count,
+    void (*tail)(const std::uint8_t*, std::uint8_t*, std::size_t)
+)
+{
+    constexpr std::size_t source_size = 4;
+    constexpr std::size_t dest_size = 2;
+    std::size_t i = 0;
+
+    for (; i + lanes <= count; i += lanes)
+    {
+        // Split the components of 8 pixels into separate registers
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        uint8x8x4_t pixels = vld4_u8(source + i * source_size);
+
+        // Move each component to the top of a 16-bit lane and shift the
+        // next ones in below it, truncating their low bits
+        uint16x8_t packed = vshll_n_u8(pixels.val[R], 8);
+        packed = vsriq_n_u16(packed, vshll_n_u8(pixels.val[1], 8), 5);
+        packed = vsriq_n_u16(packed, vshll_n_u8(pixels.val[B], 8), 11);
+
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        vst1q_u8(dest + i * dest_size, vreinterpretq_u8_u16(packed));
+    }
+
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    tail(source + i * source_size, dest + i * dest_size, count - i);
+}
+
+} // anonymous namespace
+
+namespace app
+{
+
+namespace detail
+{
+
+void rgb32_to_rgb565_neon(
+    const std::uint8_t* source,
+    std::uint8_t* dest,
+    std::size_t count
+)
+{
+    pixel32_to_rgb565</* R = */ 2, /* B = */ 0>(
+        source, dest, count, rgb32_to_rgb565);
+}
+
+void bgr32_to_rgb565_neon(
+    const std::uint8_t* source,
+    std::uint8_t* dest,
+    std::size_t count
+)
+{
+    pixel32_to_rgb565</* R = */ 0, /* B = */ 2>(
+        source, dest, count, bgr32_to_rgb565);
+}
+
+} // namespace app::detail
+
+} // namespace app
@@ -1,14 +1,22 @@
 #include "screen.hpp"
 #include "event_loop.hpp"
-#include "../log.hpp"
 #include "../rmioc/screen.hpp"
+#include "../stats.hpp"
+#include "../trace.hpp"
 #include <algorithm>
+#include <array>
+#include <cerrno>
 #include <chrono>
 #include <climits>
+#include <cstdint>
 #include <cstring>
-#include <ostream>
+#include <iostream>
+#include <sstream>
 #include <stdexcept>
+#include <utility>
 #include <rfb/rfbclient.h>
+#include <poll.h>
+#include <sys/uio.h>
 // IWYU pragma: no_include <type_traits>
 
 namespace chrono = std::chrono;
@@ -30,16 +38,238 @@ constexpr chrono::milliseconds standard_repaint_delay{400};
  */
 constexpr chrono::milliseconds fast_repaint_delay{50};
 
+/**
+ * Size of the square tiles compared when resuming on a new connection
+ * (in pixels).
+ *
+ * Smaller tiles repaint less unchanged content but issue more updates.
+ */
+constexpr int resync_tile_size = 64;
+
+/**
+ * Minimum size of the raw rectangles read straight into screen memory
+ * (in bytes).
+ *
+ * Smaller rectangles go through a buffer, where copying their rows costs
+ * less than describing each of them to the kernel.
+ */
+constexpr std::size_t direct_receive_min_bytes = 64 * 1024;
+
+/**
+ * Fewest areas, counting the visible one, in a framebuffer taken to hold
+ * client-side cache areas below the screen.
+ *
+ * x11vnc stacks `-ncache` areas (10 by default) below the screen, while
+ * servers that are just a bit taller than the screen have two areas.
+ */
+constexpr int min_cache_areas = 3;
+
+/**
+ * Largest difference between the visible part of a framebuffer holding
+ * cache areas and the screen, relative to the screen size.
+ */
+constexpr int cache_size_margin = 16;
+
+/** Size of the buffer used to receive other raw rectangles (in bytes). */
+constexpr std::size_t receive_chunk_bytes = 64 * 1024;
+
+/** Compression level requested with the Tight encoding, from 0 to 9. */
+constexpr int tight_compress_level = 9;
+
+/** JPEG quality requested with the Tight encoding, from 0 to 9. */
+constexpr int tight_jpeg_quality = 5;
+
+/**
+ * Longest delay between two update requests while idle.
+ *
+ * Updates arriving meanwhile are held back by the server and merged, so
+ * that an idle screen still catches up with changes at this pace.
+ */
+constexpr chrono::milliseconds idle_heartbeat{10000};
+
 namespace app
 {
 
+namespace
+{
+
+/**
+ * Check whether the protocol can be read straight from the socket of a
+ * connection, instead of going through the VNC library.
+ *
+ * Replayed sessions, TLS sessions and SASL sessions, which may wrap the
+ * protocol in a security layer, are read by the library.
+ */
+auto is_plain_socket(const rfbClient* client) -> bool
+{
+    if (client->serverPort == -1 || client->tlsSession != nullptr)
+    {
+        return false;
+    }
+
+#ifdef LIBVNCSERVER_HAVE_SASL
+    if (client->saslconn != nullptr)
+    {
+        return false;
+    }
+#endif
+
+    return true;
+}
+
+auto& raw_bytes_received = stats::get_counter(
+    "vnsee_vnc_received_bytes_total",
+    "Bytes of pixel data received from the server by encoding, after zlib "
+    "decompression for Tight",
+    "encoding=\"raw\""
+);
+
+auto& tight_bytes_received = stats::get_counter(
+    "vnsee_vnc_received_bytes_total",
+    "Bytes of pixel data received from the server by encoding, after zlib "
+    "decompression for Tight",
+    "encoding=\"tight\""
+);
+
+#ifdef VNSEE_JPEG
+auto& jpeg_bytes_received = stats::get_counter(
+    "vnsee_vnc_received_bytes_total",
+    "Bytes of pixel data received from the server by encoding, after zlib "
+    "decompression for Tight",
+    "encoding=\"jpeg\""
+);
+#endif
+
+auto& rects_decoded = stats::get_counter(
+    "vnsee_rects_decoded_total",
+    "Rectangles received from the server"
+);
+
+auto& pixels_decoded = stats::get_counter(
+    "vnsee_pixels_decoded_total",
+    "Pixels received from the server"
+);
+
+auto& standard_repaints = stats::get_counter(
+    "vnsee_repaints_total",
+    "Screen repaints issued by waveform mode",
+    "waveform=\"gl16\""
+);
+
+auto& fast_repaints = stats::get_counter(
+    "vnsee_repaints_total",
+    "Screen repaints issued by waveform mode",
+    "waveform=\"du\""
+);
+
+auto& resync_changed_tiles = stats::get_counter(
+    "vnsee_resync_tiles_total",
+    "Tiles compared with the screen contents after a reconnection",
+    "result=\"changed\""
+);
+
+auto& resync_unchanged_tiles = stats::get_counter(
+    "vnsee_resync_tiles_total",
+    "Tiles compared with the screen contents after a reconnection",
+    "result=\"unchanged\""
+);
+
+auto& confirmed_completions = stats::get_counter(
+    "vnsee_repaint_completions_total",
+    "Repaints reported complete by the device",
+    "result=\"confirmed\""
+);
+
+auto& timed_out_completions = stats::get_counter(
+    "vnsee_repaint_completions_total",
+    "Repaints reported complete by the device",
+    "result=\"timeout\""
+);
+
+auto& completion_latency_total = stats::get_counter(
+    "vnsee_repaint_latency_microseconds_total",
+    "Total time between submitting repaints and their completion"
+);
+
+auto& completion_latency_last = stats::get_gauge(
+    "vnsee_repaint_latency_seconds",
+    "Time between submitting the last completed repaint and its completion"
+);
+
+auto& repaints_in_flight_gauge = stats::get_gauge(
+    "vnsee_repaints_in_flight",
+    "Repaints sent to the device that are not complete yet"
+);
+
+auto& update_requests_sent = stats::get_counter(
+    "vnsee_update_requests_total",
+    "Update requests sent to the server",
+    "timing=\"immediate\""
+);
+
+auto& update_requests_deferred = stats::get_counter(
+    "vnsee_update_requests_total",
+    "Update requests sent to the server",
+    "timing=\"deferred\""
+);
+
+auto& update_request_delay = stats::get_gauge(
+    "vnsee_update_request_delay_seconds",
+    "Delay before requesting the next update, growing while idle"
+);
+
+auto& pending_rects = stats::get_gauge(
+    "vnsee_screen_pending_rects",
+    "Rectangles merged in the update waiting to be repainted"
+);
+
+} // anonymous namespace
+
 // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast,cppcoreguidelines-avoid-non-const-global-variables,cppcoreguidelines-avoid-magic-numbers)
 void* screen::instance_tag = reinterpret_cast<void*>(6803);
 
-screen::screen(rmioc::screen& device, rfbClient* vnc_client)
+screen::screen(
+    rmioc::screen& device,
+    rfbClient* vnc_client,
+    const clock& time_source
+)
 : device(device)
 , vnc_client(vnc_client)
+, time_source(time_source)
+, converter(server_formats::screen, device)
+, library_bytes(&raw_bytes_received)
+, standard_delay(standard_repaint_delay)
+, fast_delay(fast_repaint_delay)
 , repaint_mode(repaint_modes::standard)
+{
+    this->setup_client();
+}
+
+void screen::reattach(rfbClient* vnc_client)
+{
+    this->vnc_client = vnc_client;
+    this->setup_client();
+    this->request_deferred = false;
+
+    auto& resync = this->resync_info;
+    resync.columns = (this->device.get_xres_memory() + resync_tile_size - 1)
+        / resync_tile_size;
+    resync.rows = (this->device.get_yres_memory() + resync_tile_size - 1)
+        / resync_tile_size;
+    resync.changed.assign(
+        static_cast<std::size_t>(resync.columns) * resync.rows,
+        false
+    );
+    resync.pending = true;
+}
+
+void screen::detach()
+{
+    this->vnc_client = nullptr;
+    this->request_deferred = false;
+}
+
+void screen::setup_client()
 {
     rfbClientSetClientData(
         this->vnc_client,
@@ -47,21 +277,205 @@ screen::screen(rmioc::screen& device, rfbClient* vnc_client)
         this
     );
 
-    // Ask the server to send pixels in the same format as the screen buffer
-    this->vnc_client->format.bitsPerPixel = this->device.get_bits_per_pixel();
-    this->vnc_client->format.depth = this->device.get_bits_per_pixel();
-    this->vnc_client->format.redShift = this->device.get_red_format().offset;
-    this->vnc_client->format.redMax = this->device.get_red_format().max();
-    this->vnc_client->format.greenShift = this->device.get_green_format().offset;
-    this->vnc_client->format.greenMax = this->device.get_green_format().max();
-    this->vnc_client->format.blueShift = this->device.get_blue_format().offset;
-    this->vnc_client->format.blueMax = this->device.get_blue_format().max();
-
-    // Force the raw encoding and override the rect reception methods
-    this->vnc_client->appData.encodingsString = "raw";
+    auto& format = this->vnc_client->format;
+
+    if (this->converter.is_identity())
+    {
+        // Ask the server to send pixels in the same format as the screen
+        // buffer
+        format.bitsPerPixel = this->device.get_bits_per_pixel();
+        format.depth = this->device.get_bits_per_pixel();
+        format.redShift = this->device.get_red_format().offset;
+        format.redMax = this->device.get_red_format().max();
+        format.greenShift = this->device.get_green_format().offset;
+        format.greenMax = this->device.get_green_format().max();
+        format.blueShift = this->device.get_blue_format().offset;
+        format.blueMax = this->device.get_blue_format().max();
+    }
+    else
+    {
+        constexpr std::uint8_t high_shift = 16;
+        constexpr std::uint8_t middle_shift = 8;
+        constexpr std::uint16_t component_max = 255;
+        bool rgb = this->converter.get_format() == server_formats::rgb32;
+
+        format.bitsPerPixel = this->converter.get_source_size() * CHAR_BIT;
+        format.depth = 3 * middle_shift;
+        format.redShift = rgb ? high_shift : 0;
+        format.redMax = component_max;
+        format.greenShift = middle_shift;
+        format.greenMax = component_max;
+        format.blueShift = rgb ? 0 : high_shift;
+        format.blueMax = component_max;
+    }
+
+    // Choose the encodings and override the rect reception methods
+    this->configure_encodings();
     this->vnc_client->MallocFrameBuffer = screen::create_framebuf;
     this->vnc_client->GotBitmap = screen::recv_update;
     this->vnc_client->GotFrameBufferUpdate = screen::commit_updates;
+    this->vnc_client->GotCopyRect = screen::copy_rect;
+    this->vnc_client->GotFillRect = screen::fill_rect;
+    this->vnc_client->FinishedFrameBufferUpdate = screen::finish_updates;
+#ifdef VNSEE_JPEG
+    this->vnc_client->GotJpeg = screen::recv_jpeg;
+#endif
+
+    if (this->cursor_overlay.has_value())
+    {
+        // Ask for the cursor shape and position instead of having the
+        // server draw it, which would cause a repaint for each move
+        this->vnc_client->appData.useRemoteCursor = TRUE;
+        this->vnc_client->GotCursorShape = screen::set_cursor_shape;
+        this->vnc_client->HandleCursorPos = screen::set_cursor_position;
+    }
+}
+
+void screen::configure_encodings()
+{
+    auto& app_data = this->vnc_client->appData;
+    auto mode = this->encodings.has_value()
+        ? this->encodings->get_mode()
+        : encoding_modes::raw;
+
+    // Cached areas are restored with CopyRect
+    bool cached = this->cache_info.top != INT_MAX;
+    app_data.enableJPEG = FALSE;
+
+    switch (mode)
+    {
+    case encoding_modes::raw:
+        app_data.encodingsString = cached ? "copyrect raw" : "raw";
+        break;
+
+    case encoding_modes::tight:
+        app_data.encodingsString = cached
+            ? "tight copyrect raw"
+            : "tight raw";
+        app_data.compressLevel = tight_compress_level;
+        app_data.enableJPEG = TRUE;
+        app_data.qualityLevel = tight_jpeg_quality;
+        break;
+    }
+}
+
+void screen::set_latency_target(chrono::milliseconds target)
+{
+    this->encodings.emplace(
+        target,
+        static_cast<std::size_t>(this->device.get_xres())
+            * this->device.get_yres()
+    );
+    this->configure_encodings();
+}
+
+void screen::finish_frame(clock::time_point start)
+{
+    if (!this->encodings.has_value())
+    {
+        return;
+    }
+
+    auto pixels = this->frame_pixels;
+    this->frame_pixels = 0;
+
+    if (!this->encodings->on_frame(pixels, this->time_source.now() - start))
+    {
+        return;
+    }
+
+    std::cerr << "Switching to the "
+        << get_mode_name(this->encodings->get_mode()) << " encoding\n";
+
+    if (this->idle_timeout.count() > 0
+            && this->encodings->get_mode() != encoding_modes::raw)
+    {
+        std::cerr << "Updates are requested right away until raw pixels "
+            "are used again\n";
+    }
+
+    this->configure_encodings();
+
+    // A failed request shows up as a failed read on the connection
+    SetFormatAndEncodings(this->vnc_client);
+}
+
+void screen::set_server_format(server_formats format)
+{
+    this->converter = pixel_converter{format, this->device};
+    this->setup_client();
+}
+
+auto screen::fall_back_server_format() -> bool
+{
+    if (this->received_update || !this->converter.is_identity())
+    {
+        return false;
+    }
+
+    // Keep the component order that the server prefers
+    const auto& native = this->vnc_client->si.format;
+    this->set_server_format(
+        native.bitsPerPixel == 32 && native.redShift == 0
+        ? server_formats::bgr32
+        : server_formats::rgb32
+    );
+    return true;
+}
+
+void screen::set_idle_timeout(chrono::milliseconds timeout)
+{
+    this->idle_timeout = timeout;
+    this->last_activity = this->time_source.now();
+}
+
+void screen::wake()
+{
+    this->last_activity = this->time_source.now();
+    this->send_deferred_request();
+}
+
+auto screen::request_update() -> bool
+{
+    chrono::milliseconds delay{0};
+
+    if (this->idle_timeout.count() > 0)
+    {
+        auto idle_time = chrono::duration_cast<chrono::milliseconds>(
+            this->time_source.now() - this->last_activity);
+
+        // Stretch the delay as the idle period goes on
+        delay = std::clamp(
+            idle_time - this->idle_timeout,
+            chrono::milliseconds{0},
+            idle_heartbeat
+        );
+    }
+
+    update_request_delay.set(chrono::duration<double>(delay).count());
+
+    if (delay.count() == 0)
+    {
+        update_requests_sent.add();
+        return SendIncrementalFramebufferUpdateRequest(this->vnc_client) != 0;
+    }
+
+    this->request_deferred = true;
+    this->request_due = this->time_source.now() + delay;
+    return true;
+}
+
+void screen::send_deferred_request()
+{
+    if (!this->request_deferred || this->vnc_client == nullptr)
+    {
+        return;
+    }
+
+    // A failed request shows up as a failed read on the connection
+    this->request_deferred = false;
+    update_requests_deferred.add();
+    SendIncrementalFramebufferUpdateRequest(this->vnc_client);
 }
 
 void screen::repaint()
@@ -71,23 +485,175 @@ void screen::repaint()
     if (this->repaint_mode == repaint_modes::standard)
     {
         this->update_info.has_update = false;
+        this->update_info.rects = 0;
+        pending_rects.set(0);
+        standard_repaints.add();
+    }
+    else
+    {
+        fast_repaints.add();
     }
 
-    this->last_repaint = chrono::steady_clock::now();
+    this->last_repaint = this->time_source.now();
 
-    log::print("Screen update")
-        << this->update_info.w << 'x' << this->update_info.h << '+'
-        << this->update_info.x << '+' << this->update_info.y << '\n';
+    auto waveform = this->repaint_mode == repaint_modes::standard
+        ? rmioc::waveform_modes::gl16
+        : rmioc::waveform_modes::du;
 
-    this->device.update(
+    this->paint(
         this->update_info.x, this->update_info.y,
         this->update_info.w, this->update_info.h,
-        this->repaint_mode == repaint_modes::standard
-            ? rmioc::waveform_modes::gl16
-            : rmioc::waveform_modes::du
+        waveform
     );
 }
 
+void screen::paint(
+    int x, int y, int w, int h,
+    rmioc::waveform_modes waveform
+)
+{
+    trace::span span{trace::stages::repaint};
+    span.set_rect(x, y, w, h);
+    span.set_waveform(static_cast<std::uint8_t>(waveform));
+
+    if (this->hud_overlay.has_value())
+    {
+        this->hud_overlay->on_repaint(x, y, w, h, waveform);
+    }
+
+    if (this->cursor_overlay.has_value())
+    {
+        this->cursor_overlay->on_repaint({x, y, w, h});
+    }
+
+    this->device.update(x, y, w, h, waveform);
+
+    if (this->tracking_completions)
+    {
+        ++this->repaints_in_flight;
+        repaints_in_flight_gauge.set(this->repaints_in_flight);
+    }
+}
+
+auto screen::track_completions() -> int
+{
+    int completion_fd = this->device.track_completions();
+    this->tracking_completions = completion_fd != -1;
+    return completion_fd;
+}
+
+auto screen::process_completions() -> event_loop_status
+{
+    for (const auto& completion : this->device.take_completions())
+    {
+        auto latency = completion.completed - completion.submitted;
+
+        if (completion.confirmed)
+        {
+            confirmed_completions.add();
+        }
+        else
+        {
+            timed_out_completions.add();
+        }
+
+        completion_latency_total.add(
+            chrono::duration_cast<chrono::microseconds>(latency).count());
+        completion_latency_last.set(
+            chrono::duration<double>(latency).count());
+
+        if (trace::is_enabled())
+        {
+            trace::record(trace::event{
+                chrono::duration_cast<chrono::nanoseconds>(
+                    completion.submitted.time_since_epoch()).count(),
+                chrono::duration_cast<chrono::nanoseconds>(latency).count(),
+                completion.x, completion.y, completion.w, completion.h,
+                /* bytes = */ 0,
+                /* extra = */ completion.confirmed ? 1U : 0U,
+                trace::stages::refresh,
+                static_cast<std::uint8_t>(completion.mode)
+            });
+        }
+
+        this->repaints_in_flight = std::max(this->repaints_in_flight - 1, 0);
+
+        if (!completion.confirmed && this->tracking_completions)
+        {
+            std::cerr << "Screen updates are not confirmed in time, "
+                "no longer following their completion\n";
+            this->tracking_completions = false;
+            this->repaints_in_flight = 0;
+        }
+    }
+
+    repaints_in_flight_gauge.set(this->repaints_in_flight);
+    return {/* quit = */ false, /* timeout = */ -1};
+}
+
+auto screen::get_repaints_in_flight() const -> int
+{
+    return this->repaints_in_flight;
+}
+
+void screen::repaint_resync()
+{
+    const auto& resync = this->resync_info;
+    const int xres = this->device.get_xres_memory();
+    const int yres = this->device.get_yres_memory();
+    std::size_t changed = 0;
+
+    for (int row = 0; row < resync.rows; ++row)
+    {
+        auto row_begin = resync.changed.begin()
+            + static_cast<std::ptrdiff_t>(row) * resync.columns;
+        int column = 0;
+
+        // Repaint each run of adjacent changed tiles in a single update
+        while (column < resync.columns)
+        {
+            if (!row_begin[column])
+            {
+                ++column;
+                continue;
+            }
+
+            int first = column;
+
+            while (column < resync.columns && row_begin[column])
+            {
+                ++column;
+            }
+
+            changed += column - first;
+
+            int x = first * resync_tile_size;
+            int y = row * resync_tile_size;
+            int w = std::min(column * resync_tile_size, xres) - x;
+            int h = std::min(y + resync_tile_size, yres) - y;
+
+            trace::instant(trace::stages::damage, x, y, w, h);
+
+            if (this->hud_overlay.has_value())
+            {
+                this->hud_overlay->on_damage();
+            }
+
+            if (this->on_damage)
+            {
+                this->on_damage(x, y, w, h);
+            }
+
+            standard_repaints.add();
+            this->paint(x, y, w, h, rmioc::waveform_modes::gl16);
+        }
+    }
+
+    resync_changed_tiles.add(changed);
+    resync_unchanged_tiles.add(resync.changed.size() - changed);
+    this->last_repaint = this->time_source.now();
+}
+
 auto screen::get_xres() -> int
 {
     return this->device.get_xres();
@@ -101,42 +667,542 @@ auto screen::get_yres() -> int
 void screen::set_repaint_mode(repaint_modes mode)
 {
     this->repaint_mode = mode;
+    trace::instant(
+        trace::stages::repaint_mode,
+        0, 0, 0, 0,
+        static_cast<std::uint32_t>(mode)
+    );
+}
+
+void screen::set_repaint_delay(
+    repaint_modes mode,
+    chrono::milliseconds delay
+)
+{
+    if (mode == repaint_modes::standard)
+    {
+        this->standard_delay = delay;
+    }
+    else
+    {
+        this->fast_delay = delay;
+    }
+}
+
+auto screen::get_repaint_delay(repaint_modes mode) const
+-> chrono::milliseconds
+{
+    return mode == repaint_modes::standard
+        ? this->standard_delay
+        : this->fast_delay;
+}
+
+void screen::enable_hud()
+{
+    this->hud_overlay.emplace(this->device, this->time_source);
+}
+
+void screen::enable_cursor()
+{
+    this->cursor_overlay.emplace(this->device);
+    this->setup_client();
+}
+
+void screen::move_cursor(int x, int y)
+{
+    if (!this->cursor_overlay.has_value())
+    {
+        return;
+    }
+
+    this->cursor_overlay->hide();
+    this->cursor_overlay->move(x, y);
+    this->cursor_overlay->show();
+}
+
+void screen::set_damage_callback(damage_callback callback)
+{
+    this->on_damage = std::move(callback);
+}
+
+auto screen::event_loop() -> event_loop_status
+{
+    event_loop_status status{/* quit = */ false, /* timeout = */ -1};
+
+    if (this->hud_overlay.has_value())
+    {
+        status = this->hud_overlay->event_loop();
+    }
+
+    if (this->update_info.has_update)
+    {
+        auto next_update_time = this->last_repaint + (
+            this->repaint_mode == repaint_modes::standard
+            ? this->standard_delay
+            : this->fast_delay
+        );
+
+        auto now = this->time_source.now();
+        long wait_time = chrono::duration_cast<chrono::milliseconds>(
+            next_update_time - now
+        ).count();
+
+        if (wait_time <= 0)
+        {
+            this->repaint();
+        }
+        else if (status.timeout == -1 || wait_time < status.timeout)
+        {
+            // Wait until the next update is due
+            status.timeout = wait_time;
+        }
+    }
+
+    if (this->cursor_overlay.has_value()
+            && this->cursor_overlay->has_damage())
+    {
+        auto next_cursor_time = this->last_cursor_repaint + this->fast_delay;
+        auto now = this->time_source.now();
+        long wait_time = chrono::duration_cast<chrono::milliseconds>(
+            next_cursor_time - now
+        ).count();
+
+        if (wait_time <= 0)
+        {
+            // Only repaint the previous and current cursor locations
+            this->last_cursor_repaint = now;
+
+            for (const auto& area : this->cursor_overlay->take_damage())
+            {
+                fast_repaints.add();
+                this->paint(
+                    area.x, area.y, area.w, area.h,
+                    rmioc::waveform_modes::du
+                );
+            }
+        }
+        else if (status.timeout == -1 || wait_time < status.timeout)
+        {
+            status.timeout = wait_time;
+        }
+    }
+
+    if (this->request_deferred)
+    {
+        auto now = this->time_source.now();
+
+        if (now >= this->request_due)
+        {
+            this->send_deferred_request();
+        }
+        else
+        {
+            long wait_time = chrono::ceil<chrono::milliseconds>(
+                this->request_due - now).count();
+
+            if (status.timeout == -1 || wait_time < status.timeout)
+            {
+                status.timeout = wait_time;
+            }
+        }
+    }
+
+    // Retry submitting updates the device could not accept yet
+    long retry_time = this->device.flush_updates();
+
+    if (retry_time != -1
+        && (status.timeout == -1 || retry_time < status.timeout))
+    {
+        status.timeout = retry_time;
+    }
+
+    return status;
+}
+
+auto screen::handle_message() -> bool
+{
+    if (!this->cursor_overlay.has_value())
+    {
+        return this->receive_message();
+    }
+
+    // Keep the cursor out of the framebuffer while the server writes to it
+    this->cursor_overlay->hide();
+    bool result = this->receive_message();
+    this->cursor_overlay->show();
+    return result;
+}
+
+auto screen::receive_message() -> bool
+{
+    rfbClient* client = this->vnc_client;
+
+    // Parse updates only when the library holds no data read in advance
+    // and the socket carries the protocol in the clear
+    if (client->buffered > 0 || !is_plain_socket(client))
+    {
+        // Servers send bitmaps with the first requested encoding they know
+        this->library_bytes = this->encodings.has_value()
+                && this->encodings->get_mode() == encoding_modes::tight
+            ? &tight_bytes_received
+            : &raw_bytes_received;
+
+        // Frames are measured when the library reports their end
+        do
+        {
+            this->library_frame_start = this->time_source.now();
+            this->frame_pixels = 0;
+
+            if (HandleRFBServerMessage(client) == 0)
+            {
+                this->library_frame_start.reset();
+                return false;
+            }
+        }
+        while (client->buffered > 0);
+
+        this->library_frame_start.reset();
+        return true;
+    }
+
+    rfbFramebufferUpdateMsg message{};
+    iovec vector{&message.type, 1};
+
+    if (!this->receive(&vector, 1))
+    {
+        return false;
+    }
+
+    if (message.type != rfbFramebufferUpdate)
+    {
+        return this->hand_over(&message.type, 1);
+    }
+
+    auto frame_start = this->time_source.now();
+    this->frame_pixels = 0;
+    vector = {&message.pad, sz_rfbFramebufferUpdateMsg - 1};
+
+    if (!this->receive(&vector, 1))
+    {
+        return false;
+    }
+
+    int rects = rfbClientSwap16IfLE(message.nRects);
+    rfbFramebufferUpdateRectHeader rect{};
+    bool has_header = false;
+
+    for (int i = 0; i < rects; ++i)
+    {
+        if (!has_header)
+        {
+            vector = {&rect, sz_rfbFramebufferUpdateRectHeader};
+
+            if (!this->receive(&vector, 1))
+            {
+                return false;
+            }
+        }
+
+        has_header = false;
+        std::uint32_t encoding = rfbClientSwap32IfLE(rect.encoding);
+
+        if (encoding == rfbEncodingLastRect)
+        {
+            break;
+        }
+
+        if (encoding != rfbEncodingRaw && encoding != rfbEncodingCopyRect)
+        {
+            // Let the library process this rectangle and the following ones
+            // as if they were a whole update
+            std::array<std::uint8_t,
+                sz_rfbFramebufferUpdateMsg + sz_rfbFramebufferUpdateRectHeader
+            > rest{};
+            message.nRects = rfbClientSwap16IfLE(
+                static_cast<std::uint16_t>(rects - i));
+            std::memcpy(rest.data(), &message, sz_rfbFramebufferUpdateMsg);
+            std::memcpy(
+                rest.data() + sz_rfbFramebufferUpdateMsg,
+                &rect, sz_rfbFramebufferUpdateRectHeader
+            );
+            this->library_bytes = encoding == rfbEncodingTight
+                ? &tight_bytes_received
+                : &raw_bytes_received;
+
+            if (!this->hand_over(rest.data(), rest.size()))
+            {
+                return false;
+            }
+
+            this->finish_frame(frame_start);
+            return true;
+        }
+
+        int x = rfbClientSwap16IfLE(rect.r.x);
+        int y = rfbClientSwap16IfLE(rect.r.y);
+        int w = rfbClientSwap16IfLE(rect.r.w);
+        int h = rfbClientSwap16IfLE(rect.r.h);
+
+        if (x + w > client->width || y + h > client->height)
+        {
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg,hicpp-vararg)
+            rfbClientLog("Rect too large: %dx%d at (%d, %d)\n", w, h, x, y);
+            return false;
+        }
+
+        if (encoding == rfbEncodingRaw)
+        {
+            if (w == 0 || h == 0)
+            {
+                continue;
+            }
+
+            // Read the next rectangle header along with the pixels
+            bool has_next = i + 1 < rects;
+
+            if (!this->receive_raw(
+                    x, y, w, h,
+                    has_next ? &rect : nullptr,
+                    has_next ? sz_rfbFramebufferUpdateRectHeader : 0))
+            {
+                return false;
+            }
+
+            has_header = has_next;
+        }
+        else
+        {
+            rfbCopyRect source{};
+            vector = {&source, sz_rfbCopyRect};
+
+            if (!this->receive(&vector, 1))
+            {
+                return false;
+            }
+
+            client->GotCopyRect(
+                client,
+                rfbClientSwap16IfLE(source.srcX),
+                rfbClientSwap16IfLE(source.srcY),
+                w, h, x, y
+            );
+        }
+
+        client->GotFrameBufferUpdate(client, x, y, w, h);
+    }
+
+    this->finish_frame(frame_start);
+
+    if (!this->request_update())
+    {
+        return false;
+    }
+
+    if (client->FinishedFrameBufferUpdate != nullptr)
+    {
+        client->FinishedFrameBufferUpdate(client);
+    }
+
+    return true;
+}
+
+auto screen::receive(iovec* vectors, std::size_t count) -> bool
+{
+    const int timeout = this->vnc_client->readTimeout > 0
+        ? this->vnc_client->readTimeout * 1000
+        : -1;
+
+    while (count > 0)
+    {
+        ssize_t result = readv(
+            this->vnc_client->sock, vectors,
+            static_cast<int>(std::min<std::size_t>(count, IOV_MAX))
+        );
+
+        if (result == -1)
+        {
+            if (errno == EINTR)
+            {
+                if (is_quit_requested())
+                {
+                    return false;
+                }
+
+                continue;
+            }
+
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                pollfd readable{this->vnc_client->sock, POLLIN, 0};
+                int ready = poll(&readable, 1, timeout);
+
+                if (ready == 0)
+                {
+                    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg,hicpp-vararg)
+                    rfbClientErr("Timeout while reading from the server\n");
+                    return false;
+                }
+
+                if (ready == -1 && errno != EINTR)
+                {
+                    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg,hicpp-vararg)
+                    rfbClientErr("poll: %s\n", std::strerror(errno));
+                    return false;
+                }
+
+                if (ready == -1 && is_quit_requested())
+                {
+                    return false;
+                }
+
+                continue;
+            }
+
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg,hicpp-vararg)
+            rfbClientErr("read: %s\n", std::strerror(errno));
+            return false;
+        }
+
+        if (result == 0)
+        {
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg,hicpp-vararg)
+            rfbClientLog("VNC server closed connection\n");
+            return false;
+        }
+
+        // Skip filled buffers and move the start of the partially filled one
+        auto done = static_cast<std::size_t>(result);
+
+        while (count > 0 && done >= vectors->iov_len)
+        {
+            done -= vectors->iov_len;
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+            ++vectors;
+            --count;
+        }
+
+        if (count > 0)
+        {
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+            vectors->iov_base = static_cast<char*>(vectors->iov_base) + done;
+            vectors->iov_len -= done;
+        }
+    }
 
-    log::print("Screen update") << (mode == repaint_modes::standard
-        ? "Switched to standard mode\n"
-        : "Switched to fast mode\n");
+    return true;
 }
 
-auto screen::event_loop() -> event_loop_status
+auto screen::receive_raw(
+    int x, int y, int w, int h,
+    void* trailer, std::size_t trailer_size
+) -> bool
 {
-    if (this->update_info.has_update)
+    std::size_t pixel_size
+        = this->vnc_client->format.bitsPerPixel / CHAR_BIT;
+    std::size_t row_size = w * pixel_size;
+    auto& vectors = this->receive_vectors;
+
+    if (this->resync_info.pending
+        || !this->converter.is_identity()
+        || row_size * h < direct_receive_min_bytes)
     {
-        auto next_update_time = this->last_repaint + (
-            this->repaint_mode == repaint_modes::standard
-            ? standard_repaint_delay
-            : fast_repaint_delay
-        );
+        // Receive through memory so that rows can be compared with the
+        // screen contents or converted
+        this->receive_buffer.resize(std::max(row_size, receive_chunk_bytes));
+        int chunk_rows = static_cast<int>(
+            this->receive_buffer.size() / row_size);
 
-        auto now = chrono::steady_clock::now();
-        long wait_time = chrono::duration_cast<chrono::milliseconds>(
-            next_update_time - now
-        ).count();
+        for (int line = 0; line < h; line += chunk_rows)
+        {
+            int rows = std::min(chunk_rows, h - line);
+            vectors.clear();
+            vectors.push_back({this->receive_buffer.data(), rows * row_size});
 
-        if (wait_time <= 0)
+            if (line + rows == h && trailer != nullptr)
+            {
+                vectors.push_back({trailer, trailer_size});
+            }
+
+            if (!this->receive(vectors.data(), vectors.size()))
+            {
+                return false;
+            }
+
+            this->store_rect(
+                this->receive_buffer.data(), x, y + line, w, rows,
+                raw_bytes_received
+            );
+        }
+
+        return true;
+    }
+
+    trace::span span{trace::stages::decode};
+    span.set_rect(x, y, w, h);
+    span.set_bytes(row_size * h);
+    this->count_received(raw_bytes_received, row_size * h);
+
+    // Read each row straight into its destination, discarding the parts
+    // that are not stored
+    this->discard_buffer.resize(row_size);
+    vectors.clear();
+
+    for (int line = 0; line < h; ++line)
+    {
+        std::size_t available = 0;
+        uint8_t* dest_line = this->locate(x, y + line, available);
+        std::size_t stored = 0;
+
+        if (dest_line != nullptr)
         {
-            this->repaint();
+            stored = std::min(available, row_size);
+            vectors.push_back({dest_line, stored});
         }
-        else
+
+        if (stored < row_size)
         {
-            // Wait until the next update is due
-            return {
-                /* quit = */ false,
-                /* timeout = */ wait_time
-            };
+            vectors.push_back({
+                this->discard_buffer.data(),
+                row_size - stored
+            });
         }
     }
 
-    return {/* quit = */ false, /* timeout = */ -1};
+    if (trailer != nullptr)
+    {
+        vectors.push_back({trailer, trailer_size});
+    }
+
+    return this->receive(vectors.data(), vectors.size());
+}
+
+auto screen::hand_over(const void* data, std::size_t size) -> bool
+{
+    // The library reads its buffer first, which is empty at this point
+    std::memcpy(this->vnc_client->buf, data, size);
+    this->vnc_client->bufoutptr = this->vnc_client->buf;
+    this->vnc_client->buffered = size;
+
+    do
+    {
+        if (HandleRFBServerMessage(this->vnc_client) == 0)
+        {
+            return false;
+        }
+    }
+    while (this->vnc_client->buffered > 0);
+
+    return true;
+}
+
+void screen::count_received(stats::counter& bytes, std::size_t size)
+{
+    bytes.add(size);
+
+    if (this->hud_overlay.has_value())
+    {
+        this->hud_overlay->on_received(size);
+    }
 }
 
 auto screen::create_framebuf(rfbClient* vnc_client) -> rfbBool
@@ -159,6 +1225,43 @@ auto screen::create_framebuf(rfbClient* vnc_client) -> rfbBool
         throw std::runtime_error{msg.str()};
     }
 
+    // Forget the off-screen rows of any previous connection
+    that->cache_info = {};
+    that->configure_encodings();
+
+    if (vnc_client->width <= xres && vnc_client->height > yres)
+    {
+        // Servers using client-side caching, like x11vnc with -ncache,
+        // stack cache areas the size of the screen below it
+        int areas = (vnc_client->height + yres - 1) / yres;
+        int visible = vnc_client->height / areas;
+
+        if (areas >= min_cache_areas
+                && vnc_client->height % areas == 0
+                && xres - vnc_client->width <= xres / cache_size_margin
+                && yres - visible <= yres / cache_size_margin)
+        {
+            std::size_t pixel_size
+                = that->device.get_bits_per_pixel() / CHAR_BIT;
+
+            that->cache_info.top = visible;
+            that->cache_info.width = vnc_client->width;
+            that->cache_info.height
+                = vnc_client->height - that->cache_info.top;
+            that->cache_info.data.assign(
+                static_cast<std::size_t>(that->cache_info.width)
+                    * that->cache_info.height * pixel_size,
+                0
+            );
+
+            that->configure_encodings();
+
+            std::cerr << "Keeping " << areas - 1
+                << " cache areas of the server below the screen\n";
+            return TRUE;
+        }
+    }
+
     if (vnc_client->width > xres || vnc_client->height > yres)
     {
         std::cerr << "Warning: The server resolution ("
@@ -182,41 +1285,296 @@ void screen::recv_update(
             screen::instance_tag
         ));
 
-    if (x < 0 || y < 0
-        || x >= that->device.get_xres_memory()
-        || y >= that->device.get_yres_memory())
+    that->store_rect(buffer, x, y, w, h, *that->library_bytes);
+}
+
+void screen::store_rect(
+    const uint8_t* buffer, int x, int y, int w, int h,
+    stats::counter& bytes
+)
+{
+    std::size_t available = 0;
+
+    if (x < 0 || y < 0 || this->locate(x, y, available) == nullptr)
     {
         return;
     }
 
-    std::size_t pixel_size = that->device.get_bits_per_pixel() / CHAR_BIT;
-
-    std::size_t dest_stride = that->device.get_xres_memory() * pixel_size;
-    std::size_t dest_size = dest_stride * that->device.get_yres_memory();
-    uint8_t* const dest = that->device.get_data();
+    const auto& converter = this->converter;
+    std::size_t source_size = converter.get_source_size();
 
-    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
-    uint8_t* dest_line = dest + y * dest_stride + x * pixel_size;
+    trace::span span{trace::stages::decode};
+    span.set_rect(x, y, w, h);
+    span.set_bytes(w * h * source_size);
+    this->count_received(bytes, w * h * source_size);
 
-    std::size_t buffer_stride = w * pixel_size;
-    std::size_t buffer_size = buffer_stride * h;
+    std::size_t buffer_stride = w * source_size;
     const uint8_t* buffer_line = buffer;
 
-    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
-    while (dest_line < dest + dest_size && buffer_line < buffer + buffer_size)
+    if (!converter.is_identity())
+    {
+        this->row_buffer.resize(
+            w * this->device.get_bits_per_pixel() / CHAR_BIT);
+    }
+
+    for (int line = 0; line < h; ++line)
+    {
+        const uint8_t* pixels = buffer_line;
+
+        if (!converter.is_identity())
+        {
+            converter.convert(buffer_line, this->row_buffer.data(), w);
+            pixels = this->row_buffer.data();
+        }
+
+        if (!this->store_row(x, y + line, pixels, w))
+        {
+            break;
+        }
+
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        buffer_line += buffer_stride;
+    }
+}
+
+void screen::copy_rect(
+    rfbClient* vnc_client,
+    int src_x, int src_y, int w, int h,
+    int dest_x, int dest_y
+)
+{
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    auto* that = reinterpret_cast<screen*>(
+        rfbClientGetClientData(
+            vnc_client,
+            screen::instance_tag
+        ));
+
+    if (src_x < 0 || src_y < 0 || dest_x < 0 || dest_y < 0 || w <= 0)
     {
-        std::memcpy(
-            dest_line,
-            buffer_line,
-            std::min(dest_stride - x * pixel_size, buffer_stride)
+        return;
+    }
+
+    trace::span span{trace::stages::decode};
+    span.set_rect(dest_x, dest_y, w, h);
+
+    std::size_t pixel_size = that->device.get_bits_per_pixel() / CHAR_BIT;
+    that->row_buffer.resize(w * pixel_size);
+
+    for (int i = 0; i < h; ++i)
+    {
+        // When moving down, start from the bottom so that source rows are
+        // read before being overwritten
+        int line = dest_y > src_y ? h - 1 - i : i;
+        std::size_t available = 0;
+        const uint8_t* source = that->locate(src_x, src_y + line, available);
+
+        if (source == nullptr)
+        {
+            continue;
+        }
+
+        std::size_t size = std::min(available, that->row_buffer.size());
+        std::memcpy(that->row_buffer.data(), source, size);
+        that->store_row(
+            dest_x, dest_y + line,
+            that->row_buffer.data(),
+            static_cast<int>(size / pixel_size)
         );
+    }
+}
+
+void screen::fill_rect(
+    rfbClient* vnc_client,
+    int x, int y, int w, int h,
+    uint32_t colour
+)
+{
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    auto* that = reinterpret_cast<screen*>(
+        rfbClientGetClientData(
+            vnc_client,
+            screen::instance_tag
+        ));
+
+    if (x < 0 || y < 0 || w <= 0)
+    {
+        return;
+    }
+
+    colour = that->converter.convert(colour);
+    std::size_t pixel_size = that->device.get_bits_per_pixel() / CHAR_BIT;
+    that->row_buffer.resize(w * pixel_size);
+
+    // Pixels use the native byte order, as requested from the server
+    for (std::size_t offset = 0; offset < that->row_buffer.size();
+            offset += pixel_size)
+    {
+        std::memcpy(that->row_buffer.data() + offset, &colour, pixel_size);
+    }
+
+    for (int line = 0; line < h; ++line)
+    {
+        if (!that->store_row(x, y + line, that->row_buffer.data(), w))
+        {
+            break;
+        }
+    }
+}
+
+#ifdef VNSEE_JPEG
+auto screen::recv_jpeg(
+    rfbClient* vnc_client,
+    const uint8_t* buffer,
+    int length,
+    int x, int y, int w, int h
+) -> rfbBool
+{
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    auto* that = reinterpret_cast<screen*>(
+        rfbClientGetClientData(
+            vnc_client,
+            screen::instance_tag
+        ));
+
+    trace::span span{trace::stages::decode};
+    span.set_rect(x, y, w, h);
+    span.set_bytes(length);
+    that->count_received(jpeg_bytes_received, length);
+
+    if (!that->jpeg.decode(buffer, length, w, h, that->luma_buffer))
+    {
+        return FALSE;
+    }
+
+    std::size_t available = 0;
+
+    if (x < 0 || y < 0 || that->locate(x, y, available) == nullptr)
+    {
+        return TRUE;
+    }
+
+    that->row_buffer.resize(
+        w * that->device.get_bits_per_pixel() / CHAR_BIT);
+    const uint8_t* luma_line = that->luma_buffer.data();
+
+    for (int line = 0; line < h; ++line)
+    {
+        that->converter.convert_luma(luma_line, that->row_buffer.data(), w);
+
+        if (!that->store_row(x, y + line, that->row_buffer.data(), w))
+        {
+            break;
+        }
 
         // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
-        dest_line += dest_stride;
+        luma_line += w;
+    }
+
+    return TRUE;
+}
+#endif
 
+auto screen::locate(int x, int y, std::size_t& available) -> uint8_t*
+{
+    std::size_t pixel_size = this->device.get_bits_per_pixel() / CHAR_BIT;
+    uint8_t* row = nullptr;
+    int row_width = 0;
+
+    if (y >= this->cache_info.top)
+    {
+        if (y - this->cache_info.top >= this->cache_info.height)
+        {
+            return nullptr;
+        }
+
+        row_width = this->cache_info.width;
         // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
-        buffer_line += buffer_stride;
+        row = this->cache_info.data.data()
+            + static_cast<std::size_t>(y - this->cache_info.top)
+                * row_width * pixel_size;
+    }
+    else
+    {
+        if (y >= this->device.get_yres_memory())
+        {
+            return nullptr;
+        }
+
+        row_width = this->device.get_xres_memory();
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        row = this->device.get_data()
+            + static_cast<std::size_t>(y) * row_width * pixel_size;
+    }
+
+    if (x >= row_width)
+    {
+        return nullptr;
+    }
+
+    available = (row_width - x) * pixel_size;
+
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    return row + x * pixel_size;
+}
+
+auto screen::store_row(int x, int y, const uint8_t* pixels, int w) -> bool
+{
+    std::size_t available = 0;
+    uint8_t* dest_line = this->locate(x, y, available);
+
+    if (dest_line == nullptr)
+    {
+        return false;
+    }
+
+    std::size_t pixel_size = this->device.get_bits_per_pixel() / CHAR_BIT;
+    std::size_t line_size = std::min(available, w * pixel_size);
+
+    if (y >= this->cache_info.top)
+    {
+        // Off-screen rows are never painted
+        std::memcpy(dest_line, pixels, line_size);
+        return true;
+    }
+
+    auto& resync = this->resync_info;
+
+    if (resync.pending)
+    {
+        // Compare the line separately in each tile that it crosses
+        auto tile_row = static_cast<std::size_t>(y / resync_tile_size)
+            * resync.columns;
+        std::size_t offset = 0;
+
+        while (offset < line_size)
+        {
+            int column = (x + static_cast<int>(offset / pixel_size))
+                / resync_tile_size;
+            std::size_t next = std::min<std::size_t>(
+                line_size,
+                ((column + 1) * resync_tile_size - x) * pixel_size
+            );
+
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+            if (std::memcmp(dest_line + offset, pixels + offset,
+                        next - offset) != 0)
+            {
+                // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+                std::memcpy(dest_line + offset, pixels + offset,
+                        next - offset);
+                resync.changed[tile_row + column] = true;
+            }
+
+            offset = next;
+        }
+    }
+    else
+    {
+        std::memcpy(dest_line, pixels, line_size);
     }
+
+    return true;
 }
 
 void screen::commit_updates(rfbClient* vnc_client, int x, int y, int w, int h)
@@ -230,7 +1588,38 @@ void screen::commit_updates(rfbClient* vnc_client, int x, int y, int w, int h)
 
     // Register the region as pending update, potentially extending
     // an existing one
-    log::print("VNC update") << w << 'x' << h << '+' << x << '+' << y << '\n';
+    rects_decoded.add();
+    pixels_decoded.add(static_cast<std::uint64_t>(w) * h);
+    that->frame_pixels += static_cast<std::size_t>(w) * h;
+
+    if (that->resync_info.pending)
+    {
+        // Changes are repainted tile by tile once the update is complete
+        return;
+    }
+
+    if (y >= that->cache_info.top)
+    {
+        // Only the off-screen part of the framebuffer was updated
+        return;
+    }
+
+    h = std::min(h, that->cache_info.top - y);
+
+    that->last_activity = that->time_source.now();
+    ++that->update_info.rects;
+    pending_rects.set(that->update_info.rects);
+    trace::instant(trace::stages::damage, x, y, w, h);
+
+    if (that->hud_overlay.has_value())
+    {
+        that->hud_overlay->on_damage();
+    }
+
+    if (that->on_damage)
+    {
+        that->on_damage(x, y, w, h);
+    }
 
     if (that->update_info.has_update)
     {
@@ -257,4 +1646,75 @@ void screen::commit_updates(rfbClient* vnc_client, int x, int y, int w, int h)
     }
 }
 
+void screen::set_cursor_shape(
+    rfbClient* vnc_client,
+    int hot_x, int hot_y, int w, int h,
+    int bytes_per_pixel
+)
+{
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    auto* that = reinterpret_cast<screen*>(
+        rfbClientGetClientData(
+            vnc_client,
+            screen::instance_tag
+        ));
+
+    const auto& converter = that->converter;
+
+    if (w < 0 || h < 0
+            || static_cast<std::size_t>(bytes_per_pixel)
+                != converter.get_source_size())
+    {
+        return;
+    }
+
+    auto count = static_cast<std::size_t>(w) * h;
+    std::vector<uint8_t> pixels(
+        count * that->device.get_bits_per_pixel() / CHAR_BIT);
+    converter.convert(vnc_client->rcSource, pixels.data(), count);
+
+    that->cursor_overlay->set_shape(
+        hot_x, hot_y, w, h,
+        pixels.data(), vnc_client->rcMask
+    );
+}
+
+auto screen::set_cursor_position(rfbClient* vnc_client, int x, int y)
+-> rfbBool
+{
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    auto* that = reinterpret_cast<screen*>(
+        rfbClientGetClientData(
+            vnc_client,
+            screen::instance_tag
+        ));
+
+    that->cursor_overlay->move(x, y);
+    return TRUE;
+}
+
+void screen::finish_updates(rfbClient* vnc_client)
+{
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    auto* that = reinterpret_cast<screen*>(
+        rfbClientGetClientData(
+            vnc_client,
+            screen::instance_tag
+        ));
+
+    that->received_update = true;
+
+    if (that->library_frame_start.has_value())
+    {
+        that->finish_frame(*that->library_frame_start);
+        that->library_frame_start.reset();
+    }
+
+    if (that->resync_info.pending)
+    {
+        that->resync_info.pending = false;
+        that->repaint_resync();
+    }
+}
+
 } // namespace app
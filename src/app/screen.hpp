@@ -1,30 +1,142 @@
 #ifndef APP_SCREEN_HPP
 #define APP_SCREEN_HPP
 
+#include "clock.hpp"
+#include "cursor.hpp"
+#include "encoding_policy.hpp"
 #include "event_loop.hpp"
+#include "hud.hpp"
+#include "pixel_format.hpp"
+#ifdef VNSEE_JPEG
+#include "jpeg_decoder.hpp"
+#endif
 #include <chrono>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
 #include <iosfwd>
+#include <optional>
+#include <vector>
 #include <rfb/rfbclient.h>
 #include <rfb/rfbproto.h>
+#include <sys/uio.h>
 
 namespace rmioc
 {
     class screen;
 }
 
+namespace stats
+{
+    class counter;
+}
+
 namespace app
 {
 
 class screen
 {
 public:
+    /**
+     * Create a screen handler.
+     *
+     * @param device Screen to repaint.
+     * @param vnc_client VNC connection to receive updates from.
+     * @param time_source Clock used for scheduling repaints.
+     */
     screen(
         rmioc::screen& device,
-        rfbClient* vnc_client
+        rfbClient* vnc_client,
+        const clock& time_source = clock::system()
     );
 
     event_loop_status event_loop();
 
+    /**
+     * Receive and process a message from the server.
+     *
+     * Framebuffer updates are parsed here when possible, so that large raw
+     * rectangles are read from the socket straight into screen memory.
+     * Other messages and rectangles using other encodings are handed over
+     * to the VNC library.
+     *
+     * @return False if the connection failed, like `HandleRFBServerMessage`.
+     */
+    bool handle_message();
+
+    /**
+     * Receive updates from a new VNC connection, for example after the
+     * previous one was lost.
+     *
+     * The current screen contents are kept. The first complete update
+     * received from the new connection is compared with them tile by tile,
+     * and only the tiles that differ are repainted.
+     *
+     * The connection may be initialized in the background, as long as
+     * the event loop does not use the screen handler for receiving updates
+     * meanwhile: only the framebuffer allocation callback is called.
+     *
+     * @param vnc_client New VNC connection, not initialized yet.
+     */
+    void reattach(rfbClient* vnc_client);
+
+    /**
+     * Stop using the current VNC connection, which is about to be released.
+     *
+     * The screen contents are kept until `reattach()` is called.
+     */
+    void detach();
+
+    /**
+     * Change the pixel format requested from the server.
+     *
+     * Takes effect on the next connection.
+     *
+     * @param format New pixel format.
+     */
+    void set_server_format(server_formats format);
+
+    /**
+     * Switch to 32-bit pixels if the server has not sent any update in the
+     * screen format, for servers that close the connection when asked
+     * for a format they do not support.
+     *
+     * @return True if the format changed and connecting again may succeed.
+     */
+    bool fall_back_server_format();
+
+    /**
+     * Request updates from the server less often after a period without
+     * activity, to save power on idle screens.
+     *
+     * Once idle, the delay before requesting the next update grows with
+     * the idle time, up to a heartbeat of a few seconds. Input events and
+     * changed regions end the idle period (see `wake()`).
+     *
+     * Updates that the VNC library decodes by itself are followed by a
+     * request that it sends right away, so that this has no effect while
+     * the Tight encoding is used (see `set_latency_target()`).
+     *
+     * @param timeout Time without activity after which to slow down, or
+     * 0 to always request updates right away.
+     */
+    void set_idle_timeout(std::chrono::milliseconds timeout);
+
+    /**
+     * Switch encodings depending on the measured link speed so that a
+     * whole screen can be received within a target time (see
+     * `app::encoding_policy`).
+     *
+     * @param target Longest time to receive a whole screen.
+     */
+    void set_latency_target(std::chrono::milliseconds target);
+
+    /**
+     * Register user activity, going back to requesting updates right away
+     * and sending any deferred request.
+     */
+    void wake();
+
     /**
      * Force flushing any pending updates to the screen.
      */
@@ -64,6 +176,67 @@ public:
 
     void set_repaint_mode(repaint_modes mode);
 
+    /**
+     * Change the minimal time between two repaints in a given mode.
+     *
+     * @param mode Repaint mode to configure.
+     * @param delay New delay for this mode.
+     */
+    void set_repaint_delay(
+        repaint_modes mode,
+        std::chrono::milliseconds delay
+    );
+
+    /** Get the minimal time between two repaints in a given mode. */
+    std::chrono::milliseconds get_repaint_delay(repaint_modes mode) const;
+
+    /**
+     * Start following the completion of repaints on the device.
+     *
+     * @return File descriptor to watch for completions (see
+     * `process_completions()`), or -1 if the device cannot report them.
+     */
+    int track_completions();
+
+    /** Account for repaints that the device reported complete. */
+    event_loop_status process_completions();
+
+    /**
+     * Get the number of repaints sent to the device that are not complete
+     * yet, or zero if completions are not tracked.
+     */
+    int get_repaints_in_flight() const;
+
+    /**
+     * Show the debugging overlay (see `app::hud`).
+     */
+    void enable_hud();
+
+    /**
+     * Draw the mouse cursor on the client side (see `app::cursor`).
+     *
+     * The server is asked to send the cursor shape and position instead
+     * of drawing the cursor in its framebuffer. Takes effect on the next
+     * connection.
+     */
+    void enable_cursor();
+
+    /**
+     * Move the cursor drawn on the client side, if enabled, to follow a
+     * pointer event sent to the server.
+     *
+     * @param x Column of the pointer on the screen.
+     * @param y Row of the pointer on the screen.
+     */
+    void move_cursor(int x, int y);
+
+    /**
+     * Set a function to call for each region that must be repainted.
+     *
+     * Regions that the server resent without changes are not reported.
+     */
+    void set_damage_callback(damage_callback callback);
+
 private:
     /** reMarkable screen device. */
     rmioc::screen& device;
@@ -71,6 +244,55 @@ private:
     /** VNC connection. */
     rfbClient* vnc_client;
 
+    /** Clock used for scheduling repaints. */
+    const clock& time_source;
+
+    /** Conversion from the server pixel format to the screen format. */
+    pixel_converter converter;
+
+    /** Whether a complete update was received from the server. */
+    bool received_update = false;
+
+    /** Choice of encodings depending on the link speed, if enabled. */
+    std::optional<encoding_policy> encodings;
+
+    /** Number of pixels received in the current frame. */
+    std::size_t frame_pixels = 0;
+
+    /**
+     * Time at which the VNC library started processing a message, if the
+     * library is processing a whole message on its own.
+     */
+    std::optional<clock::time_point> library_frame_start;
+
+    /** Register the update callbacks and pixel format on the connection. */
+    void setup_client();
+
+    /** Set the encodings to request on the connection. */
+    void configure_encodings();
+
+    /**
+     * Measure a received frame and change the requested encodings if
+     * needed.
+     *
+     * @param start Time at which the frame started arriving.
+     */
+    void finish_frame(clock::time_point start);
+
+    /**
+     * Send a region of the screen to the device.
+     *
+     * @param x Left bound of the region (in pixels).
+     * @param y Top bound of the region (in pixels).
+     * @param w Width of the region (in pixels).
+     * @param h Height of the region (in pixels).
+     * @param waveform Waveform mode to use.
+     */
+    void paint(int x, int y, int w, int h, rmioc::waveform_modes waveform);
+
+    /** Repaint the tiles changed by the resynchronization update. */
+    void repaint_resync();
+
     /**
      * Called by the VNC client library to initialize our local framebuffer.
      *
@@ -95,6 +317,194 @@ private:
         int x, int y, int w, int h
     );
 
+    /**
+     * Called by the VNC client library when the server asks to copy a
+     * region of the framebuffer to another location.
+     *
+     * @param client Handle to the VNC client.
+     * @param src_x Left bound of the source rectangle (in pixels).
+     * @param src_y Top bound of the source rectangle (in pixels).
+     * @param w Width of the copied rectangle (in pixels).
+     * @param h Height of the copied rectangle (in pixels).
+     * @param dest_x Left bound of the destination rectangle (in pixels).
+     * @param dest_y Top bound of the destination rectangle (in pixels).
+     */
+    static void copy_rect(
+        rfbClient* client,
+        int src_x, int src_y, int w, int h,
+        int dest_x, int dest_y
+    );
+
+    /**
+     * Called by the VNC client library when a rectangle of a single color
+     * is received from the server.
+     *
+     * @param client Handle to the VNC client.
+     * @param x Left bound of the filled rectangle (in pixels).
+     * @param y Top bound of the filled rectangle (in pixels).
+     * @param w Width of the filled rectangle (in pixels).
+     * @param h Height of the filled rectangle (in pixels).
+     * @param colour Pixel value to fill the rectangle with.
+     */
+    static void fill_rect(
+        rfbClient* client,
+        int x, int y, int w, int h,
+        uint32_t colour
+    );
+
+#ifdef VNSEE_JPEG
+    /**
+     * Called by the VNC client library when a JPEG rectangle of the Tight
+     * encoding is received from the server.
+     *
+     * @param client Handle to the VNC client.
+     * @param buffer Compressed image.
+     * @param length Size of the compressed image (in bytes).
+     * @param x Left bound of the updated rectangle (in pixels).
+     * @param y Top bound of the updated rectangle (in pixels).
+     * @param w Width of the updated rectangle (in pixels).
+     * @param h Height of the updated rectangle (in pixels).
+     * @return False if the image cannot be decoded.
+     */
+    static rfbBool recv_jpeg(
+        rfbClient* client,
+        const uint8_t* buffer,
+        int length,
+        int x, int y, int w, int h
+    );
+#endif
+
+    /**
+     * Find a pixel of the server framebuffer in memory.
+     *
+     * @param x Column of the pixel.
+     * @param y Row of the pixel.
+     * @param[out] available Number of bytes from the pixel to the end of
+     * its row.
+     * @return Pointer to the pixel, or null if it is not stored.
+     */
+    uint8_t* locate(int x, int y, std::size_t& available);
+
+    /**
+     * Write pixels to a row of the server framebuffer, registering changes
+     * to the visible part of the screen.
+     *
+     * @param x Column of the first pixel to write.
+     * @param y Row to write to.
+     * @param pixels Pixel data to write.
+     * @param w Number of pixels to write.
+     * @return False if the row is not stored.
+     */
+    bool store_row(int x, int y, const uint8_t* pixels, int w);
+
+    /**
+     * Receive and process a message from the server while the cursor is
+     * hidden (see `handle_message()`).
+     */
+    bool receive_message();
+
+    /**
+     * Ask the server for the next update, now or after a delay depending
+     * on the idle time.
+     *
+     * @return False if the request could not be sent.
+     */
+    bool request_update();
+
+    /** Send a deferred update request, if any. */
+    void send_deferred_request();
+
+    /**
+     * Read data from the server socket, blocking until done.
+     *
+     * @param vectors Buffers to fill in order. Their bounds are updated as
+     * data is read.
+     * @param count Number of buffers.
+     * @return False if the connection failed.
+     */
+    bool receive(iovec* vectors, std::size_t count);
+
+    /**
+     * Receive the pixels of a raw rectangle.
+     *
+     * @param x Left bound of the rectangle (in pixels).
+     * @param y Top bound of the rectangle (in pixels).
+     * @param w Width of the rectangle (in pixels).
+     * @param h Height of the rectangle (in pixels).
+     * @param trailer Buffer for data following the pixels, read along
+     * with them, or null.
+     * @param trailer_size Size of the trailer buffer.
+     * @return False if the connection failed.
+     */
+    bool receive_raw(
+        int x, int y, int w, int h,
+        void* trailer, std::size_t trailer_size
+    );
+
+    /**
+     * Let the VNC library process the rest of a message.
+     *
+     * The data is put back into the read buffer of the library (`buf`,
+     * `bufoutptr` and `buffered` in rfbClient), which is consumed before the
+     * socket as of LibVNCClient 0.9.13 (see the required version in
+     * CMakeLists.txt).
+     *
+     * @param data Part of the message that was already read.
+     * @param size Size of the data.
+     * @return False if the connection failed.
+     */
+    bool hand_over(const void* data, std::size_t size);
+
+    /**
+     * Account for pixel data received from the server.
+     *
+     * @param bytes Counter for the encoding of the data.
+     * @param size Number of bytes received.
+     */
+    void count_received(stats::counter& bytes, std::size_t size);
+
+    /**
+     * Convert and store a rectangle of pixels received from the server.
+     *
+     * @param buffer Pixels of the rectangle, in the server format.
+     * @param x Left bound of the rectangle (in pixels).
+     * @param y Top bound of the rectangle (in pixels).
+     * @param w Width of the rectangle (in pixels).
+     * @param h Height of the rectangle (in pixels).
+     * @param bytes Counter for the encoding of the rectangle.
+     */
+    void store_rect(
+        const uint8_t* buffer, int x, int y, int w, int h,
+        stats::counter& bytes
+    );
+
+    /**
+     * Called by the VNC client library when the server sends a new cursor
+     * shape, stored in `rcSource` and `rcMask`.
+     *
+     * @param client Handle to the VNC client.
+     * @param hot_x Column of the pointed pixel in the shape.
+     * @param hot_y Row of the pointed pixel in the shape.
+     * @param w Width of the shape (in pixels).
+     * @param h Height of the shape (in pixels).
+     * @param bytes_per_pixel Size of the pixels in `rcSource`.
+     */
+    static void set_cursor_shape(
+        rfbClient* client,
+        int hot_x, int hot_y, int w, int h,
+        int bytes_per_pixel
+    );
+
+    /**
+     * Called by the VNC client library when the server moves the cursor.
+     *
+     * @param client Handle to the VNC client.
+     * @param x Column of the pointed pixel on the screen.
+     * @param y Row of the pointed pixel on the screen.
+     * @return Always true.
+     */
+    static rfbBool set_cursor_position(rfbClient* client, int x, int y);
+
     /**
      * Called by the VNC client library when a server update is completed.
      *
@@ -109,6 +519,14 @@ private:
         int x, int y, int w, int h
     );
 
+    /**
+     * Called by the VNC client library when all the rectangles of a server
+     * update have been received.
+     *
+     * @param client Handle to the VNC client.
+     */
+    static void finish_updates(rfbClient* client);
+
     /** Accumulator for updates received from the VNC server. */
     struct update_info_struct
     {
@@ -126,16 +544,116 @@ private:
 
         /** Whether at least one update has been registered. */
         bool has_update = false;
+
+        /** Number of rectangles merged in the overall updated rectangle. */
+        int rects = 0;
     } update_info;
 
+    /** State of the comparison of a new connection with the screen. */
+    struct resync_info_struct
+    {
+        /** Whether the first update of a new connection is awaited. */
+        bool pending = false;
+
+        /** Number of tile columns covering the screen. */
+        int columns = 0;
+
+        /** Number of tile rows covering the screen. */
+        int rows = 0;
+
+        /** Whether each tile, in row-major order, was changed. */
+        std::vector<bool> changed;
+    } resync_info;
+
+    /**
+     * Part of the server framebuffer kept in memory below the screen, used
+     * by servers that cache window contents on the client side.
+     */
+    struct cache_info_struct
+    {
+        /** First row of the server framebuffer that is not displayed. */
+        int top = INT_MAX;
+
+        /** Number of pixels in each off-screen row. */
+        int width = 0;
+
+        /** Number of off-screen rows. */
+        int height = 0;
+
+        /** Pixel data of the off-screen rows. */
+        std::vector<uint8_t> data;
+    } cache_info;
+
+    /** Scratch space for a row of pixels. */
+    std::vector<uint8_t> row_buffer;
+
+    /**
+     * Counter for the bitmaps decoded by the VNC library, set to the
+     * encoding of the rectangles it is left to process.
+     */
+    stats::counter* library_bytes;
+
+#ifdef VNSEE_JPEG
+    /** Decoder for the JPEG rectangles of the Tight encoding. */
+    jpeg_decoder jpeg;
+
+    /** Luma of the last decoded JPEG rectangle. */
+    std::vector<uint8_t> luma_buffer;
+#endif
+
+    /** Scratch space for receiving pixels through memory. */
+    std::vector<uint8_t> receive_buffer;
+
+    /** Destination of received pixels that are not stored. */
+    std::vector<uint8_t> discard_buffer;
+
+    /** Buffers to receive the rows of a rectangle into. */
+    std::vector<iovec> receive_vectors;
+
     /** Last time a repaint was performed. */
-    std::chrono::steady_clock::time_point last_repaint;
+    clock::time_point last_repaint;
+
+    /** Time to wait between two standard repaints. */
+    std::chrono::milliseconds standard_delay;
+
+    /** Time to wait between two fast repaints. */
+    std::chrono::milliseconds fast_delay;
+
+    /** Time without activity after which to slow down, or 0. */
+    std::chrono::milliseconds idle_timeout{0};
+
+    /** Last time user activity or a changed region was registered. */
+    clock::time_point last_activity;
+
+    /** Whether an update request was deferred. */
+    bool request_deferred = false;
+
+    /** Time at which the deferred update request is due. */
+    clock::time_point request_due;
+
+    /** Whether the completion of repaints is tracked. */
+    bool tracking_completions = false;
+
+    /** Number of repaints sent to the device that are not complete yet. */
+    int repaints_in_flight = 0;
 
     /** Tag used for accessing the instance from C callbacks. */
     static void* instance_tag;
 
     /** Current repaint mode. */
     repaint_modes repaint_mode;
+
+    /** Debugging overlay, if enabled. */
+    std::optional<hud> hud_overlay;
+
+    /** Cursor drawn on the client side, if enabled. */
+    std::optional<cursor> cursor_overlay;
+
+    /** Last time the cursor was repainted. */
+    clock::time_point last_cursor_repaint;
+
+    /** Function to call for each region that must be repainted. */
+    damage_callback on_damage;
 }; // class screen
 
 } // namespace app
@@ -1,6 +1,7 @@
 #include "touch.hpp"
 #include "../rmioc/screen.hpp"
 #include "../rmioc/touch.hpp"
+#include <chrono>
 #include <cstdlib>
 #include <functional>
 #include <map>
@@ -30,13 +31,20 @@ constexpr double scroll_speed = 0.013;
 touch::touch(
     rmioc::touch& device,
     const rmioc::screen& screen_device,
-    MouseCallback send_button_press
+    MouseCallback send_button_press,
+    const clock& time_source
 )
 : device(device)
 , screen_device(screen_device)
 , send_button_press(std::move(send_button_press))
+, time_source(time_source)
 {}
 
+auto touch::has_pending_events() const -> bool
+{
+    return this->device.has_pending_events();
+}
+
 auto touch::process_events(bool inhibit) -> event_loop_status
 {
     if (this->device.process_events())
@@ -91,7 +99,7 @@ void touch::on_update(int x, int y)
     if (this->state == TouchState::Inactive)
     {
         this->state = TouchState::Tap;
-        this->touch_start = std::chrono::steady_clock::now();
+        this->touch_start = this->time_source.now();
         this->x_initial = x;
         this->y_initial = y;
         this->x_scroll_events = 0;
@@ -185,9 +193,7 @@ void touch::on_end()
     // Perform tap action if the touchpoint was not used for scrolling
     if (this->state == TouchState::Tap)
     {
-        auto touch_duration
-            = std::chrono::steady_clock::now().time_since_epoch()
-            - this->touch_start.time_since_epoch();
+        auto touch_duration = this->time_source.now() - this->touch_start;
 
         this->send_button_press(
             this->x_initial, this->y_initial,
@@ -1,8 +1,8 @@
 #ifndef APP_TOUCH_HPP
 #define APP_TOUCH_HPP
 
+#include "clock.hpp"
 #include "event_loop.hpp"
-#include <chrono>
 
 namespace rmioc
 {
@@ -19,16 +19,20 @@ public:
     touch(
         rmioc::touch& device,
         const rmioc::screen& screen_device,
-        MouseCallback send_button_press
+        MouseCallback send_button_press,
+        const clock& time_source = clock::system()
     );
 
     /**
-     * Process events from the touchscreen.
+     * Process the next report from the touchscreen.
      *
      * @param inhibit True to discard any event from the touchscreen.
      */
     event_loop_status process_events(bool inhibit);
 
+    /** Whether reports already read from the touchscreen await processing. */
+    bool has_pending_events() const;
+
 private:
     /** reMarkable touchscreen device. */
     rmioc::touch& device;
@@ -39,6 +43,9 @@ private:
     /** Callback for sending mouse events. */
     MouseCallback send_button_press;
 
+    /** Clock used for measuring the duration of taps. */
+    const clock& time_source;
+
     /**
      * Called when the touch point position changes.
      *
@@ -67,7 +74,7 @@ private:
     } state = TouchState::Inactive;
 
     /** Starting time of the current touch interaction. */
-    std::chrono::steady_clock::time_point touch_start{};
+    clock::time_point touch_start{};
 
     /** Current X position of the touch interaction, if not inactive. */
     int x = 0;
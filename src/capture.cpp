@@ -0,0 +1,567 @@
+#include "capture.hpp"
+#include "log.hpp"
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace chrono = std::chrono;
+
+namespace
+{
+
+constexpr std::array<char, 8> magic{'V', 'N', 'S', 'E', 'E', 'R', 'F', '1'};
+
+/** Size of the buffer used for relaying data. */
+constexpr std::size_t relay_buffer_size = 64 * 1024;
+
+/** Print an error that happened in a relay thread. */
+void log_error(const char* kind, const std::exception& err)
+{
+    if (log::is_enabled(log::levels::error))
+    {
+        std::string message = err.what();
+        message += '\n';
+        log::write(kind, message.data(), message.size());
+    }
+}
+
+/** Open a socket listening on an ephemeral loopback port. */
+auto listen_loopback(rmioc::file_descriptor& listen_fd) -> int
+{
+    // NOLINTNEXTLINE(hicpp-signed-bitwise): Use of C library
+    listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+    if (listen_fd == -1)
+    {
+        throw std::system_error(
+            errno,
+            std::generic_category(),
+            "(capture) Create relay socket"
+        );
+    }
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+    socklen_t length = sizeof(address);
+
+    if (bind(
+            listen_fd,
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast): Use of C library
+            reinterpret_cast<sockaddr*>(&address),
+            sizeof(address)
+        ) == -1
+        || listen(listen_fd, 1) == -1
+        || getsockname(
+            listen_fd,
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast): Use of C library
+            reinterpret_cast<sockaddr*>(&address),
+            &length
+        ) == -1)
+    {
+        throw std::system_error(
+            errno,
+            std::generic_category(),
+            "(capture) Listen on relay socket"
+        );
+    }
+
+    return ntohs(address.sin_port);
+}
+
+/** Create the pipe used to stop a relay thread. */
+void make_stop_pipe(
+    rmioc::file_descriptor& stop_read,
+    rmioc::file_descriptor& stop_write
+)
+{
+    std::array<int, 2> fds{};
+
+    if (pipe2(fds.data(), O_CLOEXEC) == -1)
+    {
+        throw std::system_error(
+            errno,
+            std::generic_category(),
+            "(capture) Create pipe"
+        );
+    }
+
+    stop_read = fds[0];
+    stop_write = fds[1];
+}
+
+/**
+ * Wait for the client to connect to a relay.
+ *
+ * @return Client socket, or -1 if the relay was stopped first.
+ */
+auto accept_client(int listen_fd, int stop_fd) -> rmioc::file_descriptor
+{
+    std::array<pollfd, 2> fds{
+        pollfd{listen_fd, POLLIN, 0},
+        pollfd{stop_fd, POLLIN, 0},
+    };
+
+    while (poll(fds.data(), fds.size(), -1) == -1)
+    {
+        if (errno != EINTR)
+        {
+            throw std::system_error(
+                errno,
+                std::generic_category(),
+                "(capture) Wait for client"
+            );
+        }
+    }
+
+    if (fds[1].revents != 0)
+    {
+        return {-1};
+    }
+
+    rmioc::file_descriptor client{accept4(listen_fd, nullptr, nullptr,
+        SOCK_CLOEXEC)};
+
+    if (client == -1)
+    {
+        throw std::system_error(
+            errno,
+            std::generic_category(),
+            "(capture) Accept client"
+        );
+    }
+
+    return client;
+}
+
+/** Open a TCP connection to a server. */
+auto connect_server(const std::string& host, int port)
+-> rmioc::file_descriptor
+{
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* results = nullptr;
+
+    int status = getaddrinfo(
+        host.c_str(), std::to_string(port).c_str(),
+        &hints, &results
+    );
+
+    if (status != 0)
+    {
+        throw std::runtime_error{
+            "(capture) Resolve " + host + ": " + gai_strerror(status)};
+    }
+
+    int error = 0;
+
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    for (addrinfo* it = results; it != nullptr; it = it->ai_next)
+    {
+        rmioc::file_descriptor server{socket(
+            it->ai_family,
+            // NOLINTNEXTLINE(hicpp-signed-bitwise): Use of C library
+            it->ai_socktype | SOCK_CLOEXEC,
+            it->ai_protocol
+        )};
+
+        if (server != -1 && connect(server, it->ai_addr, it->ai_addrlen) == 0)
+        {
+            freeaddrinfo(results);
+            return server;
+        }
+
+        error = errno;
+    }
+
+    freeaddrinfo(results);
+    throw std::system_error(
+        error,
+        std::generic_category(),
+        "(capture) Connect to " + host
+    );
+}
+
+/** Write a whole buffer to a blocking file descriptor. */
+void write_all(int fd, const std::uint8_t* data, std::size_t length)
+{
+    while (length > 0)
+    {
+        ssize_t written = send(fd, data, length, MSG_NOSIGNAL);
+
+        if (written == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            throw std::system_error(
+                errno,
+                std::generic_category(),
+                "(capture) Relay data"
+            );
+        }
+
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        data += written;
+        length -= static_cast<std::size_t>(written);
+    }
+}
+
+/** Write a plain value to a binary stream. */
+template<typename T>
+void write_value(std::ostream& out, const T& value)
+{
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+/** Read a plain value from a binary stream, returning false at the end. */
+template<typename T>
+auto read_value(std::istream& in, T& value) -> bool
+{
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(&value),
+        sizeof(value)));
+}
+
+} // anonymous namespace
+
+namespace capture
+{
+
+auto load(const char* path) -> session
+{
+    std::ifstream in{path, std::ios::binary};
+
+    if (!in)
+    {
+        throw std::system_error(
+            errno,
+            std::generic_category(),
+            "(capture::load) Open capture file"
+        );
+    }
+
+    std::array<char, magic.size()> file_magic{};
+    in.read(file_magic.data(), file_magic.size());
+
+    if (!in || file_magic != magic)
+    {
+        throw std::runtime_error{"(capture::load) Not a VNC capture"};
+    }
+
+    session result;
+    std::uint32_t delay = 0;
+    std::uint32_t length = 0;
+
+    while (read_value(in, delay))
+    {
+        if (!read_value(in, length))
+        {
+            throw std::runtime_error{"(capture::load) Truncated capture"};
+        }
+
+        std::size_t offset = result.data.size();
+        result.data.resize(offset + length);
+
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        if (!in.read(reinterpret_cast<char*>(&result.data[offset]), length))
+        {
+            throw std::runtime_error{"(capture::load) Truncated capture"};
+        }
+
+        result.chunks.push_back(chunk{
+            chrono::microseconds{delay}, offset, length});
+    }
+
+    return result;
+}
+
+recorder::recorder(const char* host, int port, const char* path)
+: host(host)
+, port(port)
+, out(path, std::ios::binary | std::ios::trunc)
+{
+    if (!this->out)
+    {
+        throw std::system_error(
+            errno,
+            std::generic_category(),
+            "(capture::recorder) Create capture file"
+        );
+    }
+
+    this->out.write(magic.data(), magic.size());
+    this->listen_port = listen_loopback(this->listen_fd);
+    make_stop_pipe(this->stop_read, this->stop_write);
+    this->worker = std::thread{&recorder::run, this};
+}
+
+recorder::~recorder()
+{
+    // Closing the pipe wakes up the relay thread
+    this->stop_write = -1;
+    this->worker.join();
+}
+
+auto recorder::get_port() const -> int
+{
+    return this->listen_port;
+}
+
+void recorder::run()
+{
+    try
+    {
+        auto client = accept_client(this->listen_fd, this->stop_read);
+
+        if (client == -1)
+        {
+            return;
+        }
+
+        auto server = connect_server(this->host, this->port);
+        std::vector<std::uint8_t> buffer(relay_buffer_size);
+        auto last_time = chrono::steady_clock::now();
+
+        std::array<pollfd, 3> fds{
+            pollfd{server, POLLIN, 0},
+            pollfd{client, POLLIN, 0},
+            pollfd{this->stop_read, POLLIN, 0},
+        };
+
+        while (true)
+        {
+            if (poll(fds.data(), fds.size(), -1) == -1)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+
+                throw std::system_error(
+                    errno,
+                    std::generic_category(),
+                    "(capture::recorder) Wait for data"
+                );
+            }
+
+            if (fds[2].revents != 0)
+            {
+                return;
+            }
+
+            if (fds[0].revents != 0)
+            {
+                ssize_t length = read(server, buffer.data(), buffer.size());
+
+                if (length <= 0)
+                {
+                    return;
+                }
+
+                auto now = chrono::steady_clock::now();
+                auto delay = chrono::duration_cast<chrono::microseconds>(
+                    now - last_time);
+                last_time = now;
+
+                write_value(this->out,
+                    static_cast<std::uint32_t>(delay.count()));
+                write_value(this->out, static_cast<std::uint32_t>(length));
+                // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+                this->out.write(reinterpret_cast<const char*>(buffer.data()),
+                    length);
+
+                write_all(client, buffer.data(),
+                    static_cast<std::size_t>(length));
+            }
+
+            if (fds[1].revents != 0)
+            {
+                ssize_t length = read(client, buffer.data(), buffer.size());
+
+                if (length <= 0)
+                {
+                    return;
+                }
+
+                write_all(server, buffer.data(),
+                    static_cast<std::size_t>(length));
+            }
+        }
+    }
+    catch (const std::exception& err)
+    {
+        log_error("Capture error", err);
+    }
+}
+
+player::player(const char* path, bool real_time)
+: real_time(real_time)
+, captured(load(path))
+{
+    this->listen_port = listen_loopback(this->listen_fd);
+    make_stop_pipe(this->stop_read, this->stop_write);
+    this->worker = std::thread{&player::run, this};
+}
+
+player::~player()
+{
+    this->stop_write = -1;
+    this->worker.join();
+}
+
+auto player::get_port() const -> int
+{
+    return this->listen_port;
+}
+
+auto player::get_bytes() const -> std::size_t
+{
+    return this->captured.data.size();
+}
+
+auto player::get_chunks() const -> std::size_t
+{
+    return this->captured.chunks.size();
+}
+
+void player::run()
+{
+    try
+    {
+        auto client = accept_client(this->listen_fd, this->stop_read);
+
+        if (client == -1)
+        {
+            return;
+        }
+
+        // Requests from the client are read and dropped, so that it never
+        // blocks on a full socket while data is being sent to it
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg,hicpp-vararg,hicpp-signed-bitwise)
+        fcntl(client, F_SETFL, fcntl(client, F_GETFL) | O_NONBLOCK);
+
+        std::vector<std::uint8_t> discard(relay_buffer_size);
+        auto due = chrono::steady_clock::now();
+        std::size_t next = 0;
+        std::size_t sent = 0;
+
+        std::array<pollfd, 2> fds{
+            pollfd{client, POLLIN, 0},
+            pollfd{this->stop_read, POLLIN, 0},
+        };
+
+        while (next < this->captured.chunks.size())
+        {
+            const auto& current = this->captured.chunks[next];
+            int timeout = 0;
+
+            if (sent == 0 && this->real_time)
+            {
+                auto now = chrono::steady_clock::now();
+
+                if (now < due + current.delay)
+                {
+                    timeout = static_cast<int>(
+                        chrono::ceil<chrono::milliseconds>(
+                            due + current.delay - now).count());
+                }
+            }
+
+            // NOLINTNEXTLINE(hicpp-signed-bitwise): Use of C library
+            fds[0].events = timeout == 0 ? POLLIN | POLLOUT : POLLIN;
+
+            if (poll(fds.data(), fds.size(), timeout == 0 ? -1 : timeout)
+                    == -1)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+
+                throw std::system_error(
+                    errno,
+                    std::generic_category(),
+                    "(capture::player) Wait for client"
+                );
+            }
+
+            if (fds[1].revents != 0)
+            {
+                return;
+            }
+
+            // NOLINTNEXTLINE(hicpp-signed-bitwise): Use of C library
+            if ((fds[0].revents & (POLLIN | POLLHUP | POLLERR)) != 0)
+            {
+                if (read(client, discard.data(), discard.size()) == 0)
+                {
+                    return;
+                }
+            }
+
+            // NOLINTNEXTLINE(hicpp-signed-bitwise): Use of C library
+            if ((fds[0].revents & POLLOUT) != 0)
+            {
+                if (sent == 0)
+                {
+                    due += current.delay;
+                }
+
+                ssize_t written = send(
+                    client,
+                    &this->captured.data[current.offset + sent],
+                    current.length - sent,
+                    MSG_NOSIGNAL
+                );
+
+                if (written == -1)
+                {
+                    if (errno == EAGAIN || errno == EINTR)
+                    {
+                        continue;
+                    }
+
+                    throw std::system_error(
+                        errno,
+                        std::generic_category(),
+                        "(capture::player) Send data"
+                    );
+                }
+
+                sent += static_cast<std::size_t>(written);
+
+                if (sent == current.length)
+                {
+                    sent = 0;
+                    ++next;
+                }
+            }
+        }
+
+        // Closing the connection makes the client leave its event loop
+        shutdown(client, SHUT_WR);
+    }
+    catch (const std::exception& err)
+    {
+        log_error("Replay error", err);
+    }
+}
+
+} // namespace capture
@@ -0,0 +1,178 @@
+#ifndef CAPTURE_HPP
+#define CAPTURE_HPP
+
+#include "rmioc/file.hpp"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * Captures of VNC sessions only contain the bytes sent by the server and
+ * are stored in host byte order with the following layout:
+ *
+ * - the magic string “VNSEERF1”;
+ * - for each chunk of data received from the server, the time elapsed
+ *   since the previous chunk (in microseconds, 32 bits), the chunk length
+ *   (32 bits) and the chunk contents.
+ *
+ * Both the recorder and the player are loopback relays running in their
+ * own thread: the client connects to them as if they were the server, so
+ * that the whole session, handshake included, goes through the VNC library
+ * unchanged.
+ */
+
+namespace capture
+{
+
+/** Chunk of data received from the server. */
+struct chunk
+{
+    /** Time elapsed since the previous chunk. */
+    std::chrono::microseconds delay;
+
+    /** Offset of the chunk contents in `session::data`. */
+    std::size_t offset;
+
+    /** Length of the chunk. */
+    std::size_t length;
+};
+
+/** Contents of a capture file. */
+struct session
+{
+    /** Captured chunks, in order of reception. */
+    std::vector<chunk> chunks;
+
+    /** Contents of all the chunks, concatenated. */
+    std::vector<std::uint8_t> data;
+};
+
+/**
+ * Read a capture file.
+ *
+ * @param path Path of the capture file.
+ * @throws std::system_error If the file cannot be opened.
+ * @throws std::runtime_error If the file is not a valid capture.
+ */
+session load(const char* path);
+
+/**
+ * Relay a VNC session to a server and save all the data it sends.
+ */
+class recorder
+{
+public:
+    /**
+     * Start listening for the client connection.
+     *
+     * @param host Address of the VNC server.
+     * @param port Port of the VNC server.
+     * @param path Path of the capture file to write.
+     * @throws std::system_error If the file cannot be created or the relay
+     * cannot listen for connections.
+     */
+    recorder(const char* host, int port, const char* path);
+
+    /** Close the relay and finish writing the capture. */
+    ~recorder();
+
+    recorder(const recorder& other) = delete;
+    recorder& operator=(const recorder& other) = delete;
+    recorder(recorder&& other) = delete;
+    recorder& operator=(recorder&& other) = delete;
+
+    /** Get the loopback port to connect the client to. */
+    int get_port() const;
+
+private:
+    /** Address of the VNC server. */
+    std::string host;
+
+    /** Port of the VNC server. */
+    int port;
+
+    /** Capture file. */
+    std::ofstream out;
+
+    /** Listening socket. */
+    rmioc::file_descriptor listen_fd{-1};
+
+    /** Loopback port of the listening socket. */
+    int listen_port = 0;
+
+    /** Pipe used to ask the relay thread to stop. */
+    rmioc::file_descriptor stop_read{-1};
+    rmioc::file_descriptor stop_write{-1};
+
+    /** Relay thread. */
+    std::thread worker;
+
+    /** Body of the relay thread. */
+    void run();
+}; // class recorder
+
+/**
+ * Serve a captured VNC session to a client.
+ */
+class player
+{
+public:
+    /**
+     * Load a capture and start listening for the client connection.
+     *
+     * @param path Path of the capture file.
+     * @param real_time True to send data at the captured pace, false to
+     * send it as fast as the client reads it.
+     * @throws std::runtime_error If the file is not a valid capture.
+     * @throws std::system_error If the relay cannot listen for connections.
+     */
+    player(const char* path, bool real_time);
+
+    /** Stop sending data and close the relay. */
+    ~player();
+
+    player(const player& other) = delete;
+    player& operator=(const player& other) = delete;
+    player(player&& other) = delete;
+    player& operator=(player&& other) = delete;
+
+    /** Get the loopback port to connect the client to. */
+    int get_port() const;
+
+    /** Get the number of captured bytes. */
+    std::size_t get_bytes() const;
+
+    /** Get the number of captured chunks. */
+    std::size_t get_chunks() const;
+
+private:
+    /** Whether to send data at the captured pace. */
+    bool real_time;
+
+    /** Captured session. */
+    session captured;
+
+    /** Listening socket. */
+    rmioc::file_descriptor listen_fd{-1};
+
+    /** Loopback port of the listening socket. */
+    int listen_port = 0;
+
+    /** Pipe used to ask the relay thread to stop. */
+    rmioc::file_descriptor stop_read{-1};
+    rmioc::file_descriptor stop_write{-1};
+
+    /** Relay thread. */
+    std::thread worker;
+
+    /** Body of the relay thread. */
+    void run();
+}; // class player
+
+} // namespace capture
+
+#endif // CAPTURE_HPP
@@ -0,0 +1,99 @@
+#include "log.hpp"
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <ctime>
+#include <vector>
+
+namespace log
+{
+
+namespace detail
+{
+
+// NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
+levels current_level = levels::error;
+
+} // namespace log::detail
+
+/** Size of the stack buffer used for formatting messages. */
+constexpr std::size_t format_buffer_size = 256;
+
+void set_level(levels level)
+{
+    detail::current_level = level;
+}
+
+void write(const char* kind, const char* message, std::size_t length)
+{
+    timespec now{};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    constexpr long nanos_per_micro = 1000;
+    std::array<char, format_buffer_size> header{};
+
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg,hicpp-vararg)
+    int header_length = std::snprintf(
+        header.data(), header.size(), "%ld.%06ld [%s] ",
+        static_cast<long>(now.tv_sec), now.tv_nsec / nanos_per_micro,
+        kind
+    );
+
+    if (header_length > 0)
+    {
+        std::fwrite(
+            header.data(), 1,
+            std::min(
+                static_cast<std::size_t>(header_length),
+                header.size() - 1),
+            stderr
+        );
+    }
+
+    std::fwrite(message, 1, length, stderr);
+}
+
+void vprint(levels level, const char* kind, const char* format, va_list args)
+{
+    if (!is_enabled(level))
+    {
+        return;
+    }
+
+    std::array<char, format_buffer_size> buffer{};
+    va_list args_copy;
+
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg,hicpp-no-array-decay)
+    va_copy(args_copy, args);
+
+    // NOLINTNEXTLINE(hicpp-no-array-decay): Use of C library
+    int length = std::vsnprintf(
+        buffer.data(), buffer.size(),
+        format, args_copy
+    );
+
+    // NOLINTNEXTLINE(hicpp-no-array-decay): Use of C library
+    va_end(args_copy);
+
+    if (length < 0)
+    {
+        return;
+    }
+
+    auto size = static_cast<std::size_t>(length);
+
+    if (size < buffer.size())
+    {
+        write(kind, buffer.data(), size);
+        return;
+    }
+
+    // Only allocate for messages that do not fit in the stack buffer
+    std::vector<char> large_buffer(size + 1);
+
+    // NOLINTNEXTLINE(hicpp-no-array-decay): Use of C library
+    std::vsnprintf(large_buffer.data(), large_buffer.size(), format, args);
+    write(kind, large_buffer.data(), size);
+}
+
+} // namespace log
@@ -1,22 +1,76 @@
 #ifndef LOG_HPP
 #define LOG_HPP
 
-#include <ostream>
+#include <cstdarg>
+#include <cstddef>
 
 namespace log
 {
 
+/** Severity levels of log messages, from the least to the most verbose. */
+enum class levels
+{
+    /** Do not print any message. */
+    none = 0,
+
+    /** Only print errors. */
+    error = 1,
+
+    /** Also print informational messages. */
+    info = 2,
+};
+
+namespace detail
+{
+
+/** Most verbose level of messages that are printed. */
+// NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
+extern levels current_level;
+
+} // namespace log::detail
+
 /**
- * Print a log header and return the log stream for printing further data.
+ * Set the most verbose level of messages to print.
  *
- * @param kind Kind of header to print.
- * @return Log stream for printing the log message.
+ * @param level New maximum level.
  */
-template<typename String>
-std::ostream& print(const String& kind);
+void set_level(levels level);
 
+/**
+ * Check whether messages of a given level are printed.
+ *
+ * Callers should check this before doing any work to build a message,
+ * so that filtered out messages cost a single comparison.
+ *
+ * @param level Level to check.
+ */
+inline auto is_enabled(levels level) -> bool
+{
+    return level != levels::none && level <= detail::current_level;
 }
 
-#include "log.tpp" // IWYU pragma: export
+/**
+ * Print a message with a log header.
+ *
+ * @param kind Kind of header to print.
+ * @param message Message to print.
+ * @param length Length of the message.
+ */
+void write(const char* kind, const char* message, std::size_t length);
+
+/**
+ * Format and print a message with a log header, if its level is enabled.
+ *
+ * Messages are formatted in a stack buffer and only spill to the heap
+ * when they are unusually long.
+ *
+ * @param level Level of the message.
+ * @param kind Kind of header to print.
+ * @param format printf-style format string.
+ * @param args Arguments of the format string.
+ */
+void vprint(levels level, const char* kind, const char* format, va_list args);
+
+}
 
 #endif // LOG_HPP
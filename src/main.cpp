@@ -1,13 +1,27 @@
 #include "options.hpp"
 #include "app/client.hpp"
+#include "capture.hpp"
 #include "config.hpp"
+#include "log.hpp"
 #include "rmioc/device.hpp"
+#include "rmioc/input_record.hpp"
+#include "rmioc/panel_model.hpp"
+#include "rmioc/rm2fb.hpp"
+#include "rmioc/screen_memory.hpp"
+#include "rmioc/screen_rm2fb.hpp"
+#include "stats.hpp"
+#include "trace.hpp"
 #include <algorithm>
+#include <chrono>
+#include <cstddef>
 #include <cstdlib>
 #include <cstring>
+#include <fstream>
 #include <iostream>
 #include <iterator>
 #include <map>
+#include <memory>
+#include <optional>
 #include <stdexcept> // IWYU pragma: keep
 // IWYU pragma: no_include <bits/exception.h>
 #include <string>
@@ -31,7 +45,82 @@ auto help(const char* name) -> void
 "  -v, --version        Show the current version of " PROJECT_NAME " and exit.\n"
 "  --no-buttons         Disable buttons interaction.\n"
 "  --no-pen             Disable pen interaction.\n"
-"  --no-touch           Disable touchscreen interaction.\n";
+"  --no-touch           Disable touchscreen interaction.\n"
+"  --no-cursor          Do not show the mouse cursor of the server.\n"
+"  --stage-updates      Decode updates off-screen and only copy them to the\n"
+"                       visible screen memory when presenting them\n"
+"                       (reMarkable 1 only, experimental).\n"
+"  --pen-tolerance=PIXELS\n"
+"                       Simplify pen strokes by dropping points that lie\n"
+"                       within PIXELS of the sent stroke. Disabled by\n"
+"                       default.\n"
+"  --pen-prediction=MS  Draw the mouse cursor where the pen is expected to be\n"
+"                       MS milliseconds later, to compensate for the screen\n"
+"                       latency. Disabled by default.\n"
+"  --pen-prediction-events\n"
+"                       Also send the predicted pen positions to the server\n"
+"                       while the pen touches the screen.\n"
+"  --idle-timeout=SECONDS\n"
+"                       After SECONDS without input or screen changes, ask\n"
+"                       the server for updates less and less often, down to\n"
+"                       once every 10 seconds, to save power. Any input\n"
+"                       restores the normal rate. Has no effect while the\n"
+"                       Tight encoding is used (see --latency-target).\n"
+"                       Disabled by default.\n"
+"  --latency-target=MS  Measure how fast frames are received and switch to\n"
+"                       the Tight encoding when a whole screen would take\n"
+"                       longer than MS milliseconds. Uses raw pixels only by\n"
+"                       default.\n"
+"  --reconnect          Reconnect to the server when the connection is lost\n"
+"                       instead of exiting, and only repaint the parts of\n"
+"                       the screen that changed meanwhile.\n"
+"  --pixel-format=FORMAT\n"
+"                       Ask the server for pixels in FORMAT and convert them\n"
+"                       to the screen format. Valid formats are screen\n"
+"                       (default), rgb32 and bgr32. If the server closes the\n"
+"                       connection when asked for the screen format, rgb32 or\n"
+"                       bgr32 is used instead.\n"
+"  --log-level=LEVEL    Set the verbosity of messages printed on the standard\n"
+"                       error. Valid levels are none, error (default) and\n"
+"                       info.\n"
+"  --debug-hud          Outline repainted regions and show repaint\n"
+"                       statistics in the top right corner.\n"
+"  --metrics-socket=PATH\n"
+"                       Serve a snapshot of performance counters to each\n"
+"                       connection on the Unix socket at PATH.\n"
+"  --trace=FILE         Record a timeline of client activity and write it to\n"
+"                       FILE in the Chrome trace format on exit or when\n"
+"                       receiving SIGUSR1.\n"
+"  --headless[=WxH]     Draw to an in-memory screen of W by H pixels instead\n"
+"                       of the device screen (default 1404x1872), and disable\n"
+"                       all inputs. Allows running on other machines.\n"
+"  --headless-rm2fb     Draw through a rm2fb server running on this machine,\n"
+"                       such as vnsee-rm2fb-server, instead of an in-memory\n"
+"                       screen.\n"
+"  --headless-framebuffer=FILE\n"
+"                       Map the in-memory screen to FILE, which contains raw\n"
+"                       RGB565 pixels.\n"
+"  --headless-snapshot=FILE\n"
+"                       Write the in-memory screen contents to FILE as a PNG\n"
+"                       image on exit.\n"
+"  --headless-updates=FILE\n"
+"                       Write the list of screen updates to FILE as CSV on\n"
+"                       exit.\n"
+"  --headless-panel=FILE\n"
+"                       Simulate the timing of an e-ink panel and write a\n"
+"                       report of its utilisation, queueing delays and the\n"
+"                       time before each change is visible to FILE as JSON\n"
+"                       on exit.\n"
+"  --record-input=FILE  Record all events read from the input devices to\n"
+"                       FILE.\n"
+"  --replay-input=FILE  Feed the events recorded in FILE to the client\n"
+"                       instead of reading from the input devices, then exit\n"
+"                       and print performance counters. Can be combined with\n"
+"                       --headless.\n"
+"  --replay-speed=SPEED Replay events at the recorded pace (real, default) or\n"
+"                       as fast as they can be processed (fast).\n"
+"  --capture=FILE       Save all data sent by the server to FILE, to be\n"
+"                       replayed later with vnsee-replay.\n";
 }
 
 /**
@@ -42,17 +131,75 @@ auto version() -> void
     std::cout << PROJECT_NAME << ' ' << PROJECT_VERSION << '\n';
 }
 
+/**
+ * Read the value of an option made of a non-negative whole number.
+ *
+ * @param opts Parsed command line options.
+ * @param key Name of the option, which is removed from the options.
+ * @param hint Advice printed along with the error for invalid values.
+ * @return Value of the option, or nothing if it is invalid.
+ */
+auto parse_non_negative(
+    options::Dictionary& opts,
+    const char* key,
+    const char* hint
+) -> std::optional<int>
+{
+    const auto& values = opts[key];
+    std::string text = values.empty() ? "" : values.back();
+    opts.erase(key);
+
+    try
+    {
+        std::size_t end = 0;
+        int value = std::stoi(text, &end);
+
+        if (end == text.size() && value >= 0)
+        {
+            return value;
+        }
+    }
+    catch (const std::logic_error&)
+    {
+        // Reported below along with partially parsed values
+    }
+
+    std::cerr << "“" << text << "” is not a valid value for --" << key
+        << ". " << hint << '\n';
+    return std::nullopt;
+}
+
 constexpr int default_server_port = 5900;
+constexpr int default_headless_xres = 1404;
+constexpr int default_headless_yres = 1872;
 constexpr int min_port = 1;
 constexpr int max_port = (1U << 16U) - 1;
 
 // NOLINTNEXTLINE(readability-function-cognitive-complexity)
 auto main(int argc, const char* argv[]) -> int
 {
+    auto startup_start = std::chrono::steady_clock::now();
+
     // Read options from the command line
     std::string server_ip;
+    std::string metrics_socket;
     int server_port = default_server_port;
     rmioc::device_request request(rmioc::device_request::screen);
+    app::client_options client_options;
+
+    bool headless = false;
+    bool headless_rm2fb = false;
+    int headless_xres = default_headless_xres;
+    int headless_yres = default_headless_yres;
+    std::string headless_framebuffer;
+    std::string headless_snapshot;
+    std::string headless_updates;
+    std::string headless_panel;
+
+    std::string record_input;
+    std::string replay_input;
+    bool replay_real_time = true;
+    std::string capture_file;
 
     // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
     const char* const name = argv[0];
@@ -162,6 +309,315 @@ auto main(int argc, const char* argv[]) -> int
         request.set_touch(true);
     }
 
+    if (opts.count("stage-updates") >= 1)
+    {
+        request.set_staging(true);
+        opts.erase("stage-updates");
+    }
+
+    if (opts.count("no-cursor") >= 1)
+    {
+        opts.erase("no-cursor");
+    }
+    else
+    {
+        client_options.local_cursor = true;
+    }
+
+    if (opts.count("pen-tolerance") >= 1)
+    {
+        auto tolerance = parse_non_negative(
+            opts, "pen-tolerance",
+            "Use a number of pixels, for example 2.");
+
+        if (!tolerance.has_value())
+        {
+            return EXIT_FAILURE;
+        }
+
+        client_options.pen_tolerance = *tolerance;
+    }
+
+    if (opts.count("pen-prediction") >= 1)
+    {
+        auto horizon = parse_non_negative(
+            opts, "pen-prediction",
+            "Use a number of milliseconds, for example 30.");
+
+        if (!horizon.has_value())
+        {
+            return EXIT_FAILURE;
+        }
+
+        client_options.pen_prediction = std::chrono::milliseconds{*horizon};
+    }
+
+    if (opts.count("pen-prediction-events") >= 1)
+    {
+        client_options.pen_prediction_events = true;
+        opts.erase("pen-prediction-events");
+    }
+
+    if (opts.count("idle-timeout") >= 1)
+    {
+        auto timeout = parse_non_negative(
+            opts, "idle-timeout",
+            "Use a number of seconds, for example 60.");
+
+        if (!timeout.has_value())
+        {
+            return EXIT_FAILURE;
+        }
+
+        client_options.idle_timeout = std::chrono::seconds{*timeout};
+    }
+
+    if (opts.count("latency-target") >= 1)
+    {
+        auto target = parse_non_negative(
+            opts, "latency-target",
+            "Use a number of milliseconds, for example 500.");
+
+        if (!target.has_value())
+        {
+            return EXIT_FAILURE;
+        }
+
+        client_options.latency_target = std::chrono::milliseconds{*target};
+    }
+
+    if (opts.count("log-level") >= 1)
+    {
+        const auto& values = opts["log-level"];
+        std::string level = values.empty() ? "" : values.back();
+
+        if (level == "none")
+        {
+            log::set_level(log::levels::none);
+        }
+        else if (level == "error")
+        {
+            log::set_level(log::levels::error);
+        }
+        else if (level == "info")
+        {
+            log::set_level(log::levels::info);
+        }
+        else
+        {
+            std::cerr << "“" << level << "” is not a valid log level. "
+                "Valid levels are none, error and info.\n";
+            return EXIT_FAILURE;
+        }
+
+        opts.erase("log-level");
+    }
+
+    if (opts.count("pixel-format") >= 1)
+    {
+        const auto& values = opts["pixel-format"];
+        std::string format = values.empty() ? "" : values.back();
+
+        if (format == "screen")
+        {
+            client_options.server_format = app::server_formats::screen;
+        }
+        else if (format == "rgb32")
+        {
+            client_options.server_format = app::server_formats::rgb32;
+        }
+        else if (format == "bgr32")
+        {
+            client_options.server_format = app::server_formats::bgr32;
+        }
+        else
+        {
+            std::cerr << "“" << format << "” is not a valid pixel format. "
+                "Valid formats are screen, rgb32 and bgr32.\n";
+            return EXIT_FAILURE;
+        }
+
+        opts.erase("pixel-format");
+    }
+
+    if (opts.count("reconnect") >= 1)
+    {
+        client_options.reconnect = true;
+        opts.erase("reconnect");
+    }
+
+    if (opts.count("debug-hud") >= 1)
+    {
+        client_options.debug_hud = true;
+        opts.erase("debug-hud");
+    }
+
+    if (opts.count("metrics-socket") >= 1)
+    {
+        if (opts["metrics-socket"].empty())
+        {
+            std::cerr << "Missing socket path for the --metrics-socket "
+                "option.\n";
+            return EXIT_FAILURE;
+        }
+
+        metrics_socket = opts["metrics-socket"].back();
+        client_options.metrics_socket = metrics_socket.c_str();
+        opts.erase("metrics-socket");
+    }
+
+    if (opts.count("trace") >= 1)
+    {
+        if (opts["trace"].empty())
+        {
+            std::cerr << "Missing file path for the --trace option.\n";
+            return EXIT_FAILURE;
+        }
+
+        trace::enable(opts["trace"].back().c_str());
+        opts.erase("trace");
+    }
+
+    if (opts.count("headless") >= 1)
+    {
+        headless = true;
+
+        if (!opts["headless"].empty())
+        {
+            const auto& size = opts["headless"].back();
+            auto separator = size.find('x');
+
+            try
+            {
+                if (separator == std::string::npos)
+                {
+                    throw std::invalid_argument{size};
+                }
+
+                headless_xres = std::stoi(size.substr(0, separator));
+                headless_yres = std::stoi(size.substr(separator + 1));
+            }
+            catch (const std::logic_error&)
+            {
+                headless_xres = 0;
+            }
+
+            if (headless_xres <= 0 || headless_yres <= 0)
+            {
+                std::cerr << "“" << size << "” is not a valid screen size. "
+                    "Use the WIDTHxHEIGHT format, for example 1404x1872.\n";
+                return EXIT_FAILURE;
+            }
+        }
+
+        opts.erase("headless");
+    }
+
+    if (opts.count("headless-rm2fb") >= 1)
+    {
+        if (!headless)
+        {
+            std::cerr << "The --headless-rm2fb option requires --headless.\n";
+            return EXIT_FAILURE;
+        }
+
+        headless_rm2fb = true;
+        opts.erase("headless-rm2fb");
+    }
+
+    for (auto [name, value] : {
+        std::make_pair("headless-framebuffer", &headless_framebuffer),
+        std::make_pair("headless-snapshot", &headless_snapshot),
+        std::make_pair("headless-updates", &headless_updates),
+        std::make_pair("headless-panel", &headless_panel),
+    })
+    {
+        if (opts.count(name) >= 1)
+        {
+            if (opts[name].empty())
+            {
+                std::cerr << "Missing file path for the --" << name
+                    << " option.\n";
+                return EXIT_FAILURE;
+            }
+
+            if (!headless)
+            {
+                std::cerr << "The --" << name << " option requires "
+                    "--headless.\n";
+                return EXIT_FAILURE;
+            }
+
+            if (headless_rm2fb)
+            {
+                std::cerr << "The --" << name << " option cannot be "
+                    "combined with --headless-rm2fb.\n";
+                return EXIT_FAILURE;
+            }
+
+            *value = opts[name].back();
+            opts.erase(name);
+        }
+    }
+
+    for (auto [name, value] : {
+        std::make_pair("record-input", &record_input),
+        std::make_pair("replay-input", &replay_input),
+        std::make_pair("capture", &capture_file),
+    })
+    {
+        if (opts.count(name) >= 1)
+        {
+            if (opts[name].empty())
+            {
+                std::cerr << "Missing file path for the --" << name
+                    << " option.\n";
+                return EXIT_FAILURE;
+            }
+
+            *value = opts[name].back();
+            opts.erase(name);
+        }
+    }
+
+    if (!record_input.empty() && !replay_input.empty())
+    {
+        std::cerr << "The --record-input and --replay-input options cannot "
+            "be combined.\n";
+        return EXIT_FAILURE;
+    }
+
+    if (opts.count("replay-speed") >= 1)
+    {
+        const auto& values = opts["replay-speed"];
+        std::string speed = values.empty() ? "" : values.back();
+
+        if (speed == "real")
+        {
+            replay_real_time = true;
+        }
+        else if (speed == "fast")
+        {
+            replay_real_time = false;
+        }
+        else
+        {
+            std::cerr << "“" << speed << "” is not a valid replay speed. "
+                "Valid speeds are real and fast.\n";
+            return EXIT_FAILURE;
+        }
+
+        opts.erase("replay-speed");
+    }
+
+    if (!replay_input.empty())
+    {
+        // Inputs are fed from the recording instead
+        request.set_buttons(false);
+        request.set_pen(false);
+        request.set_touch(false);
+    }
+
     if (!opts.empty())
     {
         std::cerr << "Unknown options: ";
@@ -187,16 +643,140 @@ auto main(int argc, const char* argv[]) -> int
     // Start the client
     try
     {
-        rmioc::device device = rmioc::device::detect(request);
+        rmioc::screen_memory* memory_screen = nullptr;
+        std::optional<rmioc::panel_model> panel;
+
+        if (!headless_panel.empty())
+        {
+            panel.emplace();
+            client_options.on_damage = [&panel](int x, int y, int w, int h)
+            {
+                panel->damage(
+                    rmioc::panel_model::clock::now(),
+                    x, y, w, h
+                );
+            };
+        }
+
+        rmioc::device device = [&]()
+        {
+            if (!headless)
+            {
+                return rmioc::device::detect(request);
+            }
+
+            if (headless_rm2fb)
+            {
+                return rmioc::device::headless(
+                    std::make_unique<rmioc::screen_rm2fb>(
+                        rm2fb::default_shm_path,
+                        rm2fb::default_msgqueue_key
+                    )
+                );
+            }
+
+            auto screen = std::make_unique<rmioc::screen_memory>(
+                headless_xres, headless_yres,
+                headless_framebuffer.empty()
+                    ? nullptr
+                    : headless_framebuffer.c_str()
+            );
+
+            memory_screen = screen.get();
+
+            if (panel.has_value())
+            {
+                memory_screen->set_panel_model(&*panel);
+            }
+            return rmioc::device::headless(std::move(screen));
+        }();
+
+        std::optional<rmioc::input_replay> replay;
+        std::optional<rmioc::input_recorder> recorder;
+
+        if (!replay_input.empty())
+        {
+            replay.emplace(replay_input.c_str(), replay_real_time);
+            device.set_inputs(
+                replay->take_buttons(),
+                replay->take_touch(),
+                replay->take_pen()
+            );
+            client_options.input_replay = &*replay;
+        }
+
+        if (!record_input.empty())
+        {
+            recorder.emplace(record_input.c_str(), device);
+        }
 
         std::cerr << "Connecting to "
             << server_ip << ":" << server_port << "\n";
 
-        app::client client{server_ip.data(), server_port, device};
+        std::optional<capture::recorder> capture_relay;
+
+        if (!capture_file.empty())
+        {
+            // Go through a relay that saves the server data
+            capture_relay.emplace(
+                server_ip.c_str(), server_port,
+                capture_file.c_str()
+            );
+            server_ip = "127.0.0.1";
+            server_port = capture_relay->get_port();
+        }
+
+        app::client client{
+            server_ip.data(), server_port,
+            device, client_options
+        };
 
         std::cerr << "Connection established\n";
 
-        if (!client.event_loop())
+        stats::get_gauge(
+            "vnsee_startup_seconds",
+            "Time spent in each startup phase",
+            "phase=\"probe\""
+        ).set(std::chrono::duration<double>(device.get_probe_time()).count());
+
+        stats::get_gauge(
+            "vnsee_startup_seconds",
+            "Time spent in each startup phase",
+            "phase=\"total\""
+        ).set(std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - startup_start).count());
+
+        bool user_quit = client.event_loop();
+
+        if (replay.has_value())
+        {
+            std::cerr << "Replayed " << replay->get_event_count()
+                << " input events in "
+                << std::chrono::duration<double>(replay->get_elapsed()).count()
+                << " s\n";
+            stats::write(std::cerr);
+        }
+
+        if (memory_screen != nullptr)
+        {
+            if (!headless_snapshot.empty())
+            {
+                memory_screen->write_png(headless_snapshot.c_str());
+            }
+
+            if (!headless_updates.empty())
+            {
+                memory_screen->write_updates(headless_updates.c_str());
+            }
+
+            if (panel.has_value())
+            {
+                std::ofstream report{headless_panel, std::ios::trunc};
+                panel->write_report(report);
+            }
+        }
+
+        if (!user_quit)
         {
             std::cerr << "Connection closed by the server.\n";
             return EXIT_FAILURE;
@@ -1,6 +1,6 @@
 #include "buttons.hpp"
+#include <utility>
 #include <vector>
-#include <fcntl.h>
 #include <linux/input-event-codes.h>
 #include <linux/input.h>
 
@@ -11,18 +11,13 @@ buttons::buttons(const char* device_path)
 : input(device_path)
 {}
 
-auto buttons::is(const char* device_path) -> bool
-{
-    file_descriptor input_fd{device_path, O_RDONLY};
-    auto supp_events = supported_input_events(input_fd);
-
-    if (!supp_events.has_key())
-    {
-        return false;
-    }
+buttons::buttons(file_descriptor&& input_fd)
+: input(std::move(input_fd), axis_limits{})
+{}
 
-    auto supp_keys = supported_key_types(input_fd);
-    return supp_keys.has_power();
+auto buttons::is(const input_capabilities& capabilities) -> bool
+{
+    return capabilities.events.has_key() && capabilities.keys.has_power();
 }
 
 auto buttons::process_events() -> bool
@@ -55,11 +50,9 @@ auto buttons::process_events() -> bool
                 }
             }
         }
-
-        return true;
     }
 
-    return false;
+    return !events.empty();
 }
 
 auto buttons::get_state() const -> const buttons::buttons_state&
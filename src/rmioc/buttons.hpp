@@ -19,11 +19,18 @@ public:
      */
     buttons(const char* device_path);
 
+    /**
+     * Read buttons events from an already opened file.
+     *
+     * @param input_fd File to read events from.
+     */
+    buttons(file_descriptor&& input_fd);
+
     /** Check if an input device is a buttons device. */
-    static bool is(const char* device_path);
+    static bool is(const input_capabilities& capabilities);
 
     /**
-     * Fetch new events from the buttons and process them.
+     * Fetch the next report of events from the buttons and process it.
      *
      * @return True if the buttons’ state changed since last call.
      */
@@ -1,14 +1,25 @@
 #include "device.hpp"
+#include "file.hpp"
+#include "input.hpp"
+#include "rm2fb.hpp"
 #include "screen_mxcfb.hpp"
 #include "screen_rm2fb.hpp"
+#include <array>
+#include <cstdint>
+#include <cstdlib>
 #include <fcntl.h>
 #include <fstream>
 #include <filesystem>
+#include <map>
 #include <stdexcept>
 #include <string>
+#include <system_error>
+#include <tuple>
 #include <utility>
+#include <sys/stat.h>
 
 namespace fs = std::filesystem;
+namespace chrono = std::chrono;
 
 namespace rmioc
 {
@@ -47,6 +58,180 @@ auto get_device_type() -> device::types
 is “" + device_id + "”"};
 }
 
+namespace
+{
+
+/** Kinds of input nodes, as stored in the probing cache. */
+enum class input_kinds
+{
+    other,
+    buttons,
+    touch,
+    pen,
+};
+
+/** Name of each kind of input node in the probing cache. */
+constexpr std::array<const char*, 4> input_kind_names{
+    "other", "buttons", "touch", "pen",
+};
+
+/**
+ * Identity of a device node.
+ *
+ * Nodes are recreated with a new change time when the kernel registers
+ * the device again, for example after a reboot.
+ */
+struct node_identity
+{
+    dev_t device;
+    std::int64_t changed_sec;
+    std::int64_t changed_nsec;
+
+    bool operator==(const node_identity& other) const
+    {
+        return std::tie(this->device, this->changed_sec, this->changed_nsec)
+            == std::tie(other.device, other.changed_sec, other.changed_nsec);
+    }
+};
+
+/** Cached probing result for an input node. */
+struct probe_entry
+{
+    node_identity identity;
+    input_kinds kind;
+};
+
+/** Cached probing results indexed by node path. */
+using probe_cache = std::map<std::string, probe_entry>;
+
+/**
+ * Get the path of the probing cache, or an empty path if there is no
+ * suitable location.
+ */
+auto get_probe_cache_path() -> fs::path
+{
+    const char* cache_home = std::getenv("XDG_CACHE_HOME");
+
+    if (cache_home != nullptr && *cache_home != '\0')
+    {
+        return fs::path{cache_home} / "vnsee" / "input-devices";
+    }
+
+    const char* home = std::getenv("HOME");
+
+    if (home != nullptr && *home != '\0')
+    {
+        return fs::path{home} / ".cache" / "vnsee" / "input-devices";
+    }
+
+    return {};
+}
+
+/**
+ * Read the probing cache.
+ *
+ * Each line holds the kind of a node, its device number, its change time
+ * (seconds and nanoseconds) and its path. Missing or malformed caches are
+ * treated as empty.
+ */
+auto load_probe_cache(const fs::path& path) -> probe_cache
+{
+    probe_cache result;
+
+    if (path.empty())
+    {
+        return result;
+    }
+
+    std::ifstream in{path};
+    std::string kind_name;
+    probe_entry entry{};
+    std::string node_path;
+
+    while (in >> kind_name >> entry.identity.device
+            >> entry.identity.changed_sec >> entry.identity.changed_nsec
+            >> node_path)
+    {
+        for (std::size_t i = 0; i < input_kind_names.size(); ++i)
+        {
+            if (kind_name == input_kind_names.at(i))
+            {
+                entry.kind = static_cast<input_kinds>(i);
+                result.emplace(node_path, entry);
+            }
+        }
+    }
+
+    return result;
+}
+
+/**
+ * Write the probing cache.
+ *
+ * The cache is only an optimization, so failures are ignored.
+ */
+void save_probe_cache(const fs::path& path, const probe_cache& cache)
+{
+    if (path.empty())
+    {
+        return;
+    }
+
+    std::error_code error;
+    fs::create_directories(path.parent_path(), error);
+
+    // Write to a temporary file first so that concurrent starts never
+    // read a partial cache
+    auto temp_path = path;
+    temp_path += ".tmp";
+
+    {
+        std::ofstream out{temp_path, std::ios::trunc};
+
+        for (const auto& [node_path, entry] : cache)
+        {
+            out << input_kind_names.at(static_cast<std::size_t>(entry.kind))
+                << ' ' << entry.identity.device
+                << ' ' << entry.identity.changed_sec
+                << ' ' << entry.identity.changed_nsec
+                << ' ' << node_path << '\n';
+        }
+
+        if (!out)
+        {
+            return;
+        }
+    }
+
+    fs::rename(temp_path, path, error);
+}
+
+/** Find out which kind of input device a node is. */
+auto probe_input_kind(const char* path) -> input_kinds
+{
+    file_descriptor input_fd{path, O_RDONLY};
+    auto capabilities = supported_capabilities(input_fd);
+
+    if (buttons::is(capabilities))
+    {
+        return input_kinds::buttons;
+    }
+
+    if (touch::is(capabilities))
+    {
+        return input_kinds::touch;
+    }
+
+    if (pen::is(capabilities))
+    {
+        return input_kinds::pen;
+    }
+
+    return input_kinds::other;
+}
+
+} // anonymous namespace
+
 void discover_input_devices(
     const char* base_path,
     device::types type,
@@ -56,20 +241,52 @@ void discover_input_devices(
     std::unique_ptr<pen>& pen_device
 )
 {
+    auto cache_path = get_probe_cache_path();
+    auto cache = load_probe_cache(cache_path);
+    probe_cache current;
+    bool changed = false;
+
     for (const auto& entry : fs::directory_iterator(base_path))
     {
         if (entry.is_character_file())
         {
             const char* path = entry.path().c_str();
+            struct stat info{};
+
+            if (stat(path, &info) == -1)
+            {
+                continue;
+            }
+
+            node_identity identity{
+                info.st_rdev,
+                info.st_ctim.tv_sec,
+                info.st_ctim.tv_nsec
+            };
 
-            if (buttons::is(path))
+            auto cached = cache.find(entry.path().native());
+            input_kinds kind = input_kinds::other;
+
+            if (cached != cache.end() && cached->second.identity == identity)
+            {
+                kind = cached->second.kind;
+            }
+            else
+            {
+                kind = probe_input_kind(path);
+                changed = true;
+            }
+
+            current.emplace(entry.path().native(), probe_entry{identity, kind});
+
+            if (kind == input_kinds::buttons)
             {
                 if (request.has_buttons())
                 {
                     buttons_device = std::make_unique<buttons>(path);
                 }
             }
-            else if (touch::is(path))
+            else if (kind == input_kinds::touch)
             {
                 if (request.has_touch())
                 {
@@ -80,7 +297,7 @@ void discover_input_devices(
                     );
                 }
             }
-            else if (pen::is(path))
+            else if (kind == input_kinds::pen)
             {
                 if (request.has_pen())
                 {
@@ -93,18 +310,16 @@ void discover_input_devices(
             }
         }
     }
+
+    if (changed || current.size() != cache.size())
+    {
+        save_probe_cache(cache_path, current);
+    }
 }
 
 auto device::detect(device_request request) -> device
 {
-    std::ifstream device_id_file{"/sys/devices/soc0/machine"};
-    std::string device_id;
-    std::getline(device_id_file, device_id);
-
     types type = get_device_type();
-    std::unique_ptr<buttons> buttons_device;
-    std::unique_ptr<touch> touch_device;
-    std::unique_ptr<pen> pen_device;
     std::unique_ptr<screen> screen_device;
 
     // Use the appropriate screen driver based on current device type
@@ -112,29 +327,61 @@ auto device::detect(device_request request) -> device
     {
         if (type == types::reMarkable1)
         {
-            screen_device = std::make_unique<screen_mxcfb>("/dev/fb0");
+            screen_device = std::make_unique<screen_mxcfb>(
+                /* device_path = */ "/dev/fb0",
+                /* staging = */ request.has_staging()
+            );
         }
         else
         {
-            constexpr auto rm2fb_msgqueue_key = 0x2257c;
             screen_device = std::make_unique<screen_rm2fb>(
-                /* framebuf_path = */ "/swtfb.01",
-                /* msgqueue_key = */ rm2fb_msgqueue_key
+                /* framebuf_path = */ rm2fb::default_shm_path,
+                /* msgqueue_key = */ rm2fb::default_msgqueue_key
             );
         }
     }
 
-    // Auto-detect and open requested input devices
-    discover_input_devices(
-        "/dev/input", type, request,
-        buttons_device, touch_device, pen_device
+    device result(
+        type,
+        /* buttons_device = */ nullptr,
+        /* touch_device = */ nullptr,
+        /* pen_device = */ nullptr,
+        std::move(screen_device)
     );
 
+    // Auto-detect and open requested input devices
+    if (request.has_buttons() || request.has_touch() || request.has_pen())
+    {
+        result.pending_inputs = std::async(
+            std::launch::async,
+            [type, request]()
+            {
+                auto start = chrono::steady_clock::now();
+                input_set inputs;
+
+                discover_input_devices(
+                    "/dev/input", type, request,
+                    inputs.buttons_device,
+                    inputs.touch_device,
+                    inputs.pen_device
+                );
+
+                inputs.probe_time = chrono::steady_clock::now() - start;
+                return inputs;
+            }
+        );
+    }
+
+    return result;
+}
+
+auto device::headless(std::unique_ptr<screen>&& screen_device) -> device
+{
     return device(
-        type,
-        std::move(buttons_device),
-        std::move(touch_device),
-        std::move(pen_device),
+        types::headless,
+        /* buttons_device = */ nullptr,
+        /* touch_device = */ nullptr,
+        /* pen_device = */ nullptr,
         std::move(screen_device)
     );
 }
@@ -146,16 +393,19 @@ auto device::get_type() const -> types
 
 auto device::get_buttons() -> buttons*
 {
+    this->wait_inputs();
     return this->buttons_device.get();
 }
 
 auto device::get_touch() -> touch*
 {
+    this->wait_inputs();
     return this->touch_device.get();
 }
 
 auto device::get_pen() -> pen*
 {
+    this->wait_inputs();
     return this->pen_device.get();
 }
 
@@ -164,4 +414,35 @@ auto device::get_screen() -> screen*
     return this->screen_device.get();
 }
 
+auto device::get_probe_time() -> chrono::steady_clock::duration
+{
+    this->wait_inputs();
+    return this->probe_time;
+}
+
+void device::set_inputs(
+    std::unique_ptr<buttons>&& buttons_device,
+    std::unique_ptr<touch>&& touch_device,
+    std::unique_ptr<pen>&& pen_device
+)
+{
+    // Make sure that a pending discovery does not override the new inputs
+    this->wait_inputs();
+    this->buttons_device = std::move(buttons_device);
+    this->touch_device = std::move(touch_device);
+    this->pen_device = std::move(pen_device);
+}
+
+void device::wait_inputs()
+{
+    if (this->pending_inputs.valid())
+    {
+        auto inputs = this->pending_inputs.get();
+        this->buttons_device = std::move(inputs.buttons_device);
+        this->touch_device = std::move(inputs.touch_device);
+        this->pen_device = std::move(inputs.pen_device);
+        this->probe_time = inputs.probe_time;
+    }
+}
+
 } // namespace rmioc
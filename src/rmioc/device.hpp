@@ -20,15 +20,22 @@
 #include <boost/preprocessor/tuple/limits/to_seq_64.hpp>
 #include <boost/preprocessor/tuple/to_seq.hpp>
 #include <boost/preprocessor/variadic/limits/elem_64.hpp>
+#include <chrono>
+#include <future>
 #include <memory>
 
 namespace rmioc
 {
 
-/** Devices that can be opened. */
+/**
+ * Devices that can be opened.
+ *
+ * `staging` asks the screen to prepare updates off-screen before
+ * presenting them, when supported.
+ */
 RMIOC_FLAGS_DEFINE(
     device_request,
-    buttons, touch, pen, screen
+    buttons, touch, pen, screen, staging
 );
 
 /**
@@ -44,10 +51,26 @@ public:
      * Automatically detect the current device type and open the requested
      * input and output devices.
      *
+     * The screen is opened right away. Input devices are discovered in the
+     * background and the first call to an input accessor waits for the
+     * discovery to finish, so that it can overlap with the connection to
+     * the server. The capabilities of each input node are cached across
+     * runs until the node is recreated.
+     *
      * @param request Devices to open.
      */
     static device detect(device_request request);
 
+    /**
+     * Create a device that is not backed by any hardware.
+     *
+     * This is used for running the client on other machines. No input
+     * devices are available.
+     *
+     * @param screen_device Screen to draw to, usually a `screen_memory`.
+     */
+    static device headless(std::unique_ptr<screen>&& screen_device);
+
     /**
      * Supported devices.
      */
@@ -55,6 +78,7 @@ public:
     {
         reMarkable1 = 1,
         reMarkable2 = 2,
+        headless = 3,
     };
 
     /** Get what revision of the reMarkable we’re running on. */
@@ -72,6 +96,23 @@ public:
     /** Access the screen device, if possible. */
     screen* get_screen();
 
+    /** Get the time spent discovering input devices. */
+    std::chrono::steady_clock::duration get_probe_time();
+
+    /**
+     * Replace the input devices, for example with devices fed by a
+     * recording.
+     *
+     * @param buttons_device New buttons device, or null.
+     * @param touch_device New touch device, or null.
+     * @param pen_device New pen device, or null.
+     */
+    void set_inputs(
+        std::unique_ptr<buttons>&& buttons_device,
+        std::unique_ptr<touch>&& touch_device,
+        std::unique_ptr<pen>&& pen_device
+    );
+
 private:
     device(
         types type,
@@ -86,6 +127,26 @@ private:
     std::unique_ptr<touch> touch_device;
     std::unique_ptr<pen> pen_device;
     std::unique_ptr<screen> screen_device;
+
+    /** Input devices found by a discovery. */
+    struct input_set
+    {
+        std::unique_ptr<buttons> buttons_device;
+        std::unique_ptr<touch> touch_device;
+        std::unique_ptr<pen> pen_device;
+
+        /** Time spent in the discovery. */
+        std::chrono::steady_clock::duration probe_time{};
+    };
+
+    /** Discovery of input devices running in the background, if any. */
+    std::future<input_set> pending_inputs;
+
+    /** Time spent discovering input devices. */
+    std::chrono::steady_clock::duration probe_time{};
+
+    /** Wait for the discovery of input devices to finish, if pending. */
+    void wait_inputs();
 };
 
 } // namespace
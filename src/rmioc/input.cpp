@@ -1,6 +1,8 @@
 #include "input.hpp"
+#include "input_record.hpp"
 #include <array>
 #include <cerrno>
+#include <ctime>
 #include <iosfwd>
 #include <string>
 #include <stdexcept>
@@ -117,9 +119,40 @@ auto supported_abs_types(int input_fd) -> abs_types
     return result;
 }
 
+auto supported_capabilities(int input_fd) -> input_capabilities
+{
+    input_capabilities result;
+    result.events = supported_input_events(input_fd);
+
+    if (result.events.has_key())
+    {
+        result.keys = supported_key_types(input_fd);
+    }
+
+    if (result.events.has_abs())
+    {
+        result.axes = supported_abs_types(input_fd);
+    }
+
+    return result;
+}
+
 input::input(const char* device_path)
 // NOLINTNEXTLINE(hicpp-signed-bitwise)
 : input_fd(device_path, O_RDONLY | O_NONBLOCK)
+{
+    // Stamp events with the same clock as std::chrono::steady_clock instead
+    // of the wall clock. Older kernels keep the wall clock, whose times are
+    // still consistent with each other
+    int clock_id = CLOCK_MONOTONIC;
+    // NOLINTNEXTLINE(hicpp-signed-bitwise)
+    ioctl(this->input_fd, EVIOCSCLOCKID, &clock_id);
+}
+
+input::input(file_descriptor&& input_fd, axis_limits limits)
+: input_fd(std::move(input_fd))
+, limits(std::move(limits))
+, fixed_limits(true)
 {
 }
 
@@ -129,23 +162,66 @@ void input::setup_poll(pollfd& in_pollfd) const
     in_pollfd.events = POLLIN;
 }
 
-constexpr std::size_t read_events_batch_size = 64;
+auto input::get_known_axis_limits() const -> const axis_limits&
+{
+    return this->limits;
+}
+
+void input::set_recorder(input_recorder* recorder, std::uint8_t index)
+{
+    this->recorder = recorder;
+    this->recorder_index = index;
+}
+
+auto input::has_pending_events() const -> bool
+{
+    return this->unread_begin < this->unread_end;
+}
+
+auto input::get_report_time() const -> std::chrono::steady_clock::time_point
+{
+    return this->report_time;
+}
 
 auto input::fetch_events() -> std::vector<input_event>
 {
     std::vector<input_event> result;
-    std::array<input_event, read_events_batch_size> read_events{};
 
     constexpr auto one_bytes = sizeof(input_event);
-    constexpr auto max_bytes = read_events_batch_size * one_bytes;
-    ssize_t maybe_read_bytes = 0;
-
-    while ((maybe_read_bytes = read(
-        this->input_fd,
-        read_events.data(),
-        max_bytes
-    )) != -1)
+    constexpr auto max_bytes = read_batch_size * one_bytes;
+
+    while (true)
     {
+        // Consume events left from the previous read first
+        while (this->unread_begin < this->unread_end)
+        {
+            const auto& event = this->unread_events.at(this->unread_begin);
+            ++this->unread_begin;
+
+            if (event.type == EV_SYN)
+            {
+                this->report_time = std::chrono::steady_clock::time_point{
+                    std::chrono::seconds{event.time.tv_sec}
+                    + std::chrono::microseconds{event.time.tv_usec}
+                };
+                std::swap(this->queued_events, result);
+                return result;
+            }
+
+            this->queued_events.emplace_back(event);
+        }
+
+        ssize_t maybe_read_bytes = read(
+            this->input_fd,
+            this->unread_events.data(),
+            max_bytes
+        );
+
+        if (maybe_read_bytes == -1)
+        {
+            break;
+        }
+
         auto read_bytes = static_cast<std::size_t>(maybe_read_bytes);
 
         if (read_bytes < one_bytes)
@@ -157,18 +233,18 @@ auto input::fetch_events() -> std::vector<input_event>
             );
         }
 
-        std::size_t read_size = read_bytes / one_bytes;
-        this->queued_events.reserve(this->queued_events.size() + read_size);
+        this->unread_begin = 0;
+        this->unread_end = read_bytes / one_bytes;
 
-        for (std::size_t i = 0; i < read_size; ++i)
+        if (this->recorder != nullptr)
         {
-            if (read_events.at(i).type == EV_SYN)
+            for (std::size_t i = 0; i < this->unread_end; ++i)
             {
-                std::swap(this->queued_events, result);
-                return result;
+                this->recorder->record(
+                    this->recorder_index,
+                    this->unread_events.at(i)
+                );
             }
-
-            this->queued_events.emplace_back(read_events.at(i));
         }
     }
 
@@ -177,7 +253,7 @@ auto input::fetch_events() -> std::vector<input_event>
         throw std::system_error(
             errno,
             std::generic_category(),
-            "(rmioc::touch::fetch_events) Read touchscreen event"
+            "(rmioc::input::fetch_events) Read input event"
         );
     }
 
@@ -186,6 +262,21 @@ auto input::fetch_events() -> std::vector<input_event>
 
 auto input::get_axis_limits(unsigned int type) const -> std::pair<int, int>
 {
+    auto limits_it = this->limits.find(type);
+
+    if (limits_it != this->limits.end())
+    {
+        return limits_it->second;
+    }
+
+    if (this->fixed_limits)
+    {
+        throw std::runtime_error(
+            "(rmioc::input) Missing limits for axis "
+            + std::to_string(type)
+        );
+    }
+
     input_absinfo result{};
 
     // NOLINTNEXTLINE(hicpp-signed-bitwise)
@@ -198,7 +289,9 @@ auto input::get_axis_limits(unsigned int type) const -> std::pair<int, int>
         );
     }
 
-    return std::make_pair(result.minimum, result.maximum);
+    auto axis = std::make_pair(result.minimum, result.maximum);
+    this->limits.emplace(type, axis);
+    return axis;
 }
 
 } // namespace rmioc
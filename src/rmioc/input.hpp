@@ -3,6 +3,11 @@
 
 #include "flags.hpp"
 #include "file.hpp"
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
 #include <utility>
 #include <vector>
 #include <linux/input.h>
@@ -12,6 +17,8 @@ struct pollfd;
 namespace rmioc
 {
 
+class input_recorder;
+
 /** Available Linux input events. */
 RMIOC_FLAGS_DEFINE(
     input_events,
@@ -41,6 +48,24 @@ RMIOC_FLAGS_DEFINE(
 /** Get the set of absolute axes that are supported by a device. */
 abs_types supported_abs_types(int input_fd);
 
+/** Events, keys and axes supported by an input device. */
+struct input_capabilities
+{
+    input_events events;
+    key_types keys;
+    abs_types axes;
+};
+
+/**
+ * Get all the capabilities of a device.
+ *
+ * Keys and axes are only queried if the device emits the matching events.
+ */
+input_capabilities supported_capabilities(int input_fd);
+
+/** Minimum and maximum values of absolute axes, indexed by axis type. */
+using axis_limits = std::map<unsigned int, std::pair<int, int>>;
+
 /**
  * Generic class for reading Linux input devices.
  *
@@ -57,6 +82,18 @@ public:
      */
     input(const char* device_path);
 
+    /**
+     * Read input events from an already opened file.
+     *
+     * This allows reading events from sources other than an evdev device,
+     * such as pipes. Since those sources cannot be queried for axis limits,
+     * the limits of all axes used by the device must be given.
+     *
+     * @param input_fd File to read events from.
+     * @param limits Limits of the device axes.
+     */
+    input(file_descriptor&& input_fd, axis_limits limits);
+
     /**
      * Setup a pollfd structure to wait for events on the device.
      *
@@ -64,13 +101,49 @@ public:
      */
     void setup_poll(pollfd& in_pollfd) const;
 
+    /**
+     * Get the limits of all the axes that were queried so far.
+     *
+     * Devices query the limits of all the axes they use when created.
+     */
+    const axis_limits& get_known_axis_limits() const;
+
+    /**
+     * Pass all events read from the device to a recorder.
+     *
+     * @param recorder Recorder to use, or null to stop recording.
+     * @param index Index of this device in the recording.
+     */
+    void set_recorder(input_recorder* recorder, std::uint8_t index);
+
+    /**
+     * Check whether events already read from the device are waiting to be
+     * processed.
+     *
+     * Devices process a single report at a time, so that intermediate states
+     * are not lost when several reports are read at once. While this is true,
+     * processing must be called again even if the device is not readable.
+     */
+    bool has_pending_events() const;
+
+    /**
+     * Get the time at which the last fetched report was produced by the
+     * device, as stamped on its EV_SYN event.
+     *
+     * Evdev devices are switched to the monotonic clock so that this time
+     * can be compared with `std::chrono::steady_clock`. Sources that do not
+     * stamp their events report the zero time point.
+     */
+    std::chrono::steady_clock::time_point get_report_time() const;
+
 protected:
     /**
      * Fetch the next set of events from the device.
      *
      * If no EV_SYN event is available, queue existing events and return an
      * empty set. This function will not block if no events are available on
-     * the device.
+     * the device. Events read after the EV_SYN event are kept for the next
+     * call (see `has_pending_events()`).
      *
      * @return Next set of available events.
      */
@@ -90,6 +163,33 @@ private:
 
     /** List of queued events. */
     std::vector<input_event> queued_events;
+
+    /** Maximum number of events read at once. */
+    static constexpr std::size_t read_batch_size = 64;
+
+    /** Events read from the device but not yet returned. */
+    std::array<input_event, read_batch_size> unread_events{};
+
+    /** Index of the first unread event in `unread_events`. */
+    std::size_t unread_begin = 0;
+
+    /** Index past the last unread event in `unread_events`. */
+    std::size_t unread_end = 0;
+
+    /** Time stamped on the EV_SYN event of the last fetched report. */
+    std::chrono::steady_clock::time_point report_time{};
+
+    /** Limits of the axes queried so far. */
+    mutable axis_limits limits;
+
+    /** Whether limits were given instead of being queried from the device. */
+    bool fixed_limits = false;
+
+    /** Recorder receiving events read from the device, if any. */
+    input_recorder* recorder = nullptr;
+
+    /** Index of this device in the recording. */
+    std::uint8_t recorder_index = 0;
 }; // class input
 
 } // namespace rmioc
@@ -0,0 +1,444 @@
+#include "input_record.hpp"
+#include "buttons.hpp"
+#include "device.hpp"
+#include "pen.hpp"
+#include "touch.hpp"
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <climits>
+#include <cstddef>
+#include <ctime>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+namespace chrono = std::chrono;
+
+namespace
+{
+
+constexpr std::array<char, 8> magic{'V', 'N', 'S', 'E', 'E', 'I', 'N', '1'};
+
+constexpr long long micros_per_second = 1'000'000;
+
+/** Write a plain value to a binary stream. */
+template<typename T>
+void write_value(std::ostream& out, const T& value)
+{
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+/** Read a plain value from a binary stream. */
+template<typename T>
+auto read_value(std::istream& in) -> T
+{
+    T value{};
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    in.read(reinterpret_cast<char*>(&value), sizeof(value));
+
+    if (!in)
+    {
+        throw std::runtime_error{
+            "(rmioc::input_replay) Truncated input recording"};
+    }
+
+    return value;
+}
+
+/** Write the description of a recorded device. */
+void write_device(
+    std::ostream& out,
+    rmioc::input_kinds kind,
+    const rmioc::axis_limits& limits,
+    bool flip_x, bool flip_y
+)
+{
+    write_value(out, kind);
+    write_value(out, static_cast<std::uint8_t>(flip_x));
+    write_value(out, static_cast<std::uint8_t>(flip_y));
+    write_value(out, std::uint8_t{0});
+    write_value(out, static_cast<std::uint32_t>(limits.size()));
+
+    for (const auto& [type, axis] : limits)
+    {
+        write_value(out, static_cast<std::uint32_t>(type));
+        write_value(out, static_cast<std::int32_t>(axis.first));
+        write_value(out, static_cast<std::int32_t>(axis.second));
+    }
+}
+
+/** Create a pipe whose ends are both non-blocking. */
+auto make_pipe() -> std::pair<rmioc::file_descriptor, rmioc::file_descriptor>
+{
+    std::array<int, 2> fds{};
+
+    if (pipe2(fds.data(), O_NONBLOCK) == -1)
+    {
+        throw std::system_error(
+            errno,
+            std::generic_category(),
+            "(rmioc::input_replay) Create pipe"
+        );
+    }
+
+    return {rmioc::file_descriptor{fds[0]}, rmioc::file_descriptor{fds[1]}};
+}
+
+} // anonymous namespace
+
+namespace rmioc
+{
+
+input_recorder::input_recorder(const char* path, device& devices)
+: devices(devices)
+, out(path, std::ios::binary | std::ios::trunc)
+{
+    if (!this->out)
+    {
+        throw std::system_error(
+            errno,
+            std::generic_category(),
+            "(rmioc::input_recorder) Create recording file"
+        );
+    }
+
+    buttons* buttons_device = devices.get_buttons();
+    touch* touch_device = devices.get_touch();
+    pen* pen_device = devices.get_pen();
+
+    std::uint32_t count = static_cast<std::uint32_t>(buttons_device != nullptr)
+        + static_cast<std::uint32_t>(touch_device != nullptr)
+        + static_cast<std::uint32_t>(pen_device != nullptr);
+
+    this->out.write(magic.data(), magic.size());
+    write_value(this->out, count);
+    std::uint8_t index = 0;
+
+    if (buttons_device != nullptr)
+    {
+        write_device(
+            this->out, input_kinds::buttons,
+            buttons_device->get_known_axis_limits(),
+            /* flip_x = */ false, /* flip_y = */ false
+        );
+        buttons_device->set_recorder(this, index);
+        ++index;
+    }
+
+    if (touch_device != nullptr)
+    {
+        write_device(
+            this->out, input_kinds::touch,
+            touch_device->get_known_axis_limits(),
+            touch_device->is_flipped_x(), touch_device->is_flipped_y()
+        );
+        touch_device->set_recorder(this, index);
+        ++index;
+    }
+
+    if (pen_device != nullptr)
+    {
+        write_device(
+            this->out, input_kinds::pen,
+            pen_device->get_known_axis_limits(),
+            pen_device->is_flipped_x(), pen_device->is_flipped_y()
+        );
+        pen_device->set_recorder(this, index);
+        ++index;
+    }
+}
+
+input_recorder::~input_recorder()
+{
+    for (input* device : std::initializer_list<input*>{
+        this->devices.get_buttons(),
+        this->devices.get_touch(),
+        this->devices.get_pen(),
+    })
+    {
+        if (device != nullptr)
+        {
+            device->set_recorder(nullptr, 0);
+        }
+    }
+}
+
+void input_recorder::record(std::uint8_t index, const input_event& event)
+{
+    auto now = chrono::steady_clock::now();
+    std::uint32_t delay = 0;
+
+    if (this->started)
+    {
+        auto elapsed = chrono::duration_cast<chrono::microseconds>(
+            now - this->last_time).count();
+        delay = static_cast<std::uint32_t>(std::min<long long>(
+            elapsed, std::numeric_limits<std::uint32_t>::max()));
+    }
+
+    this->started = true;
+    this->last_time = now;
+
+    input_record record{};
+    record.delay = delay;
+    record.type = event.type;
+    record.code = event.code;
+    record.value = event.value;
+    record.device = index;
+    write_value(this->out, record);
+}
+
+input_replay::input_replay(const char* path, bool real_time)
+: real_time(real_time)
+{
+    std::ifstream in{path, std::ios::binary};
+
+    if (!in)
+    {
+        throw std::system_error(
+            errno,
+            std::generic_category(),
+            "(rmioc::input_replay) Open recording file"
+        );
+    }
+
+    std::array<char, magic.size()> file_magic{};
+    in.read(file_magic.data(), file_magic.size());
+
+    if (!in || file_magic != magic)
+    {
+        throw std::runtime_error{
+            "(rmioc::input_replay) Not an input recording"};
+    }
+
+    auto count = read_value<std::uint32_t>(in);
+
+    for (std::uint32_t i = 0; i < count; ++i)
+    {
+        auto kind = read_value<input_kinds>(in);
+        bool flip_x = read_value<std::uint8_t>(in) != 0;
+        bool flip_y = read_value<std::uint8_t>(in) != 0;
+        read_value<std::uint8_t>(in);
+
+        auto axes = read_value<std::uint32_t>(in);
+        axis_limits limits;
+
+        for (std::uint32_t j = 0; j < axes; ++j)
+        {
+            auto type = read_value<std::uint32_t>(in);
+            auto min = read_value<std::int32_t>(in);
+            auto max = read_value<std::int32_t>(in);
+            limits.emplace(type, std::make_pair(min, max));
+        }
+
+        auto [read_end, write_end] = make_pipe();
+        this->outputs.push_back(output{std::move(write_end), {}});
+
+        switch (kind)
+        {
+        case input_kinds::buttons:
+            this->buttons_device = std::make_unique<buttons>(
+                std::move(read_end));
+            break;
+
+        case input_kinds::touch:
+            this->touch_device = std::make_unique<touch>(
+                std::move(read_end), std::move(limits), flip_x, flip_y);
+            break;
+
+        case input_kinds::pen:
+            this->pen_device = std::make_unique<pen>(
+                std::move(read_end), std::move(limits), flip_x, flip_y);
+            break;
+
+        default:
+            throw std::runtime_error{
+                "(rmioc::input_replay) Unknown device kind "
+                + std::to_string(static_cast<int>(kind))};
+        }
+    }
+
+    input_record record{};
+
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    while (in.read(reinterpret_cast<char*>(&record), sizeof(record)))
+    {
+        if (record.device >= this->outputs.size())
+        {
+            throw std::runtime_error{
+                "(rmioc::input_replay) Event from unknown device "
+                + std::to_string(record.device)};
+        }
+
+        this->records.push_back(record);
+    }
+}
+
+auto input_replay::take_buttons() -> std::unique_ptr<buttons>
+{
+    return std::move(this->buttons_device);
+}
+
+auto input_replay::take_touch() -> std::unique_ptr<touch>
+{
+    return std::move(this->touch_device);
+}
+
+auto input_replay::take_pen() -> std::unique_ptr<pen>
+{
+    return std::move(this->pen_device);
+}
+
+auto input_replay::pump() -> long
+{
+    return this->pump(chrono::steady_clock::now());
+}
+
+auto input_replay::pump(chrono::steady_clock::time_point now) -> long
+{
+    if (!this->started)
+    {
+        this->started = true;
+        this->start = now;
+        this->next_time = now;
+    }
+
+    while (this->next < this->records.size())
+    {
+        const auto& record = this->records[this->next];
+
+        auto due = this->next_time + chrono::microseconds{record.delay};
+
+        if (this->real_time && due > now)
+        {
+            break;
+        }
+
+        this->next_time = due;
+
+        // Stamp events with their recorded timing, which handlers use to
+        // estimate the pen motion
+        auto stamp = chrono::duration_cast<chrono::microseconds>(
+            due.time_since_epoch()).count();
+
+        input_event event{};
+        event.time.tv_sec = static_cast<time_t>(stamp / micros_per_second);
+        event.time.tv_usec = static_cast<suseconds_t>(
+            stamp % micros_per_second);
+        event.type = record.type;
+        event.code = record.code;
+        event.value = record.value;
+        this->outputs[record.device].pending.push_back(event);
+        ++this->next;
+    }
+
+    this->flush();
+
+    for (const auto& out : this->outputs)
+    {
+        if (!out.pending.empty())
+        {
+            // Pipe is full, retry once the device has read some events
+            return 0;
+        }
+    }
+
+    if (this->next == this->records.size())
+    {
+        return -1;
+    }
+
+    auto due = this->next_time
+        + chrono::microseconds{this->records[this->next].delay};
+
+    return chrono::ceil<chrono::milliseconds>(due - now).count();
+}
+
+void input_replay::flush()
+{
+    // Writes of at most PIPE_BUF bytes are atomic, so sticking to whole
+    // events keeps devices from reading partial events. Devices may read
+    // several reports at once, but process them one at a time
+    constexpr auto one_bytes = sizeof(input_event);
+    constexpr auto max_events = PIPE_BUF / one_bytes;
+
+    for (auto& out : this->outputs)
+    {
+        std::size_t written = 0;
+
+        while (written < out.pending.size())
+        {
+            std::size_t count = std::min(
+                max_events,
+                out.pending.size() - written
+            );
+
+            if (write(
+                out.pipe,
+                &out.pending[written],
+                count * one_bytes
+            ) == -1)
+            {
+                if (errno == EAGAIN)
+                {
+                    break;
+                }
+
+                throw std::system_error(
+                    errno,
+                    std::generic_category(),
+                    "(rmioc::input_replay) Write input events"
+                );
+            }
+
+            written += count;
+        }
+
+        out.pending.erase(
+            out.pending.begin(),
+            out.pending.begin() + static_cast<std::ptrdiff_t>(written)
+        );
+    }
+}
+
+auto input_replay::is_done() const -> bool
+{
+    if (this->next < this->records.size())
+    {
+        return false;
+    }
+
+    for (const auto& out : this->outputs)
+    {
+        int unread = 0;
+
+        if (!out.pending.empty()
+                || ioctl(out.pipe, FIONREAD, &unread) == -1
+                || unread > 0)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+auto input_replay::get_event_count() const -> std::size_t
+{
+    return this->records.size();
+}
+
+auto input_replay::get_elapsed() const -> chrono::steady_clock::duration
+{
+    return chrono::steady_clock::now() - this->start;
+}
+
+} // namespace rmioc
@@ -0,0 +1,209 @@
+#ifndef RMIOC_INPUT_RECORD_HPP
+#define RMIOC_INPUT_RECORD_HPP
+
+#include "file.hpp"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <vector>
+#include <linux/input.h>
+
+/*
+ * Input recordings are stored in host byte order with the following layout:
+ *
+ * - the magic string “VNSEEIN1”;
+ * - the number of recorded devices (32 bits);
+ * - for each device, its kind (8 bits, see `input_kinds`), whether it flips
+ *   X and Y coordinates (8 bits each), one unused byte, the number of axes
+ *   (32 bits) and for each axis its type, minimum and maximum (32 bits each);
+ * - one 16-byte `input_record` for each event.
+ */
+
+namespace rmioc
+{
+
+class buttons;
+class device;
+class pen;
+class touch;
+
+/** Kinds of input devices that can be recorded. */
+enum class input_kinds : std::uint8_t
+{
+    buttons = 0,
+    touch = 1,
+    pen = 2,
+};
+
+/** Recorded input event. */
+struct input_record
+{
+    /** Time elapsed since the previous event (in microseconds). */
+    std::uint32_t delay;
+
+    /** Event type. */
+    std::uint16_t type;
+
+    /** Event code. */
+    std::uint16_t code;
+
+    /** Event value. */
+    std::int32_t value;
+
+    /** Index of the device that emitted the event. */
+    std::uint8_t device;
+
+    /** Unused. */
+    std::uint8_t reserved[3];
+};
+
+static_assert(sizeof(input_record) == 16, "Unexpected input record size");
+
+/**
+ * Record the events read from the input devices to a file.
+ */
+class input_recorder
+{
+public:
+    /**
+     * Start recording events from all the input devices.
+     *
+     * @param path Path of the file to write.
+     * @param devices Devices to record.
+     * @throws std::system_error If the file cannot be created.
+     */
+    input_recorder(const char* path, device& devices);
+
+    /** Stop recording and flush the file. */
+    ~input_recorder();
+
+    input_recorder(const input_recorder& other) = delete;
+    input_recorder& operator=(const input_recorder& other) = delete;
+    input_recorder(input_recorder&& other) = delete;
+    input_recorder& operator=(input_recorder&& other) = delete;
+
+    /**
+     * Add an event to the recording.
+     *
+     * @param index Index of the device that emitted the event.
+     * @param event Event to record.
+     */
+    void record(std::uint8_t index, const input_event& event);
+
+private:
+    /** Recorded devices. */
+    device& devices;
+
+    /** Recording file. */
+    std::ofstream out;
+
+    /** Time at which the last event was recorded. */
+    std::chrono::steady_clock::time_point last_time;
+
+    /** Whether at least one event was recorded. */
+    bool started = false;
+}; // class input_recorder
+
+/**
+ * Feed recorded events to input devices.
+ *
+ * Events are written to pipes from which the devices read, so that they go
+ * through the same parsing as events from the actual devices.
+ */
+class input_replay
+{
+public:
+    /**
+     * Load a recording.
+     *
+     * @param path Path of the recording file.
+     * @param real_time True to replay events at the recorded pace, false to
+     * replay them as fast as the devices can read them.
+     * @throws std::runtime_error If the file is not a valid recording.
+     */
+    input_replay(const char* path, bool real_time);
+
+    /** Get the buttons device fed by the recording, if any. */
+    std::unique_ptr<buttons> take_buttons();
+
+    /** Get the touchscreen device fed by the recording, if any. */
+    std::unique_ptr<touch> take_touch();
+
+    /** Get the pen device fed by the recording, if any. */
+    std::unique_ptr<pen> take_pen();
+
+    /**
+     * Write events that are due to the devices.
+     *
+     * Must be called regularly from the event loop.
+     *
+     * @return Time to wait before the next call (in milliseconds), 0 if some
+     * pipe is full and the call should be retried once the devices have
+     * read their events, or -1 if all events were written.
+     */
+    long pump();
+
+    /**
+     * Write events that are due at a given time to the devices.
+     *
+     * @param now Current time, which can come from a simulated clock as long
+     * as it is used consistently across calls.
+     * @return Same as `pump()`.
+     */
+    long pump(std::chrono::steady_clock::time_point now);
+
+    /** Check whether all events were written and read by the devices. */
+    bool is_done() const;
+
+    /** Get the number of recorded events. */
+    std::size_t get_event_count() const;
+
+    /** Get the time elapsed since the first event was written. */
+    std::chrono::steady_clock::duration get_elapsed() const;
+
+private:
+    /** Writing end of the pipe feeding a device. */
+    struct output
+    {
+        /** File descriptor of the pipe. */
+        file_descriptor pipe;
+
+        /** Events waiting for space in the pipe. */
+        std::vector<input_event> pending;
+    };
+
+    /** Whether to replay events at the recorded pace. */
+    bool real_time;
+
+    /** Recorded events. */
+    std::vector<input_record> records;
+
+    /** Index of the next event to write. */
+    std::size_t next = 0;
+
+    /** Pipe feeding each recorded device. */
+    std::vector<output> outputs;
+
+    /** Devices fed by the recording. */
+    std::unique_ptr<buttons> buttons_device;
+    std::unique_ptr<touch> touch_device;
+    std::unique_ptr<pen> pen_device;
+
+    /** Time at which the first event was written. */
+    std::chrono::steady_clock::time_point start;
+
+    /** Time at which the last replayed event was due. */
+    std::chrono::steady_clock::time_point next_time;
+
+    /** Whether the replay has started. */
+    bool started = false;
+
+    /** Write as many pending events as possible to the pipes. */
+    void flush();
+}; // class input_replay
+
+} // namespace rmioc
+
+#endif // RMIOC_INPUT_RECORD_HPP
@@ -112,7 +112,7 @@ struct update_data
     /** TODO: Find out what this is used for. */
     temps temp;
 
-    /** TODO: Find out what this is used for. */
+    /** Combination of update flags. */
     unsigned int flags;
 
     /** TODO: Find out what this is used for. */
@@ -121,7 +121,7 @@ struct update_data
     /** TODO: Find out what this is used for. */
     int quant_bit;
 
-    /** TODO: Find out what this is used for. */
+    /** Buffer to read the updated pixels from, with the alt buffer flag. */
     alt_buffer_data alt_buffer_data_;
 };
 
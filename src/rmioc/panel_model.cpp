@@ -0,0 +1,266 @@
+#include "panel_model.hpp"
+#include "../stats.hpp"
+#include <algorithm>
+#include <array>
+#include <ostream>
+#include <utility>
+
+namespace chrono = std::chrono;
+
+namespace
+{
+
+/** Convert a duration to fractional milliseconds. */
+auto to_millis(rmioc::panel_model::clock::duration duration) -> double
+{
+    return chrono::duration<double, std::milli>(duration).count();
+}
+
+} // anonymous namespace
+
+namespace rmioc
+{
+
+panel_model::panel_model(std::size_t max_concurrent)
+: max_concurrent(std::max<std::size_t>(max_concurrent, 1))
+{}
+
+auto panel_model::get_duration(waveform_modes mode) -> clock::duration
+{
+    // Durations documented in `waveform_modes`
+    switch (mode)
+    {
+    case waveform_modes::init:
+        return chrono::milliseconds{2000};
+
+    case waveform_modes::du:
+        return chrono::milliseconds{260};
+
+    case waveform_modes::gc16:
+    case waveform_modes::gl16:
+        return chrono::milliseconds{450};
+
+    case waveform_modes::a2:
+        return chrono::milliseconds{120};
+    }
+
+    return chrono::milliseconds{450};
+}
+
+auto panel_model::region::overlaps(const region& other) const -> bool
+{
+    return this->x < other.x + other.w && other.x < this->x + this->w
+        && this->y < other.y + other.h && other.y < this->y + this->h;
+}
+
+auto panel_model::region::contains(const region& other) const -> bool
+{
+    return this->x <= other.x && this->y <= other.y
+        && other.x + other.w <= this->x + this->w
+        && other.y + other.h <= this->y + this->h;
+}
+
+void panel_model::damage(clock::time_point time, int x, int y, int w, int h)
+{
+    this->pending.push_back(this->damages.size());
+    this->damages.push_back(damage_record{time, region{x, y, w, h}, {}});
+}
+
+void panel_model::submit(
+    clock::time_point time,
+    int x, int y, int w, int h,
+    waveform_modes mode
+)
+{
+    region area{x, y, w, h};
+
+    // Forget about updates that are complete
+    this->active.erase(
+        std::remove_if(
+            this->active.begin(), this->active.end(),
+            [this, time](std::size_t index)
+            {
+                return this->updates[index].end <= time;
+            }
+        ),
+        this->active.end()
+    );
+
+    // Wait for colliding updates to complete
+    clock::time_point start = time;
+
+    for (auto index : this->active)
+    {
+        if (this->updates[index].area.overlaps(area))
+        {
+            start = std::max(start, this->updates[index].end);
+        }
+    }
+
+    // Wait for a free slot
+    while (true)
+    {
+        std::size_t running = 0;
+        clock::time_point first_end = clock::time_point::max();
+
+        for (auto index : this->active)
+        {
+            const auto& other = this->updates[index];
+
+            if (other.start <= start && start < other.end)
+            {
+                ++running;
+                first_end = std::min(first_end, other.end);
+            }
+        }
+
+        if (running < this->max_concurrent)
+        {
+            break;
+        }
+
+        start = first_end;
+    }
+
+    clock::time_point end = start + get_duration(mode);
+    this->active.push_back(this->updates.size());
+    this->updates.push_back(scheduled_update{time, start, end, area, mode});
+
+    // Damaged regions covered by this update are visible once it completes
+    this->pending.erase(
+        std::remove_if(
+            this->pending.begin(), this->pending.end(),
+            [this, &area, end](std::size_t index)
+            {
+                auto& record = this->damages[index];
+
+                if (area.contains(record.area))
+                {
+                    record.visible = end;
+                    return true;
+                }
+
+                return false;
+            }
+        ),
+        this->pending.end()
+    );
+}
+
+void panel_model::write_report(std::ostream& out) const
+{
+    clock::time_point origin = clock::time_point::max();
+    clock::time_point last_end = clock::time_point::min();
+    std::array<std::size_t, waveform_mode_count> mode_counts{};
+    std::vector<std::pair<clock::time_point, clock::time_point>> intervals;
+    std::vector<clock::duration> queue_delays;
+    clock::duration total_duration{0};
+
+    for (const auto& update : this->updates)
+    {
+        origin = std::min(origin, update.submitted);
+        last_end = std::max(last_end, update.end);
+        intervals.emplace_back(update.start, update.end);
+        queue_delays.push_back(update.start - update.submitted);
+        total_duration += update.end - update.start;
+
+        auto mode = static_cast<std::size_t>(update.mode);
+
+        if (mode < mode_counts.size())
+        {
+            ++mode_counts.at(mode);
+        }
+    }
+
+    for (const auto& record : this->damages)
+    {
+        origin = std::min(origin, record.time);
+    }
+
+    // Compute the time during which at least one update was running
+    std::sort(intervals.begin(), intervals.end());
+    clock::duration busy{0};
+    clock::time_point busy_until = clock::time_point::min();
+
+    for (auto [start, end] : intervals)
+    {
+        start = std::max(start, busy_until);
+
+        if (start < end)
+        {
+            busy += end - start;
+            busy_until = end;
+        }
+    }
+
+    clock::duration span = this->updates.empty()
+        ? clock::duration{0}
+        : last_end - origin;
+
+    std::vector<clock::duration> visible_delays;
+
+    for (const auto& record : this->damages)
+    {
+        if (record.visible.has_value())
+        {
+            visible_delays.push_back(*record.visible - record.time);
+        }
+    }
+
+    out << "{\"max_concurrent\":" << this->max_concurrent
+        << ",\"updates\":" << this->updates.size()
+        << ",\"waveforms\":{";
+
+    for (std::size_t mode = 0; mode < waveform_mode_count; ++mode)
+    {
+        if (mode > 0)
+        {
+            out << ',';
+        }
+
+        out << '"' << get_waveform_name(static_cast<waveform_modes>(mode))
+            << "\":" << mode_counts.at(mode);
+    }
+
+    out << "},\"span_ms\":" << to_millis(span)
+        << ",\"utilisation\":"
+        << (span.count() > 0 ? to_millis(busy) / to_millis(span) : 0)
+        << ",\"mean_concurrency\":"
+        << (span.count() > 0 ? to_millis(total_duration) / to_millis(span) : 0)
+        << ",\"queue_delay\":";
+    stats::write_distribution(out, queue_delays);
+    out << ",\"time_to_visible\":";
+    stats::write_distribution(out, visible_delays);
+    out << ",\"pending_damage\":" << this->pending.size()
+        << ",\"damage\":[";
+
+    for (std::size_t i = 0; i < this->damages.size(); ++i)
+    {
+        const auto& record = this->damages[i];
+
+        if (i > 0)
+        {
+            out << ',';
+        }
+
+        out << "\n{\"time_ms\":" << to_millis(record.time - origin)
+            << ",\"x\":" << record.area.x << ",\"y\":" << record.area.y
+            << ",\"w\":" << record.area.w << ",\"h\":" << record.area.h
+            << ",\"visible_ms\":";
+
+        if (record.visible.has_value())
+        {
+            out << to_millis(*record.visible - record.time);
+        }
+        else
+        {
+            out << "null";
+        }
+
+        out << '}';
+    }
+
+    out << "\n]}\n";
+}
+
+} // namespace rmioc
@@ -0,0 +1,152 @@
+#ifndef RMIOC_PANEL_MODEL_HPP
+#define RMIOC_PANEL_MODEL_HPP
+
+#include "screen.hpp"
+#include <chrono>
+#include <cstddef>
+#include <iosfwd>
+#include <optional>
+#include <vector>
+
+namespace rmioc
+{
+
+/**
+ * Timing model of an e-ink display controller.
+ *
+ * This is used with `screen_memory` to evaluate how repaint policies would
+ * behave on an actual panel. The model follows the main constraints of the
+ * i.MX EPDC:
+ *
+ * - each update lasts the duration of its waveform (see `waveform_modes`);
+ * - only a limited number of updates can run at the same time, further
+ *   updates wait for a running one to complete;
+ * - an update that overlaps a running or waiting update collides with it
+ *   and only starts once it is complete.
+ *
+ * Updates are scheduled in submission order as soon as they are submitted.
+ */
+class panel_model
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    /** Number of concurrent updates supported by the i.MX EPDC. */
+    static constexpr std::size_t default_max_concurrent = 16;
+
+    /**
+     * Create a panel model.
+     *
+     * @param max_concurrent Maximum number of updates running at once.
+     */
+    explicit panel_model(std::size_t max_concurrent = default_max_concurrent);
+
+    /** Get the time needed to run a waveform. */
+    static clock::duration get_duration(waveform_modes mode);
+
+    /**
+     * Register a region whose contents changed and must be displayed.
+     *
+     * The region becomes visible at the end of the first update submitted
+     * afterwards that covers it.
+     *
+     * @param time Time at which the change happened.
+     * @param x Left bound of the region (in pixels).
+     * @param y Top bound of the region (in pixels).
+     * @param w Width of the region (in pixels).
+     * @param h Height of the region (in pixels).
+     */
+    void damage(clock::time_point time, int x, int y, int w, int h);
+
+    /**
+     * Submit an update to the panel.
+     *
+     * @param time Time at which the update is submitted.
+     * @param x Left bound of the region to update (in pixels).
+     * @param y Top bound of the region to update (in pixels).
+     * @param w Width of the region to update (in pixels).
+     * @param h Height of the region to update (in pixels).
+     * @param mode Waveform mode of the update.
+     */
+    void submit(
+        clock::time_point time,
+        int x, int y, int w, int h,
+        waveform_modes mode
+    );
+
+    /**
+     * Write a summary of the simulation and the delay before each damaged
+     * region was visible, as JSON.
+     *
+     * Reported utilisation is the fraction of time during which at least
+     * one update was running.
+     */
+    void write_report(std::ostream& out) const;
+
+private:
+    /** Rectangular region of the screen. */
+    struct region
+    {
+        int x;
+        int y;
+        int w;
+        int h;
+
+        /** Check whether two regions have pixels in common. */
+        bool overlaps(const region& other) const;
+
+        /** Check whether this region contains another one. */
+        bool contains(const region& other) const;
+    };
+
+    /** Update that was scheduled on the panel. */
+    struct scheduled_update
+    {
+        /** Time at which the update was submitted. */
+        clock::time_point submitted;
+
+        /** Time at which the panel starts running the update. */
+        clock::time_point start;
+
+        /** Time at which the update is complete. */
+        clock::time_point end;
+
+        /** Updated region. */
+        region area;
+
+        /** Waveform mode of the update. */
+        waveform_modes mode;
+    };
+
+    /** Region waiting to be displayed. */
+    struct damage_record
+    {
+        /** Time at which the region changed. */
+        clock::time_point time;
+
+        /** Changed region. */
+        region area;
+
+        /** Time at which the change was visible, if it is. */
+        std::optional<clock::time_point> visible;
+    };
+
+    /** Maximum number of updates running at once. */
+    std::size_t max_concurrent;
+
+    /** All scheduled updates in submission order. */
+    std::vector<scheduled_update> updates;
+
+    /** Indices of updates that were not complete at the last submission. */
+    std::vector<std::size_t> active;
+
+    /** All registered damaged regions in registration order. */
+    std::vector<damage_record> damages;
+
+    /** Indices of damaged regions that are not yet covered by an update. */
+    std::vector<std::size_t> pending;
+}; // class panel_model
+
+} // namespace rmioc
+
+#endif // RMIOC_PANEL_MODEL_HPP
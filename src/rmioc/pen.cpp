@@ -1,6 +1,6 @@
 #include "pen.hpp"
+#include <utility>
 #include <vector>
-#include <fcntl.h>
 #include <linux/input-event-codes.h>
 #include <linux/input.h>
 
@@ -24,18 +24,30 @@ pen::pen(const char* device_path, bool flip_x, bool flip_y)
 , tilt_y_limits(this->get_axis_limits(ABS_TILT_X))
 {}
 
-auto pen::is(const char* device_path) -> bool
-{
-    file_descriptor input_fd{device_path, O_RDONLY};
-    auto supp_events = supported_input_events(input_fd);
+pen::pen(
+    file_descriptor&& input_fd, axis_limits limits,
+    bool flip_x, bool flip_y
+)
+: input(std::move(input_fd), std::move(limits))
+, flip_x(flip_x)
+, flip_y(flip_y)
+, x_limits(this->get_axis_limits(ABS_Y))
+, y_limits(this->get_axis_limits(ABS_X))
+, pressure_limits(this->get_axis_limits(ABS_PRESSURE))
+, distance_limits(this->get_axis_limits(ABS_DISTANCE))
+, tilt_x_limits(this->get_axis_limits(ABS_TILT_Y))
+, tilt_y_limits(this->get_axis_limits(ABS_TILT_X))
+{}
 
-    if (!supp_events.has_key() || !supp_events.has_abs())
+auto pen::is(const input_capabilities& capabilities) -> bool
+{
+    if (!capabilities.events.has_key() || !capabilities.events.has_abs())
     {
         return false;
     }
 
-    auto supp_keys = supported_key_types(input_fd);
-    auto supp_axes = supported_abs_types(input_fd);
+    const auto& supp_keys = capabilities.keys;
+    const auto& supp_axes = capabilities.axes;
 
     return (
         supp_keys.has_tool_pen()
@@ -107,11 +119,9 @@ auto pen::process_events() -> bool
                 break;
             }
         }
-
-        return true;
     }
 
-    return false;
+    return !events.empty();
 }
 
 auto pen::get_state() const -> const pen::pen_state&
@@ -129,6 +139,16 @@ auto pen::get_yres() const -> int
     return this->y_limits.second - this->x_limits.first;
 }
 
+auto pen::is_flipped_x() const -> bool
+{
+    return this->flip_x;
+}
+
+auto pen::is_flipped_y() const -> bool
+{
+    return this->flip_y;
+}
+
 auto pen::get_pressure_res() const -> int
 {
     return this->pressure_limits.second - this->pressure_limits.first;
@@ -43,11 +43,24 @@ public:
      */
     pen(const char* device_path, bool flip_x = false, bool flip_y = false);
 
+    /**
+     * Read pen digitizer events from an already opened file.
+     *
+     * @param input_fd File to read events from.
+     * @param limits Limits of the device axes.
+     * @param flip_x True to flip coordinates horizontally.
+     * @param flip_y True to flip coordinates vertically.
+     */
+    pen(
+        file_descriptor&& input_fd, axis_limits limits,
+        bool flip_x = false, bool flip_y = false
+    );
+
     /** Check if an input device is a pen digitizer device. */
-    static bool is(const char* device_path);
+    static bool is(const input_capabilities& capabilities);
 
     /**
-     * Check for new events.
+     * Process the next report of events, if any.
      *
      * @return True if the pen state changed since last call.
      */
@@ -136,6 +149,12 @@ public:
      */
     const std::pair<int, int>& get_tilt_y_limits() const;
 
+    /** Check whether coordinates are flipped horizontally. */
+    bool is_flipped_x() const;
+
+    /** Check whether coordinates are flipped vertically. */
+    bool is_flipped_y() const;
+
 private:
     /** Coordinate flipping state. */
     bool flip_x;
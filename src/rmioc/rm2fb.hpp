@@ -0,0 +1,60 @@
+#ifndef RMIOC_RM2FB_HPP
+#define RMIOC_RM2FB_HPP
+
+#include "mxcfb.hpp"
+#include <array>
+#include <cstddef>
+
+namespace rm2fb
+{
+
+/**
+ * Messages understood by the rm2fb server on its update message queue.
+ *
+ * See <https://github.com/ddvk/remarkable2-framebuffer>.
+ */
+
+/** Path of the shared memory framebuffer. */
+constexpr const char* default_shm_path = "/swtfb.01";
+
+/** Key of the update message queue. */
+constexpr int default_msgqueue_key = 0x2257c;
+
+/** Size of the screen (in pixels) and of its pixels (in bytes). */
+constexpr int screen_width = 1404;
+constexpr int screen_height = 1872;
+constexpr int screen_depth = 2;
+
+enum class message_types : long
+{
+    init = 1,
+    update,
+    xochitl,
+
+    /**
+     * Post a named semaphore once all updates sent before this message
+     * are complete.
+     */
+    wait_update,
+};
+
+/** Maximum length of a semaphore name in wait messages. */
+constexpr std::size_t semaphore_name_size = 512;
+
+struct message
+{
+    message_types message_type;
+
+    union
+    {
+        /** Update to perform, for `message_types::update`. */
+        mxcfb::update_data update;
+
+        /** Semaphore to post, for `message_types::wait_update`. */
+        std::array<char, semaphore_name_size> semaphore_name;
+    } data;
+};
+
+}
+
+#endif // RMIOC_RM2FB_HPP
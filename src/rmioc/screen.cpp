@@ -3,9 +3,38 @@
 namespace rmioc
 {
 
+auto get_waveform_name(waveform_modes mode) -> const char*
+{
+    switch (mode)
+    {
+    case waveform_modes::init: return "init";
+    case waveform_modes::du: return "du";
+    case waveform_modes::gc16: return "gc16";
+    case waveform_modes::gl16: return "gl16";
+    case waveform_modes::a2: return "a2";
+    }
+
+    return "";
+}
+
 auto component_format::max() const -> std::uint32_t
 {
     return (1U << this->length) - 1;
 }
 
+auto screen::track_completions() -> int
+{
+    return -1;
+}
+
+auto screen::take_completions() -> std::vector<update_completion>
+{
+    return {};
+}
+
+auto screen::flush_updates() -> long
+{
+    return -1;
+}
+
 } // namespace rmioc
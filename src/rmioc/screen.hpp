@@ -1,7 +1,10 @@
 #ifndef RMIOC_SCREEN_HPP
 #define RMIOC_SCREEN_HPP
 
+#include <chrono>
+#include <cstddef>
 #include <cstdint>
+#include <vector>
 
 namespace rmioc
 {
@@ -89,6 +92,45 @@ enum class waveform_modes : std::uint32_t
     a2 = 4,
 };
 
+/** Number of waveform modes, which are numbered from zero. */
+constexpr std::size_t waveform_mode_count = 5;
+
+/** Get the lowercase name of a waveform mode. */
+const char* get_waveform_name(waveform_modes mode);
+
+/**
+ * Report of a screen update that finished being displayed.
+ */
+struct update_completion
+{
+    /** Left bound of the updated region (in pixels). */
+    int x;
+
+    /** Top bound of the updated region (in pixels). */
+    int y;
+
+    /** Width of the updated region (in pixels). */
+    int w;
+
+    /** Height of the updated region (in pixels). */
+    int h;
+
+    /** Waveform mode of the update. */
+    waveform_modes mode;
+
+    /** Time at which the update was submitted. */
+    std::chrono::steady_clock::time_point submitted;
+
+    /** Time at which the update was reported complete. */
+    std::chrono::steady_clock::time_point completed;
+
+    /**
+     * Whether the device confirmed the completion. If false, waiting for
+     * the update timed out and it is only assumed to be complete.
+     */
+    bool confirmed;
+}; // struct update_completion
+
 /**
  * Abstract class for accessing the device screen.
  */
@@ -162,6 +204,32 @@ public:
 
     /** Get packing information about the blue pixel component. */
     virtual component_format get_blue_format() const = 0;
+
+    /**
+     * Start reporting the completion of updates without blocking.
+     *
+     * Only updates sent afterwards are reported. Reporting stops after the
+     * first update that is not confirmed to complete in time.
+     *
+     * @return File descriptor that becomes readable when completions are
+     * available (see `take_completions()`), or -1 if this screen cannot
+     * report completions.
+     */
+    virtual int track_completions();
+
+    /**
+     * Get the updates that completed since the last call, in submission
+     * order.
+     */
+    virtual std::vector<update_completion> take_completions();
+
+    /**
+     * Submit updates that were deferred because the device was busy.
+     *
+     * @return Time after which to call this again (in milliseconds), or
+     * -1 if no update is deferred anymore.
+     */
+    virtual long flush_updates();
 }; // class screen
 
 } // namespace rmioc
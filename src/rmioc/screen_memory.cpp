@@ -0,0 +1,470 @@
+#include "screen_memory.hpp"
+#include "mxcfb.hpp"
+#include "panel_model.hpp"
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <fstream>
+#include <system_error>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace chrono = std::chrono;
+
+namespace
+{
+
+constexpr auto screen_depth = 2;
+
+/** Compute the lookup table for CRC-32 checksums used by PNG chunks. */
+auto make_crc_table() -> std::array<std::uint32_t, 256>
+{
+    constexpr std::uint32_t polynomial = 0xEDB88320U;
+    std::array<std::uint32_t, 256> table{};
+
+    for (std::uint32_t n = 0; n < table.size(); ++n)
+    {
+        std::uint32_t value = n;
+
+        for (int k = 0; k < 8; ++k)
+        {
+            value = (value & 1U) != 0 ? polynomial ^ (value >> 1U) : value >> 1U;
+        }
+
+        table.at(n) = value;
+    }
+
+    return table;
+}
+
+/** Compute the CRC-32 of a PNG chunk type and contents. */
+auto png_crc(const char* type, const std::vector<std::uint8_t>& data)
+-> std::uint32_t
+{
+    static const auto table = make_crc_table();
+    std::uint32_t crc = 0xFFFFFFFFU;
+
+    auto add_byte = [&crc](std::uint8_t byte)
+    {
+        crc = table.at((crc ^ byte) & 0xFFU) ^ (crc >> 8U);
+    };
+
+    for (int i = 0; i < 4; ++i)
+    {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        add_byte(static_cast<std::uint8_t>(type[i]));
+    }
+
+    for (auto byte : data)
+    {
+        add_byte(byte);
+    }
+
+    return crc ^ 0xFFFFFFFFU;
+}
+
+/** Append a big-endian 32-bit integer to a byte buffer. */
+void push_u32(std::vector<std::uint8_t>& out, std::uint32_t value)
+{
+    // NOLINTNEXTLINE(cppcoreguidelines-avoid-magic-numbers)
+    for (int shift = 24; shift >= 0; shift -= 8)
+    {
+        out.push_back(static_cast<std::uint8_t>(value >> shift));
+    }
+}
+
+/** Write a PNG chunk. */
+void write_chunk(
+    std::ostream& out,
+    const char* type,
+    const std::vector<std::uint8_t>& data
+)
+{
+    std::vector<std::uint8_t> header;
+    push_u32(header, data.size());
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    header.insert(header.end(), type, type + 4);
+
+    std::vector<std::uint8_t> footer;
+    push_u32(footer, png_crc(type, data));
+
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    out.write(reinterpret_cast<const char*>(header.data()), header.size());
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    out.write(reinterpret_cast<const char*>(data.data()), data.size());
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    out.write(reinterpret_cast<const char*>(footer.data()), footer.size());
+}
+
+/**
+ * Wrap data in a zlib stream without compressing it.
+ *
+ * Snapshots are meant for debugging, so using uncompressed deflate blocks
+ * avoids depending on a compression library.
+ */
+auto zlib_store(const std::vector<std::uint8_t>& data)
+-> std::vector<std::uint8_t>
+{
+    constexpr std::size_t max_block = 0xFFFF;
+    constexpr std::uint32_t adler_mod = 65521;
+
+    std::vector<std::uint8_t> result{0x78, 0x01};
+    result.reserve(data.size() + data.size() / max_block * 5 + 16);
+
+    std::size_t offset = 0;
+
+    do
+    {
+        std::size_t length = std::min(max_block, data.size() - offset);
+        bool last = offset + length == data.size();
+
+        result.push_back(last ? 1 : 0);
+        result.push_back(length & 0xFFU);
+        result.push_back(length >> 8U);
+        result.push_back(~length & 0xFFU);
+        result.push_back((~length >> 8U) & 0xFFU);
+        result.insert(
+            result.end(),
+            data.begin() + offset,
+            data.begin() + offset + length
+        );
+
+        offset += length;
+    }
+    while (offset < data.size());
+
+    std::uint32_t adler_a = 1;
+    std::uint32_t adler_b = 0;
+
+    for (auto byte : data)
+    {
+        adler_a = (adler_a + byte) % adler_mod;
+        adler_b = (adler_b + adler_a) % adler_mod;
+    }
+
+    push_u32(result, (adler_b << 16U) | adler_a);
+    return result;
+}
+
+/** Expand a packed pixel component to 8 bits. */
+auto expand_component(
+    std::uint32_t pixel,
+    const rmioc::component_format& format
+) -> std::uint8_t
+{
+    constexpr std::uint32_t max_value = 255;
+    std::uint32_t max = format.max();
+    std::uint32_t value = (pixel >> format.offset) & max;
+    return static_cast<std::uint8_t>(value * max_value / max);
+}
+
+} // anonymous namespace
+
+namespace rmioc
+{
+
+screen_memory::screen_memory(int xres, int yres, const char* framebuf_path)
+: xres(xres)
+, yres(yres)
+, framebuf_len(static_cast<std::size_t>(xres) * yres * screen_depth)
+, creation_time(chrono::steady_clock::now())
+{
+    void* mmap_res = nullptr;
+
+    if (framebuf_path == nullptr)
+    {
+        mmap_res = mmap(
+            /* addr = */ nullptr,
+            /* len = */ this->framebuf_len,
+            // NOLINTNEXTLINE(hicpp-signed-bitwise): Use of C library
+            /* prot = */ PROT_READ | PROT_WRITE,
+            // NOLINTNEXTLINE(hicpp-signed-bitwise): Use of C library
+            /* flags = */ MAP_PRIVATE | MAP_ANONYMOUS,
+            /* fd = */ -1,
+            /* __offset = */ 0
+        );
+    }
+    else
+    {
+        // NOLINTNEXTLINE(hicpp-signed-bitwise,cppcoreguidelines-pro-type-vararg): Use of C library
+        int framebuf_fd = open(framebuf_path, O_RDWR | O_CREAT, 0644);
+
+        if (framebuf_fd == -1)
+        {
+            throw std::system_error(
+                errno,
+                std::generic_category(),
+                "(rmioc::screen_memory) Open framebuffer file"
+            );
+        }
+
+        if (ftruncate(framebuf_fd, this->framebuf_len) == -1)
+        {
+            int error = errno;
+            close(framebuf_fd);
+            throw std::system_error(
+                error,
+                std::generic_category(),
+                "(rmioc::screen_memory) Resize framebuffer file"
+            );
+        }
+
+        mmap_res = mmap(
+            /* addr = */ nullptr,
+            /* len = */ this->framebuf_len,
+            // NOLINTNEXTLINE(hicpp-signed-bitwise): Use of C library
+            /* prot = */ PROT_READ | PROT_WRITE,
+            /* flags = */ MAP_SHARED,
+            /* fd = */ framebuf_fd,
+            /* __offset = */ 0
+        );
+
+        // The mapping stays valid after the file is closed
+        close(framebuf_fd);
+    }
+
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-cstyle-cast,performance-no-int-to-ptr)
+    if (mmap_res == MAP_FAILED)
+    {
+        throw std::system_error(
+            errno,
+            std::generic_category(),
+            "(rmioc::screen_memory) Map framebuffer to memory"
+        );
+    }
+
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast): Use of C library
+    this->framebuf_ptr = reinterpret_cast<std::uint8_t*>(mmap_res);
+}
+
+screen_memory::~screen_memory()
+{
+    if (this->framebuf_ptr != nullptr)
+    {
+        munmap(this->framebuf_ptr, this->framebuf_len);
+    }
+}
+
+screen_memory::screen_memory(screen_memory&& other) noexcept
+: xres(other.xres)
+, yres(other.yres)
+, framebuf_len(other.framebuf_len)
+, framebuf_ptr(std::exchange(other.framebuf_ptr, nullptr))
+, creation_time(other.creation_time)
+, updates(std::move(other.updates))
+, panel(std::exchange(other.panel, nullptr))
+{}
+
+auto screen_memory::operator=(screen_memory&& other) noexcept
+-> screen_memory&
+{
+    if (this->framebuf_ptr != nullptr)
+    {
+        munmap(this->framebuf_ptr, this->framebuf_len);
+    }
+
+    this->xres = other.xres;
+    this->yres = other.yres;
+    this->framebuf_len = other.framebuf_len;
+    this->framebuf_ptr = std::exchange(other.framebuf_ptr, nullptr);
+    this->creation_time = other.creation_time;
+    this->updates = std::move(other.updates);
+    this->panel = std::exchange(other.panel, nullptr);
+    return *this;
+}
+
+void screen_memory::update(
+    int x, int y, int w, int h, waveform_modes mode, bool wait)
+{
+    auto region = mxcfb::rect::clip(
+        x, y, w, h,
+        this->get_xres(), this->get_yres()
+    );
+
+    if (!region)
+    {
+        return;
+    }
+
+    this->record_update(update_record{
+        chrono::steady_clock::now(),
+        static_cast<int>(region.left), static_cast<int>(region.top),
+        static_cast<int>(region.width), static_cast<int>(region.height),
+        mode, /* full = */ false, wait
+    });
+}
+
+void screen_memory::update(waveform_modes mode, bool wait)
+{
+    this->record_update(update_record{
+        chrono::steady_clock::now(),
+        0, 0, this->get_xres(), this->get_yres(),
+        mode, /* full = */ true, wait
+    });
+}
+
+void screen_memory::record_update(const update_record& record)
+{
+    this->updates.push_back(record);
+
+    if (this->panel != nullptr)
+    {
+        this->panel->submit(
+            record.time,
+            record.x, record.y, record.w, record.h,
+            record.mode
+        );
+    }
+}
+
+void screen_memory::set_panel_model(panel_model* model)
+{
+    this->panel = model;
+}
+
+auto screen_memory::get_updates() const -> const std::vector<update_record>&
+{
+    return this->updates;
+}
+
+void screen_memory::write_updates(const char* path) const
+{
+    std::ofstream out{path, std::ios::trunc};
+    out << "time_us,x,y,w,h,waveform,full,wait\n";
+
+    for (const auto& record : this->updates)
+    {
+        out << chrono::duration_cast<chrono::microseconds>(
+                record.time - this->creation_time).count()
+            << ',' << record.x << ',' << record.y
+            << ',' << record.w << ',' << record.h
+            << ',' << static_cast<std::uint32_t>(record.mode)
+            << ',' << record.full << ',' << record.wait << '\n';
+    }
+
+    out.close();
+
+    if (!out)
+    {
+        throw std::system_error(
+            errno,
+            std::generic_category(),
+            "(rmioc::screen_memory::write_updates) Write update log"
+        );
+    }
+}
+
+void screen_memory::write_png(const char* path) const
+{
+    constexpr std::array<std::uint8_t, 8> signature{
+        0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'
+    };
+
+    // Image header: 8-bit RGB, no interlacing
+    std::vector<std::uint8_t> header;
+    push_u32(header, this->xres);
+    push_u32(header, this->yres);
+    header.insert(header.end(), {8, 2, 0, 0, 0});
+
+    // Image data: each row is prefixed with a “none” filter type
+    constexpr auto channels = 3;
+    auto red = this->get_red_format();
+    auto green = this->get_green_format();
+    auto blue = this->get_blue_format();
+
+    std::vector<std::uint8_t> pixels;
+    pixels.reserve(
+        static_cast<std::size_t>(this->yres) * (this->xres * channels + 1));
+
+    for (int y = 0; y < this->yres; ++y)
+    {
+        pixels.push_back(0);
+
+        for (int x = 0; x < this->xres; ++x)
+        {
+            std::size_t offset = (
+                static_cast<std::size_t>(y) * this->xres + x
+            ) * screen_depth;
+
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+            std::uint32_t pixel = this->framebuf_ptr[offset]
+                // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+                | (this->framebuf_ptr[offset + 1] << 8U);
+
+            pixels.push_back(expand_component(pixel, red));
+            pixels.push_back(expand_component(pixel, green));
+            pixels.push_back(expand_component(pixel, blue));
+        }
+    }
+
+    std::ofstream out{path, std::ios::binary | std::ios::trunc};
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    out.write(reinterpret_cast<const char*>(signature.data()), signature.size());
+    write_chunk(out, "IHDR", header);
+    write_chunk(out, "IDAT", zlib_store(pixels));
+    write_chunk(out, "IEND", {});
+    out.close();
+
+    if (!out)
+    {
+        throw std::system_error(
+            errno,
+            std::generic_category(),
+            "(rmioc::screen_memory::write_png) Write snapshot"
+        );
+    }
+}
+
+auto screen_memory::get_data() -> std::uint8_t*
+{
+    return this->framebuf_ptr;
+}
+
+auto screen_memory::get_xres() const -> int
+{
+    return this->xres;
+}
+
+auto screen_memory::get_xres_memory() const -> int
+{
+    return this->xres;
+}
+
+auto screen_memory::get_yres() const -> int
+{
+    return this->yres;
+}
+
+auto screen_memory::get_yres_memory() const -> int
+{
+    return this->yres;
+}
+
+auto screen_memory::get_bits_per_pixel() const -> unsigned short
+{
+    // NOLINTNEXTLINE(cppcoreguidelines-avoid-magic-numbers)
+    return screen_depth * 8;
+}
+
+auto screen_memory::get_red_format() const -> component_format
+{
+    // NOLINTNEXTLINE(cppcoreguidelines-avoid-magic-numbers)
+    return component_format{/* offset = */ 11, /* length = */ 5};
+}
+
+auto screen_memory::get_green_format() const -> component_format
+{
+    // NOLINTNEXTLINE(cppcoreguidelines-avoid-magic-numbers)
+    return component_format{/* offset = */ 5, /* length = */ 6};
+}
+
+auto screen_memory::get_blue_format() const -> component_format
+{
+    // NOLINTNEXTLINE(cppcoreguidelines-avoid-magic-numbers)
+    return component_format{/* offset = */ 0, /* length = */ 5};
+}
+
+} // namespace rmioc
@@ -0,0 +1,153 @@
+#ifndef RMIOC_SCREEN_MEMORY_HPP
+#define RMIOC_SCREEN_MEMORY_HPP
+
+#include "screen.hpp"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace rmioc
+{
+
+class panel_model;
+
+/**
+ * Screen backed by a plain memory buffer.
+ *
+ * This allows running the client on machines other than the reMarkable,
+ * for example to profile it. Pixels use the same RGB565 format as the
+ * reMarkable screens. Updates are not displayed anywhere but are recorded
+ * so that they can be inspected afterwards.
+ */
+class screen_memory : public screen
+{
+public:
+    /**
+     * Create an in-memory screen.
+     *
+     * @param xres Number of pixels in each row.
+     * @param yres Number of rows.
+     * @param framebuf_path If not null, path to a file in which to map the
+     * pixel buffer, so that other processes can watch it. The file is
+     * created if needed and resized to fit the buffer.
+     */
+    screen_memory(int xres, int yres, const char* framebuf_path = nullptr);
+
+    /** Release the pixel buffer. */
+    ~screen_memory();
+
+    // Disallow copying screen device handles
+    screen_memory(const screen_memory& other) = delete;
+    screen_memory& operator=(const screen_memory& other) = delete;
+
+    // Transfer handle ownership
+    screen_memory(screen_memory&& other) noexcept;
+    screen_memory& operator=(screen_memory&& other) noexcept;
+
+    void update(
+        int x, int y, int w, int h,
+        waveform_modes mode = waveform_modes::gc16,
+        bool wait = false) override;
+
+    void update(
+        waveform_modes mode = waveform_modes::gc16,
+        bool wait = true) override;
+
+    std::uint8_t* get_data() override;
+
+    int get_xres() const override;
+    int get_xres_memory() const override;
+    int get_yres() const override;
+    int get_yres_memory() const override;
+
+    unsigned short get_bits_per_pixel() const override;
+    component_format get_red_format() const override;
+    component_format get_green_format() const override;
+    component_format get_blue_format() const override;
+
+    /** Information about a requested screen update. */
+    struct update_record
+    {
+        /** Time at which the update was requested. */
+        std::chrono::steady_clock::time_point time;
+
+        /** Left bound of the updated region (in pixels). */
+        int x;
+
+        /** Top bound of the updated region (in pixels). */
+        int y;
+
+        /** Width of the updated region (in pixels). */
+        int w;
+
+        /** Height of the updated region (in pixels). */
+        int h;
+
+        /** Requested waveform mode. */
+        waveform_modes mode;
+
+        /** Whether this is a full update. */
+        bool full;
+
+        /** Whether the caller asked to wait for completion. */
+        bool wait;
+    };
+
+    /** Get the list of updates requested since creation. */
+    const std::vector<update_record>& get_updates() const;
+
+    /**
+     * Write the list of requested updates as CSV.
+     *
+     * Times are given in microseconds since the screen was created.
+     *
+     * @param path Path of the file to write.
+     * @throws std::system_error If the file cannot be written.
+     */
+    void write_updates(const char* path) const;
+
+    /**
+     * Submit all subsequent updates to a simulated panel.
+     *
+     * @param model Panel to submit updates to, or null to stop.
+     */
+    void set_panel_model(panel_model* model);
+
+    /**
+     * Write the current screen contents as a PNG image.
+     *
+     * @param path Path of the file to write.
+     * @throws std::system_error If the file cannot be written.
+     */
+    void write_png(const char* path) const;
+
+private:
+    /** Number of pixels in each row. */
+    int xres;
+
+    /** Number of rows. */
+    int yres;
+
+    /** Size of the pixel buffer in bytes. */
+    std::size_t framebuf_len;
+
+    /** Pointer to the pixel buffer. */
+    std::uint8_t* framebuf_ptr = nullptr;
+
+    /** Time at which the screen was created. */
+    std::chrono::steady_clock::time_point creation_time;
+
+    /** Requested updates. */
+    std::vector<update_record> updates;
+
+    /** Simulated panel receiving updates, if any. */
+    panel_model* panel = nullptr;
+
+    /** Store an update and forward it to the simulated panel. */
+    void record_update(const update_record& record);
+}; // class screen_memory
+
+} // namespace rmioc
+
+#endif // RMIOC_SCREEN_MEMORY_HPP
@@ -1,7 +1,12 @@
 #include "screen_mxcfb.hpp"
 #include "mxcfb.hpp"
+#include "update_tracker.hpp"
 #include <cerrno>
+#include <climits>
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
+#include <memory>
 #include <system_error>
 #include <utility>
 #include <fcntl.h>
@@ -12,7 +17,7 @@
 namespace rmioc
 {
 
-screen_mxcfb::screen_mxcfb(const char* device_path)
+screen_mxcfb::screen_mxcfb(const char* device_path, bool staging)
 // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg): Use of C library
 : framebuf_fd(open(device_path, O_RDWR))
 {
@@ -75,10 +80,27 @@ screen_mxcfb::screen_mxcfb(const char* device_path)
 
     // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast): Use of C library
     this->framebuf_ptr = reinterpret_cast<uint8_t*>(mmap_res);
+
+    const auto& info = this->framebuf_varinfo;
+
+    if (staging && info.yoffset == 0 && info.yres_virtual >= 2 * info.yres)
+    {
+        // Start from the current screen contents
+        this->staging_row = info.yres;
+        std::memcpy(
+            this->get_data(),
+            this->framebuf_ptr,
+            static_cast<std::size_t>(info.yres)
+                * this->framebuf_fixinfo.line_length
+        );
+    }
 }
 
 screen_mxcfb::~screen_mxcfb()
 {
+    // Stop waiting for updates before closing the device
+    this->tracker.reset();
+
     if (this->framebuf_ptr != nullptr)
     {
         munmap(this->framebuf_ptr, this->framebuf_fixinfo.smem_len);
@@ -95,11 +117,15 @@ screen_mxcfb::screen_mxcfb(screen_mxcfb&& other) noexcept
 , framebuf_varinfo(other.framebuf_varinfo)
 , framebuf_fixinfo(other.framebuf_fixinfo)
 , framebuf_ptr(std::exchange(other.framebuf_ptr, nullptr))
+, staging_row(other.staging_row)
 , next_update_marker(other.next_update_marker)
+, tracker(std::move(other.tracker))
 {}
 
 auto screen_mxcfb::operator=(screen_mxcfb&& other) noexcept -> screen_mxcfb&
 {
+    this->tracker.reset();
+
     if (this->framebuf_ptr != nullptr)
     {
         munmap(this->framebuf_ptr, this->framebuf_fixinfo.smem_len);
@@ -114,7 +140,9 @@ auto screen_mxcfb::operator=(screen_mxcfb&& other) noexcept -> screen_mxcfb&
     this->framebuf_varinfo = other.framebuf_varinfo;
     this->framebuf_fixinfo = other.framebuf_fixinfo;
     this->framebuf_ptr = std::exchange(other.framebuf_ptr, nullptr);
+    this->staging_row = other.staging_row;
     this->next_update_marker = other.next_update_marker;
+    this->tracker = std::move(other.tracker);
     return *this;
 }
 
@@ -158,6 +186,13 @@ void screen_mxcfb::send_update(mxcfb::update_data& update, bool wait)
 
     update.update_marker = this->next_update_marker;
 
+    if (this->staging_row != 0)
+    {
+        // Present from the visible rows, which then stay unchanged until
+        // the next update while new data is decoded to the staging area
+        this->copy_staged(update.update_region);
+    }
+
     // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg): Use of C library
     if (ioctl(this->framebuf_fd, mxcfb::send_update, &update) == -1)
     {
@@ -168,25 +203,53 @@ void screen_mxcfb::send_update(mxcfb::update_data& update, bool wait)
         );
     }
 
-    if (!wait)
+    if (this->tracker)
     {
-        return;
+        int framebuf_fd = this->framebuf_fd;
+        std::uint32_t marker = this->next_update_marker;
+
+        this->tracker->track(
+            static_cast<int>(update.update_region.left),
+            static_cast<int>(update.update_region.top),
+            static_cast<int>(update.update_region.width),
+            static_cast<int>(update.update_region.height),
+            update.waveform_mode,
+            [framebuf_fd, marker]()
+            {
+                mxcfb::update_marker_data data{};
+                data.update_marker = marker;
+                data.collision_test = 0;
+
+                // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg): Use of C library
+                return ioctl(
+                    framebuf_fd,
+                    mxcfb::wait_for_update_complete,
+                    &data
+                ) != -1;
+            }
+        );
     }
 
-    mxcfb::update_marker_data data{};
-    data.update_marker = this->next_update_marker;
-    data.collision_test = 0;
-
-    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg): Use of C library
-    if (ioctl(this->framebuf_fd, mxcfb::wait_for_update_complete, &data) == -1)
+    if (wait)
     {
-        throw std::system_error(
-            errno,
-            std::generic_category(),
-            "(rmioc::screen_mxcfb::send_update) Wait for update completion"
-        );
+        mxcfb::update_marker_data data{};
+        data.update_marker = this->next_update_marker;
+        data.collision_test = 0;
+
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg): Use of C library
+        if (ioctl(this->framebuf_fd, mxcfb::wait_for_update_complete, &data)
+                == -1)
+        {
+            throw std::system_error(
+                errno,
+                std::generic_category(),
+                "(rmioc::screen_mxcfb::send_update) Wait for update completion"
+            );
+        }
     }
 
+    // Markers identify updates to wait for and must be unique among
+    // pending updates
     if (this->next_update_marker == rmioc::screen_mxcfb::max_update_marker)
     {
         this->next_update_marker = 1;
@@ -197,9 +260,52 @@ void screen_mxcfb::send_update(mxcfb::update_data& update, bool wait)
     }
 }
 
+void screen_mxcfb::copy_staged(const mxcfb::rect& region)
+{
+    std::size_t stride = this->framebuf_fixinfo.line_length;
+    std::size_t pixel_size = this->framebuf_varinfo.bits_per_pixel / CHAR_BIT;
+    std::size_t offset = region.left * pixel_size;
+    std::size_t size = region.width * pixel_size;
+
+    for (std::uint32_t row = region.top; row < region.top + region.height;
+            ++row)
+    {
+        std::memcpy(
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+            this->framebuf_ptr + row * stride + offset,
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+            this->framebuf_ptr + (this->staging_row + row) * stride + offset,
+            size
+        );
+    }
+}
+
+auto screen_mxcfb::track_completions() -> int
+{
+    if (!this->tracker)
+    {
+        this->tracker = std::make_unique<update_tracker>();
+    }
+
+    return this->tracker->get_fd();
+}
+
+auto screen_mxcfb::take_completions() -> std::vector<update_completion>
+{
+    if (!this->tracker)
+    {
+        return {};
+    }
+
+    return this->tracker->take();
+}
+
 auto screen_mxcfb::get_data() -> std::uint8_t*
 {
-    return this->framebuf_ptr;
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    return this->framebuf_ptr
+        + static_cast<std::size_t>(this->staging_row)
+            * this->framebuf_fixinfo.line_length;
 }
 
 auto screen_mxcfb::get_xres() const -> int
@@ -219,6 +325,12 @@ auto screen_mxcfb::get_yres() const -> int
 
 auto screen_mxcfb::get_yres_memory() const -> int
 {
+    // Rows below the staging area are left unused
+    if (this->staging_row != 0)
+    {
+        return static_cast<int>(this->framebuf_varinfo.yres);
+    }
+
     return static_cast<int>(this->framebuf_varinfo.yres_virtual);
 }
 
@@ -2,11 +2,15 @@
 #define RMIOC_SCREEN_MXCFB_HPP
 
 #include "screen.hpp"
+#include "update_tracker.hpp"
 #include <cstdint>
+#include <memory>
+#include <vector>
 #include <linux/fb.h>
 
 namespace mxcfb
 {
+    struct rect;
     struct update_data;
 }
 
@@ -18,6 +22,13 @@ namespace rmioc
  *
  * On reMarkable 1, screen access is exposed through the mxcfb framebuffer
  * driver, usually available at `/dev/fb0`.
+ *
+ * When staging is enabled, the memory returned by `get_data()` is a copy
+ * of the screen in the virtual rows of the framebuffer below the visible
+ * ones. Each updated region is copied to the visible rows right before it
+ * is presented, so that the visible rows, which the EPDC reads from while
+ * refreshing the panel, never contain half-decoded regions and later
+ * regions can be decoded while earlier ones are being refreshed.
  */
 class screen_mxcfb : public screen
 {
@@ -26,8 +37,10 @@ public:
      * Open the screen mxcfb device.
      *
      * @param path Path to the device.
+     * @param staging True to prepare updates in off-screen memory, if the
+     * framebuffer has enough virtual rows.
      */
-    screen_mxcfb(const char* device_path);
+    screen_mxcfb(const char* device_path, bool staging = false);
 
     /** Close the screen device. */
     ~screen_mxcfb();
@@ -61,6 +74,9 @@ public:
     component_format get_green_format() const override;
     component_format get_blue_format() const override;
 
+    int track_completions() override;
+    std::vector<update_completion> take_completions() override;
+
 private:
     /** File descriptor for the device framebuffer. */
     int framebuf_fd = -1;
@@ -74,6 +90,19 @@ private:
     /** Pointer to the memory-mapped framebuffer. */
     std::uint8_t* framebuf_ptr = nullptr;
 
+    /**
+     * First framebuffer row of the staging area, or 0 if updates are
+     * prepared directly in the visible rows.
+     */
+    std::uint32_t staging_row = 0;
+
+    /**
+     * Copy a region of the staging area to the visible rows.
+     *
+     * @param region Region to copy.
+     */
+    void copy_staged(const mxcfb::rect& region);
+
     /**
      * Send an update object to the mxcfb driver.
      *
@@ -87,6 +116,9 @@ private:
 
     /** Maximum value to use for update markers. */
     static constexpr std::uint32_t max_update_marker = 255;
+
+    /** Background waits for update completions, if enabled. */
+    std::unique_ptr<update_tracker> tracker;
 }; // class screen_mxcfb
 
 } // namespace rmioc
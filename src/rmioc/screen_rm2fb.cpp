@@ -1,40 +1,104 @@
 #include "screen_rm2fb.hpp"
 #include "mxcfb.hpp"
+#include "rm2fb.hpp"
+#include "update_tracker.hpp"
+#include <algorithm>
 #include <cerrno>
+#include <chrono>
+#include <cstddef>
 #include <cstdint>
+#include <iterator>
+#include <ctime>
+#include <string>
 #include <system_error>
 #include <utility>
 #include <fcntl.h>
+#include <semaphore.h>
 #include <sys/mman.h>
 #include <sys/msg.h>
 #include <unistd.h>
 
-namespace rm2fb
+namespace
 {
 
-enum class message_types : long
+using rm2fb::screen_width;
+using rm2fb::screen_height;
+using rm2fb::screen_depth;
+
+constexpr auto screen_mem_len = screen_width * screen_height * screen_depth;
+
+/**
+ * Time after which waiting for an update is abandoned (in seconds).
+ *
+ * This is longer than the slowest waveform, so that waits only time out
+ * if the server does not support them.
+ */
+constexpr std::time_t wait_timeout = 2;
+
+/** Time to wait before retrying to send deferred messages. */
+constexpr std::chrono::milliseconds retry_delay{4};
+
+/**
+ * Number of deferred messages above which sending blocks until the
+ * server catches up.
+ */
+constexpr std::size_t max_deferred_messages = 256;
+
+/**
+ * Wait for a semaphore to be posted.
+ *
+ * @return False if the semaphore was not posted before the timeout.
+ */
+auto wait_semaphore(sem_t* semaphore) -> bool
 {
-    init = 1,
-    update,
-    xochitl
-};
+    timespec deadline{};
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += wait_timeout;
+
+    while (sem_timedwait(semaphore, &deadline) == -1)
+    {
+        if (errno != EINTR)
+        {
+            return false;
+        }
+    }
 
-struct update_data
+    return true;
+}
+
+/** Check whether two screen rectangles share at least one pixel. */
+auto overlaps(const mxcfb::rect& first, const mxcfb::rect& second) -> bool
 {
-    message_types message_type;
-    mxcfb::update_data update;
-};
+    return first.left < second.left + second.width
+        && second.left < first.left + first.width
+        && first.top < second.top + second.height
+        && second.top < first.top + first.height;
+}
 
+/** Get the smallest screen rectangle containing two others. */
+auto bounding_rect(
+    const mxcfb::rect& first,
+    const mxcfb::rect& second
+) -> mxcfb::rect
+{
+    auto left = std::min(first.left, second.left);
+    auto top = std::min(first.top, second.top);
+    auto right = std::max(first.left + first.width, second.left + second.width);
+    auto bottom = std::max(first.top + first.height, second.top + second.height);
+
+    mxcfb::rect result{};
+    result.top = top;
+    result.left = left;
+    result.width = right - left;
+    result.height = bottom - top;
+    return result;
 }
 
+} // anonymous namespace
+
 namespace rmioc
 {
 
-constexpr auto screen_width = 1404;
-constexpr auto screen_height = 1872;
-constexpr auto screen_depth = 2;
-constexpr auto screen_mem_len = screen_width * screen_height * screen_depth;
-
 screen_rm2fb::screen_rm2fb(const char* shm_path, int msgqueue_key)
 {
     this->framebuf_fd = shm_open(shm_path, O_RDWR, 0);
@@ -85,6 +149,11 @@ screen_rm2fb::screen_rm2fb(const char* shm_path, int msgqueue_key)
 
 screen_rm2fb::~screen_rm2fb()
 {
+    // Stop waiting for updates before releasing the semaphores
+    this->tracker.reset();
+    this->wait_sem.close();
+    this->track_sem.close();
+
     if (this->framebuf_ptr != nullptr)
     {
         munmap(this->framebuf_ptr, screen_mem_len);
@@ -100,10 +169,18 @@ screen_rm2fb::screen_rm2fb(screen_rm2fb&& other) noexcept
 : framebuf_fd(std::exchange(other.framebuf_fd, -1))
 , msgqueue_id(std::exchange(other.msgqueue_id, -1))
 , framebuf_ptr(std::exchange(other.framebuf_ptr, nullptr))
+, wait_sem(std::exchange(other.wait_sem, {}))
+, track_sem(std::exchange(other.track_sem, {}))
+, tracker(std::move(other.tracker))
+, deferred(std::move(other.deferred))
 {}
 
 auto screen_rm2fb::operator=(screen_rm2fb&& other) noexcept -> screen_rm2fb&
 {
+    this->tracker.reset();
+    this->wait_sem.close();
+    this->track_sem.close();
+
     if (this->framebuf_ptr != nullptr)
     {
         munmap(this->framebuf_ptr, screen_mem_len);
@@ -117,9 +194,68 @@ auto screen_rm2fb::operator=(screen_rm2fb&& other) noexcept -> screen_rm2fb&
     this->framebuf_fd = std::exchange(other.framebuf_fd, -1);
     this->msgqueue_id = std::exchange(other.msgqueue_id, -1);
     this->framebuf_ptr = std::exchange(other.framebuf_ptr, nullptr);
+    this->wait_sem = std::exchange(other.wait_sem, {});
+    this->track_sem = std::exchange(other.track_sem, {});
+    this->tracker = std::move(other.tracker);
+    this->deferred = std::move(other.deferred);
     return *this;
 }
 
+void screen_rm2fb::semaphore::open(const char* suffix)
+{
+    if (this->handle != nullptr)
+    {
+        return;
+    }
+
+    this->name = "/rm2fb.wait." + std::to_string(getpid()) + suffix;
+
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg): Use of C library
+    this->handle = sem_open(this->name.c_str(), O_CREAT, 0644, 0);
+
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-cstyle-cast,performance-no-int-to-ptr)
+    if (this->handle == SEM_FAILED)
+    {
+        this->handle = nullptr;
+        throw std::system_error(
+            errno,
+            std::generic_category(),
+            "(rmioc::screen_rm2fb) Open completion semaphore"
+        );
+    }
+}
+
+void screen_rm2fb::semaphore::close()
+{
+    if (this->handle != nullptr)
+    {
+        sem_close(this->handle);
+        sem_unlink(this->name.c_str());
+        this->handle = nullptr;
+    }
+}
+
+auto screen_rm2fb::track_completions() -> int
+{
+    if (!this->tracker)
+    {
+        this->track_sem.open(".track");
+        this->tracker = std::make_unique<update_tracker>();
+    }
+
+    return this->tracker->get_fd();
+}
+
+auto screen_rm2fb::take_completions() -> std::vector<update_completion>
+{
+    if (!this->tracker)
+    {
+        return {};
+    }
+
+    return this->tracker->take();
+}
+
 void screen_rm2fb::update(
     int x, int y, int w, int h, waveform_modes mode, bool wait)
 {
@@ -151,27 +287,203 @@ void screen_rm2fb::update(waveform_modes mode, bool wait)
     this->send_update(update, wait);
 }
 
-void screen_rm2fb::send_update(mxcfb::update_data& update, bool /*wait*/) const
+void screen_rm2fb::send_update(mxcfb::update_data& update, bool wait)
 {
     if (!update.update_region)
     {
         return;
     }
 
-    rm2fb::update_data message{};
-    message.message_type = rm2fb::message_types::update;
-    message.update = update;
+    std::vector<update_completion> completions;
+    this->merge_deferred(update, completions);
+    bool tracking = this->tracker && !this->tracker->is_stopped();
 
-    if (msgsnd(this->msgqueue_id, &message, sizeof(message), 0) == -1)
+    if (tracking)
     {
-        throw std::system_error(
-            errno,
-            std::generic_category(),
-            "(rmioc::screen_rm2fb::send_update) Screen update"
+        completions.push_back(update_completion{
+            static_cast<int>(update.update_region.left),
+            static_cast<int>(update.update_region.top),
+            static_cast<int>(update.update_region.width),
+            static_cast<int>(update.update_region.height),
+            update.waveform_mode,
+            /* submitted = */ std::chrono::steady_clock::now(),
+            /* completed = */ {},
+            /* confirmed = */ false
+        });
+    }
+
+    deferred_message message{};
+    message.message.message_type = rm2fb::message_types::update;
+    message.message.data.update = update;
+    this->deferred.push_back(std::move(message));
+
+    // Waits are answered in order, after all previously sent updates
+    if (tracking)
+    {
+        this->deferred.push_back(deferred_message{
+            make_wait(this->track_sem),
+            std::move(completions)
+        });
+    }
+
+    if (wait)
+    {
+        this->send_deferred(/* block = */ true);
+        this->wait_sem.open("");
+        this->send_message(
+            make_wait(this->wait_sem),
+            /* block = */ true,
+            "(rmioc::screen_rm2fb::send_update) Wait for update completion"
         );
+        wait_semaphore(this->wait_sem.handle);
+    }
+    else if (!this->send_deferred(/* block = */ false)
+        && this->deferred.size() > max_deferred_messages)
+    {
+        // Stop accumulating if the server does not seem to make progress
+        this->send_deferred(/* block = */ true);
+    }
+}
+
+void screen_rm2fb::merge_deferred(
+    mxcfb::update_data& update,
+    std::vector<update_completion>& completions
+)
+{
+    auto& region = update.update_region;
+    auto it = this->deferred.begin();
+
+    while (it != this->deferred.end())
+    {
+        if (it->message.message_type != rm2fb::message_types::update)
+        {
+            ++it;
+            continue;
+        }
+
+        const auto& other = it->message.data.update;
+
+        if (other.waveform_mode != update.waveform_mode
+            || other.update_mode != update.update_mode
+            || other.temp != update.temp
+            || other.flags != update.flags
+            || !overlaps(other.update_region, region))
+        {
+            ++it;
+            continue;
+        }
+
+        region = bounding_rect(other.update_region, region);
+        it = this->deferred.erase(it);
+
+        // Tracked updates are each followed by their wait message
+        if (it != this->deferred.end()
+            && it->message.message_type == rm2fb::message_types::wait_update)
+        {
+            completions.insert(
+                completions.end(),
+                it->completions.begin(),
+                it->completions.end()
+            );
+            this->deferred.erase(it);
+        }
+
+        // The extended region may now overlap with updates already passed
+        it = this->deferred.begin();
     }
 }
 
+auto screen_rm2fb::send_deferred(bool block) -> bool
+{
+    while (!this->deferred.empty())
+    {
+        auto& front = this->deferred.front();
+
+        if (front.message.message_type == rm2fb::message_types::wait_update
+            && this->tracker->is_stopped())
+        {
+            // Late answers would be taken for those of later waits
+            this->deferred.pop_front();
+            continue;
+        }
+
+        if (!this->send_message(
+                front.message, block,
+                "(rmioc::screen_rm2fb::send_deferred) Send message"))
+        {
+            return false;
+        }
+
+        if (front.message.message_type == rm2fb::message_types::wait_update
+            && !front.completions.empty())
+        {
+            // All updates merged into the sent one complete with it
+            sem_t* handle = this->track_sem.handle;
+            this->tracker->track(
+                front.completions.front(),
+                [handle]() { return wait_semaphore(handle); }
+            );
+
+            for (auto merged = std::next(front.completions.begin());
+                    merged != front.completions.end();
+                    ++merged)
+            {
+                this->tracker->track(*merged, []() { return true; });
+            }
+        }
+
+        this->deferred.pop_front();
+    }
+
+    return true;
+}
+
+auto screen_rm2fb::flush_updates() -> long
+{
+    if (this->send_deferred(/* block = */ false))
+    {
+        return -1;
+    }
+
+    return retry_delay.count();
+}
+
+auto screen_rm2fb::make_wait(const semaphore& target) -> rm2fb::message
+{
+    rm2fb::message message{};
+    message.message_type = rm2fb::message_types::wait_update;
+    std::copy_n(
+        target.name.c_str(),
+        std::min(target.name.size() + 1, message.data.semaphore_name.size()),
+        message.data.semaphore_name.begin()
+    );
+    return message;
+}
+
+auto screen_rm2fb::send_message(
+    const rm2fb::message& message,
+    bool block,
+    const char* action
+) const -> bool
+{
+    while (msgsnd(
+            this->msgqueue_id, &message,
+            sizeof(message.data), block ? 0 : IPC_NOWAIT) == -1)
+    {
+        if (errno == EAGAIN && !block)
+        {
+            return false;
+        }
+
+        if (errno != EINTR)
+        {
+            throw std::system_error(errno, std::generic_category(), action);
+        }
+    }
+
+    return true;
+}
+
 auto screen_rm2fb::get_data() -> std::uint8_t*
 {
     return this->framebuf_ptr;
@@ -1,13 +1,15 @@
 #ifndef RMIOC_SCREEN_RM2FB_HPP
 #define RMIOC_SCREEN_RM2FB_HPP
 
+#include "rm2fb.hpp"
 #include "screen.hpp"
+#include "update_tracker.hpp"
 #include <cstdint>
-
-namespace mxcfb
-{
-    struct update_data;
-}
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+#include <semaphore.h>
 
 namespace rmioc
 {
@@ -19,6 +21,11 @@ namespace rmioc
  * must be controlled by software. This class connects to a running rm2fb
  * server that handles the driver logic.
  *
+ * Messages are sent without blocking. When the server falls behind and
+ * its message queue is full, updates are deferred until there is room
+ * again (see `flush_updates()`), and deferred updates that overlap with
+ * newer ones using the same waveform are merged into them.
+ *
  * See <https://github.com/ddvk/remarkable2-framebuffer>.
  */
 class screen_rm2fb : public screen
@@ -64,6 +71,10 @@ public:
     component_format get_green_format() const override;
     component_format get_blue_format() const override;
 
+    int track_completions() override;
+    std::vector<update_completion> take_completions() override;
+    long flush_updates() override;
+
 private:
     /** File descriptor for the shared memory framebuffer. */
     int framebuf_fd = -1;
@@ -74,13 +85,99 @@ private:
     /** Pointer to the memory-mapped framebuffer. */
     std::uint8_t* framebuf_ptr = nullptr;
 
+    /** Named semaphore posted by the server when updates complete. */
+    struct semaphore
+    {
+        /** Name under which the server can open the semaphore. */
+        std::string name;
+
+        /** Handle to the opened semaphore, or null if not opened yet. */
+        sem_t* handle = nullptr;
+
+        /**
+         * Create the semaphore, if needed.
+         *
+         * @param suffix Suffix to append to the name, which is unique to
+         * the current process.
+         */
+        void open(const char* suffix);
+
+        /** Close and remove the semaphore, if opened. */
+        void close();
+    };
+
+    /** Semaphore used for blocking waits. */
+    semaphore wait_sem;
+
+    /** Semaphore used for waits run in the background. */
+    semaphore track_sem;
+
+    /** Background waits for update completions, if enabled. */
+    std::unique_ptr<update_tracker> tracker;
+
+    /** Message that could not be sent yet. */
+    struct deferred_message
+    {
+        rm2fb::message message;
+
+        /**
+         * For wait messages on the tracking semaphore, updates to report
+         * complete when the semaphore is posted.
+         */
+        std::vector<update_completion> completions;
+    };
+
+    /** Messages waiting for room in the message queue, in order. */
+    std::deque<deferred_message> deferred;
+
     /**
-     * Send an update object to the mxcfb driver.
+     * Send an update object to the rm2fb server.
      *
      * @param update Update object to send.
      * @param wait True to wait until update is complete.
      */
-    void send_update(mxcfb::update_data& update, bool wait) const;
+    void send_update(mxcfb::update_data& update, bool wait);
+
+    /**
+     * Remove deferred updates that overlap with a new update using the
+     * same waveform and extend the new update to cover them.
+     *
+     * @param update New update to extend.
+     * @param completions Receives the completions to report for removed
+     * updates, if they are tracked.
+     */
+    void merge_deferred(
+        mxcfb::update_data& update,
+        std::vector<update_completion>& completions
+    );
+
+    /**
+     * Send deferred messages in order.
+     *
+     * @param block True to wait for room in the message queue.
+     * @return True if all deferred messages were sent.
+     */
+    bool send_deferred(bool block);
+
+    /**
+     * Create a message asking the server to post a semaphore once all
+     * updates sent before it are complete.
+     */
+    static rm2fb::message make_wait(const semaphore& target);
+
+    /**
+     * Send a message to the rm2fb server.
+     *
+     * @param message Message to send.
+     * @param block True to wait for room in the message queue.
+     * @param action Description of the action for error messages.
+     * @return False if the message queue is full and `block` is false.
+     */
+    bool send_message(
+        const rm2fb::message& message,
+        bool block,
+        const char* action
+    ) const;
 }; // class screen_rm2fb
 
 } // namespace rmioc
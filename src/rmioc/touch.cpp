@@ -1,6 +1,6 @@
 #include "touch.hpp"
+#include <utility>
 #include <vector>
-#include <fcntl.h>
 #include <linux/input-event-codes.h>
 #include <linux/input.h>
 
@@ -17,17 +17,27 @@ touch::touch(const char* device_path, bool flip_x, bool flip_y)
 , orientation_limits(this->get_axis_limits(ABS_MT_ORIENTATION))
 {}
 
-auto touch::is(const char* device_path) -> bool
-{
-    file_descriptor input_fd{device_path, O_RDONLY};
-    auto supp_events = supported_input_events(input_fd);
+touch::touch(
+    file_descriptor&& input_fd, axis_limits limits,
+    bool flip_x, bool flip_y
+)
+: input(std::move(input_fd), std::move(limits))
+, flip_x(flip_x)
+, flip_y(flip_y)
+, x_limits(this->get_axis_limits(ABS_MT_POSITION_X))
+, y_limits(this->get_axis_limits(ABS_MT_POSITION_Y))
+, pressure_limits(this->get_axis_limits(ABS_MT_PRESSURE))
+, orientation_limits(this->get_axis_limits(ABS_MT_ORIENTATION))
+{}
 
-    if (!supp_events.has_abs())
+auto touch::is(const input_capabilities& capabilities) -> bool
+{
+    if (!capabilities.events.has_abs())
     {
         return false;
     }
 
-    auto supp_axes = supported_abs_types(input_fd);
+    const auto& supp_axes = capabilities.axes;
 
     return (
         supp_axes.has_mt_slot()
@@ -88,11 +98,9 @@ auto touch::process_events() -> bool
                 break;
             }
         }
-
-        return true;
     }
 
-    return false;
+    return !events.empty();
 }
 
 auto touch::get_state() const -> const touch::touchpoints_state&
@@ -110,6 +118,16 @@ auto touch::get_yres() const -> int
     return this->y_limits.second - this->x_limits.first;
 }
 
+auto touch::is_flipped_x() const -> bool
+{
+    return this->flip_x;
+}
+
+auto touch::is_flipped_y() const -> bool
+{
+    return this->flip_y;
+}
+
 auto touch::get_pressure_res() const -> int
 {
     return this->pressure_limits.second - this->pressure_limits.first;
@@ -26,11 +26,24 @@ public:
      */
     touch(const char* device_path, bool flip_x = false, bool flip_y = false);
 
+    /**
+     * Read touchscreen events from an already opened file.
+     *
+     * @param input_fd File to read events from.
+     * @param limits Limits of the device axes.
+     * @param flip_x True to flip coordinates horizontally.
+     * @param flip_y True to flip coordinates vertically.
+     */
+    touch(
+        file_descriptor&& input_fd, axis_limits limits,
+        bool flip_x = false, bool flip_y = false
+    );
+
     /** Check if an input device is a touchscreen device. */
-    static bool is(const char* device_path);
+    static bool is(const input_capabilities& capabilities);
 
     /**
-     * Check for new events.
+     * Process the next report of events, if any.
      *
      * @return True if touch state changed since last call.
      */
@@ -92,6 +105,12 @@ public:
     /** Get the minimum and maximum possible values of the orientation axis. */
     const std::pair<int, int>& get_orientation_limits() const;
 
+    /** Check whether coordinates are flipped horizontally. */
+    bool is_flipped_x() const;
+
+    /** Check whether coordinates are flipped vertically. */
+    bool is_flipped_y() const;
+
 private:
     /** Coordinate flipping state. */
     bool flip_x;
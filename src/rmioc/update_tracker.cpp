@@ -0,0 +1,148 @@
+#include "update_tracker.hpp"
+#include <cerrno>
+#include <cstdint>
+#include <system_error>
+#include <utility>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace chrono = std::chrono;
+
+namespace rmioc
+{
+
+update_tracker::update_tracker()
+// NOLINTNEXTLINE(hicpp-signed-bitwise): Use of C library
+: event_fd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+{
+    if (this->event_fd == -1)
+    {
+        throw std::system_error(
+            errno,
+            std::generic_category(),
+            "(rmioc::update_tracker) Create event descriptor"
+        );
+    }
+
+    this->worker = std::thread{&update_tracker::run, this};
+}
+
+update_tracker::~update_tracker()
+{
+    {
+        std::lock_guard<std::mutex> guard{this->lock};
+        this->stopping = true;
+    }
+
+    this->wake.notify_one();
+    this->worker.join();
+    close(this->event_fd);
+}
+
+void update_tracker::track(
+    int x, int y, int w, int h,
+    waveform_modes mode,
+    wait_function wait
+)
+{
+    this->track(
+        update_completion{
+            x, y, w, h, mode,
+            /* submitted = */ chrono::steady_clock::now(),
+            /* completed = */ {},
+            /* confirmed = */ false
+        },
+        std::move(wait)
+    );
+}
+
+void update_tracker::track(update_completion update, wait_function wait)
+{
+    update.completed = {};
+    update.confirmed = false;
+
+    {
+        std::lock_guard<std::mutex> guard{this->lock};
+
+        if (this->stopped)
+        {
+            return;
+        }
+
+        this->pending.push_back(pending_update{update, std::move(wait)});
+    }
+
+    this->wake.notify_one();
+}
+
+auto update_tracker::is_stopped() -> bool
+{
+    std::lock_guard<std::mutex> guard{this->lock};
+    return this->stopped;
+}
+
+auto update_tracker::get_fd() const -> int
+{
+    return this->event_fd;
+}
+
+auto update_tracker::take() -> std::vector<update_completion>
+{
+    // Reset the descriptor before taking completions so that none is missed
+    std::uint64_t count = 0;
+
+    if (read(this->event_fd, &count, sizeof(count)) == -1 && errno != EAGAIN)
+    {
+        throw std::system_error(
+            errno,
+            std::generic_category(),
+            "(rmioc::update_tracker::take) Reset event descriptor"
+        );
+    }
+
+    std::lock_guard<std::mutex> guard{this->lock};
+    return std::exchange(this->done, {});
+}
+
+void update_tracker::run()
+{
+    std::unique_lock<std::mutex> guard{this->lock};
+
+    while (true)
+    {
+        this->wake.wait(guard, [this]()
+        {
+            return this->stopping || !this->pending.empty();
+        });
+
+        if (this->stopping)
+        {
+            return;
+        }
+
+        auto update = std::move(this->pending.front());
+        this->pending.pop_front();
+
+        // Let updates be submitted while waiting
+        guard.unlock();
+        update.completion.confirmed = update.wait();
+        update.completion.completed = chrono::steady_clock::now();
+        guard.lock();
+
+        this->done.push_back(update.completion);
+
+        if (!update.completion.confirmed)
+        {
+            this->stopped = true;
+            this->pending.clear();
+        }
+
+        // Writing can only fail if the counter overflows, which would take
+        // billions of updates
+        std::uint64_t count = 1;
+        [[maybe_unused]] auto written
+            = write(this->event_fd, &count, sizeof(count));
+    }
+}
+
+} // namespace rmioc
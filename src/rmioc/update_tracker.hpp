@@ -0,0 +1,127 @@
+#ifndef RMIOC_UPDATE_TRACKER_HPP
+#define RMIOC_UPDATE_TRACKER_HPP
+
+#include "screen.hpp"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace rmioc
+{
+
+/**
+ * Wait for the completion of screen updates in the background.
+ *
+ * Screen drivers can usually only wait for an update by blocking. This
+ * runs such waits in submission order on a worker thread and signals a
+ * file descriptor that can be polled from the event loop when updates
+ * complete.
+ *
+ * A wait that times out means that the device does not answer waits, or
+ * answers them late, in which case the following answers could be taken
+ * for those of later updates. Tracking stops after the first timeout: the
+ * update is reported as unconfirmed and the other pending waits are
+ * dropped.
+ */
+class update_tracker
+{
+public:
+    /**
+     * Block until an update is complete.
+     *
+     * @return False if the wait timed out.
+     */
+    using wait_function = std::function<bool()>;
+
+    /** Start the worker thread. */
+    update_tracker();
+
+    /** Stop the worker thread, abandoning pending waits. */
+    ~update_tracker();
+
+    // Disallow copying and moving, the worker refers to this instance
+    update_tracker(const update_tracker& other) = delete;
+    update_tracker& operator=(const update_tracker& other) = delete;
+    update_tracker(update_tracker&& other) = delete;
+    update_tracker& operator=(update_tracker&& other) = delete;
+
+    /**
+     * Track an update that was just submitted.
+     *
+     * Ignored once tracking stopped (see `is_stopped()`).
+     *
+     * @param x Left bound of the updated region (in pixels).
+     * @param y Top bound of the updated region (in pixels).
+     * @param w Width of the updated region (in pixels).
+     * @param h Height of the updated region (in pixels).
+     * @param mode Waveform mode of the update.
+     * @param wait Function to call from the worker thread to wait for
+     * the update to complete.
+     */
+    void track(
+        int x, int y, int w, int h,
+        waveform_modes mode,
+        wait_function wait
+    );
+
+    /**
+     * Track an update that may have been submitted earlier.
+     *
+     * @param update Region, waveform mode and submission time of the
+     * update. Other fields are ignored.
+     * @param wait Function to call from the worker thread to wait for
+     * the update to complete.
+     */
+    void track(update_completion update, wait_function wait);
+
+    /** Check whether tracking stopped after a wait timed out. */
+    bool is_stopped();
+
+    /** Get the file descriptor that is readable when updates complete. */
+    int get_fd() const;
+
+    /** Get the updates that completed since the last call. */
+    std::vector<update_completion> take();
+
+private:
+    /** Update waiting to complete. */
+    struct pending_update
+    {
+        update_completion completion;
+        wait_function wait;
+    };
+
+    /** Event file descriptor signaled when updates complete. */
+    int event_fd = -1;
+
+    /** Lock protecting the members below. */
+    std::mutex lock;
+
+    /** Signaled when a pending update is added or on shutdown. */
+    std::condition_variable wake;
+
+    /** Updates waiting to complete, in submission order. */
+    std::deque<pending_update> pending;
+
+    /** Updates that completed and were not taken yet. */
+    std::vector<update_completion> done;
+
+    /** Whether a wait timed out, after which updates are not tracked. */
+    bool stopped = false;
+
+    /** Whether the worker thread must exit. */
+    bool stopping = false;
+
+    /** Thread waiting for pending updates. */
+    std::thread worker;
+
+    /** Main function of the worker thread. */
+    void run();
+}; // class update_tracker
+
+} // namespace rmioc
+
+#endif // RMIOC_UPDATE_TRACKER_HPP
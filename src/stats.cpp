@@ -0,0 +1,148 @@
+#include "stats.hpp"
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <ostream>
+#include <string>
+#include <utility>
+
+namespace chrono = std::chrono;
+
+namespace stats
+{
+
+namespace
+{
+
+/** Registered metric. */
+struct metric
+{
+    std::string help;
+    bool is_counter = true;
+    counter counter_value;
+    gauge gauge_value;
+};
+
+/** Registered metrics, indexed by family name and labels. */
+using registry = std::map<std::pair<std::string, std::string>, metric>;
+
+auto get_registry() -> registry&
+{
+    static registry metrics;
+    return metrics;
+}
+
+auto get_metric(
+    const char* name, const char* help, const char* labels,
+    bool is_counter
+) -> metric&
+{
+    auto [it, inserted] = get_registry().try_emplace(
+        std::make_pair(std::string{name}, std::string{labels})
+    );
+
+    if (inserted)
+    {
+        it->second.help = help;
+        it->second.is_counter = is_counter;
+    }
+
+    return it->second;
+}
+
+} // anonymous namespace
+
+auto get_counter(const char* name, const char* help, const char* labels)
+-> counter&
+{
+    return get_metric(name, help, labels, /* is_counter = */ true)
+        .counter_value;
+}
+
+auto get_gauge(const char* name, const char* help, const char* labels)
+-> gauge&
+{
+    return get_metric(name, help, labels, /* is_counter = */ false)
+        .gauge_value;
+}
+
+void write(std::ostream& out)
+{
+    const std::string* family = nullptr;
+
+    for (const auto& [key, entry] : get_registry())
+    {
+        const auto& [name, labels] = key;
+
+        if (family == nullptr || *family != name)
+        {
+            out << "# HELP " << name << ' ' << entry.help << '\n'
+                << "# TYPE " << name << ' '
+                << (entry.is_counter ? "counter" : "gauge") << '\n';
+            family = &name;
+        }
+
+        out << name;
+
+        if (!labels.empty())
+        {
+            out << '{' << labels << '}';
+        }
+
+        out << ' ';
+
+        if (entry.is_counter)
+        {
+            out << entry.counter_value.get();
+        }
+        else
+        {
+            out << entry.gauge_value.get();
+        }
+
+        out << '\n';
+    }
+}
+
+void write_distribution(
+    std::ostream& out,
+    std::vector<chrono::nanoseconds> values
+)
+{
+    if (values.empty())
+    {
+        out << "{\"count\":0}";
+        return;
+    }
+
+    std::sort(values.begin(), values.end());
+    chrono::nanoseconds total{0};
+
+    for (auto value : values)
+    {
+        total += value;
+    }
+
+    auto to_millis = [](chrono::nanoseconds value)
+    {
+        return chrono::duration<double, std::milli>(value).count();
+    };
+
+    auto percentile = [&values](double fraction)
+    {
+        auto rank = static_cast<std::size_t>(
+            std::ceil(fraction * static_cast<double>(values.size())));
+        return values.at(std::max<std::size_t>(rank, 1) - 1);
+    };
+
+    constexpr double median = 0.5;
+    constexpr double high = 0.95;
+
+    out << "{\"count\":" << values.size()
+        << ",\"mean_ms\":" << to_millis(total) / values.size()
+        << ",\"p50_ms\":" << to_millis(percentile(median))
+        << ",\"p95_ms\":" << to_millis(percentile(high))
+        << ",\"max_ms\":" << to_millis(values.back()) << '}';
+}
+
+} // namespace stats
@@ -0,0 +1,99 @@
+#ifndef STATS_HPP
+#define STATS_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+namespace stats
+{
+
+/** Value that can only increase, such as a number of processed events. */
+class counter
+{
+public:
+    /** Increase the counter. */
+    void add(std::uint64_t amount = 1)
+    {
+        this->value += amount;
+    }
+
+    /** Get the current value. */
+    std::uint64_t get() const
+    {
+        return this->value;
+    }
+
+private:
+    std::uint64_t value = 0;
+}; // class counter
+
+/** Value that can go up and down, such as a queue length. */
+class gauge
+{
+public:
+    /** Change the current value. */
+    void set(double new_value)
+    {
+        this->value = new_value;
+    }
+
+    /** Get the current value. */
+    double get() const
+    {
+        return this->value;
+    }
+
+private:
+    double value = 0;
+}; // class gauge
+
+/**
+ * Get or create a counter.
+ *
+ * Metrics are identified by a family name and an optional set of labels
+ * that distinguishes members of the family. References stay valid for the
+ * whole lifetime of the program, so call sites should look metrics up once
+ * and keep the returned reference.
+ *
+ * @param name Name of the metric family (e.g. `vnsee_repaints_total`).
+ * @param help Short description of the metric family.
+ * @param labels Labels in Prometheus syntax (e.g. `waveform="du"`).
+ */
+counter& get_counter(const char* name, const char* help, const char* labels = "");
+
+/**
+ * Get or create a gauge.
+ *
+ * @see get_counter
+ */
+gauge& get_gauge(const char* name, const char* help, const char* labels = "");
+
+/**
+ * Write a snapshot of all metrics.
+ *
+ * The snapshot uses the Prometheus text exposition format, so that it can
+ * be read by humans as well as scraped by monitoring tools.
+ *
+ * @param out Stream to write to.
+ */
+void write(std::ostream& out);
+
+/**
+ * Print statistics about a list of durations as a JSON object.
+ *
+ * The object holds the number of values and, if there is at least one, their
+ * mean, median, 95th percentile and maximum in milliseconds.
+ *
+ * @param out Stream to print to.
+ * @param values Durations to summarize.
+ */
+void write_distribution(
+    std::ostream& out,
+    std::vector<std::chrono::nanoseconds> values
+);
+
+} // namespace stats
+
+#endif // STATS_HPP
@@ -0,0 +1,175 @@
+#include "trace.hpp"
+#include "rmioc/screen.hpp"
+#include <algorithm>
+#include <array>
+#include <csignal>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace trace
+{
+
+namespace detail
+{
+
+// NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
+bool enabled = false;
+
+} // namespace trace::detail
+
+namespace
+{
+
+/** Recorded events, in insertion order modulo the capacity. */
+// NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
+std::vector<event> ring;
+
+/** Total number of events recorded since tracing was enabled. */
+// NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
+std::size_t recorded = 0;
+
+/** Path to the file to dump events to. */
+// NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
+std::string output;
+
+/** Set by the signal handler when a dump is requested. */
+// NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
+volatile std::sig_atomic_t dump_requested = 0;
+
+void on_dump_signal(int /* signal */)
+{
+    dump_requested = 1;
+}
+
+/** Name of each stage, indexed by its value. */
+constexpr std::array<const char*, 10> stage_names{
+    "vnc_message", "decode", "damage", "repaint", "repaint_mode",
+    "pen", "touch", "buttons", "pointer", "refresh",
+};
+
+/**
+ * Timeline on which each stage is displayed.
+ *
+ * Grouping stages in a few lanes makes it easier to see how decoding,
+ * repainting and input processing interleave.
+ */
+constexpr std::array<int, 10> stage_lanes{
+    1, 1, 1, 2, 2,
+    3, 3, 3, 3, 4,
+};
+
+/** Print a nanosecond value as fractional microseconds. */
+void print_micros(std::ostream& out, std::int64_t nanos)
+{
+    constexpr auto nanos_per_micro = 1000;
+    auto frac = nanos % nanos_per_micro;
+
+    out << nanos / nanos_per_micro << '.';
+
+    if (frac < 100) { out << '0'; }
+    if (frac < 10) { out << '0'; }
+
+    out << frac;
+}
+
+} // anonymous namespace
+
+void enable(const char* output_path, std::size_t capacity)
+{
+    ring.assign(capacity, event{});
+    recorded = 0;
+    output = output_path;
+
+    if (!detail::enabled)
+    {
+        detail::enabled = true;
+        std::signal(SIGUSR1, on_dump_signal);
+        std::atexit(dump);
+    }
+}
+
+void record(const event& ev)
+{
+    ring[recorded % ring.size()] = ev;
+    ++recorded;
+}
+
+void dump()
+{
+    if (!detail::enabled)
+    {
+        return;
+    }
+
+    std::ofstream out{output, std::ios::trunc};
+
+    if (!out)
+    {
+        std::cerr << "Warning: Could not write trace to " << output << '\n';
+        return;
+    }
+
+    std::size_t count = std::min(recorded, ring.size());
+    std::size_t first = recorded - count;
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        const event& ev = ring[(first + i) % ring.size()];
+        auto stage = static_cast<std::size_t>(ev.stage);
+
+        if (i > 0)
+        {
+            out << ',';
+        }
+
+        out << "\n{\"name\":\"" << stage_names.at(stage)
+            << "\",\"cat\":\"vnsee\",\"pid\":1,\"tid\":"
+            << stage_lanes.at(stage)
+            << ",\"ph\":\"" << (ev.duration == 0 ? 'i' : 'X')
+            << "\",\"ts\":";
+        print_micros(out, ev.start);
+
+        if (ev.duration == 0)
+        {
+            out << ",\"s\":\"t\"";
+        }
+        else
+        {
+            out << ",\"dur\":";
+            print_micros(out, ev.duration);
+        }
+
+        out << ",\"args\":{\"x\":" << ev.x << ",\"y\":" << ev.y
+            << ",\"w\":" << ev.w << ",\"h\":" << ev.h
+            << ",\"bytes\":" << ev.bytes << ",\"extra\":" << ev.extra;
+
+        if (ev.stage == stages::repaint)
+        {
+            out << ",\"waveform\":\""
+                << rmioc::get_waveform_name(
+                    static_cast<rmioc::waveform_modes>(ev.waveform))
+                << '"';
+        }
+
+        out << "}}";
+    }
+
+    out << "\n]}\n";
+    std::cerr << "Wrote " << count << " trace events to " << output << '\n';
+}
+
+void handle_signals()
+{
+    if (dump_requested != 0)
+    {
+        dump_requested = 0;
+        dump();
+    }
+}
+
+} // namespace trace
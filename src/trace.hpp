@@ -0,0 +1,220 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace trace
+{
+
+/** Stages of the client pipeline that can be recorded. */
+enum class stages : std::uint8_t
+{
+    /** Handling of a message received from the VNC server. */
+    vnc_message,
+
+    /** Copy of a received rectangle into the framebuffer. */
+    decode,
+
+    /** Registration of a damaged region waiting to be repainted. */
+    damage,
+
+    /** Submission of a screen update to the device. */
+    repaint,
+
+    /** Change of the repaint mode. */
+    repaint_mode,
+
+    /** Processing of pen events. */
+    pen,
+
+    /** Processing of touchscreen events. */
+    touch,
+
+    /** Processing of physical buttons events. */
+    buttons,
+
+    /** Pointer event sent to the VNC server. */
+    pointer,
+
+    /** Display of a screen update by the panel, until its completion. */
+    refresh,
+};
+
+/**
+ * Fixed-size trace record.
+ *
+ * Fields that are not meaningful for a given stage are left to zero.
+ */
+struct event
+{
+    /** Start time of the event (nanoseconds on the steady clock). */
+    std::int64_t start;
+
+    /** Duration of the event (nanoseconds), zero for instant events. */
+    std::int64_t duration;
+
+    /** Left bound of the affected rectangle (in pixels). */
+    std::int32_t x;
+
+    /** Top bound of the affected rectangle (in pixels). */
+    std::int32_t y;
+
+    /** Width of the affected rectangle (in pixels). */
+    std::int32_t w;
+
+    /** Height of the affected rectangle (in pixels). */
+    std::int32_t h;
+
+    /** Number of bytes processed. */
+    std::uint32_t bytes;
+
+    /** Stage-specific value (e.g. button mask for pointer events). */
+    std::uint32_t extra;
+
+    /** Recorded stage. */
+    stages stage;
+
+    /** Waveform mode used by the event, if relevant. */
+    std::uint8_t waveform;
+};
+
+namespace detail
+{
+
+/** Whether tracing is currently enabled. */
+// NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
+extern bool enabled;
+
+/** Get the current time in nanoseconds on the steady clock. */
+inline auto now() -> std::int64_t
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()
+    ).count();
+}
+
+} // namespace trace::detail
+
+/**
+ * Start recording events in a ring buffer.
+ *
+ * The buffer is written to `output_path` as Chrome trace JSON when the
+ * process receives SIGUSR1 (see `handle_signals()`) and at exit.
+ *
+ * @param output_path Path of the file to dump events to.
+ * @param capacity Number of events kept in the ring buffer.
+ */
+void enable(const char* output_path, std::size_t capacity = 1U << 16U);
+
+/** Check whether events are being recorded. */
+inline auto is_enabled() -> bool
+{
+    return detail::enabled;
+}
+
+/**
+ * Append an event to the ring buffer, overwriting the oldest one if full.
+ *
+ * @param ev Event to record.
+ */
+void record(const event& ev);
+
+/**
+ * Record an instant event.
+ *
+ * Does nothing if tracing is disabled.
+ */
+inline void instant(
+    stages stage,
+    int x = 0, int y = 0, int w = 0, int h = 0,
+    std::uint32_t extra = 0
+)
+{
+    if (detail::enabled)
+    {
+        record(event{
+            detail::now(), 0,
+            x, y, w, h,
+            0, extra,
+            stage, 0
+        });
+    }
+}
+
+/**
+ * Record the duration of a scope.
+ *
+ * The start time is only sampled if tracing is enabled when the scope is
+ * entered, so that an inactive span costs a single branch.
+ */
+class span
+{
+public:
+    explicit span(stages stage)
+    {
+        if (detail::enabled)
+        {
+            this->ev.stage = stage;
+            this->ev.start = detail::now();
+        }
+    }
+
+    ~span()
+    {
+        if (this->ev.start != 0)
+        {
+            this->ev.duration = detail::now() - this->ev.start;
+            record(this->ev);
+        }
+    }
+
+    span(const span& other) = delete;
+    span& operator=(const span& other) = delete;
+    span(span&& other) = delete;
+    span& operator=(span&& other) = delete;
+
+    /** Set the rectangle affected by this span. */
+    void set_rect(int x, int y, int w, int h)
+    {
+        this->ev.x = x;
+        this->ev.y = y;
+        this->ev.w = w;
+        this->ev.h = h;
+    }
+
+    /** Set the number of bytes processed in this span. */
+    void set_bytes(std::uint32_t bytes)
+    {
+        this->ev.bytes = bytes;
+    }
+
+    /** Set the waveform mode used in this span. */
+    void set_waveform(std::uint8_t waveform)
+    {
+        this->ev.waveform = waveform;
+    }
+
+private:
+    event ev{};
+}; // class span
+
+/**
+ * Write the current contents of the ring buffer as Chrome trace JSON.
+ *
+ * Does nothing if tracing is disabled.
+ */
+void dump();
+
+/**
+ * Dump the ring buffer if SIGUSR1 was received since the last call.
+ *
+ * Signal handlers cannot safely perform I/O, so this must be called
+ * regularly from the event loop.
+ */
+void handle_signals();
+
+} // namespace trace
+
+#endif // TRACE_HPP